@@ -20,6 +20,7 @@
  */
 
 #include <algorithm> // nth_element
+#include <functional> // greater
 #include <climits>
 #include <iomanip>
 #include <iostream>
@@ -27,6 +28,12 @@
 
 #include <htm/algorithms/Connections.hpp>
 
+// AVX2 kernel for adaptSegment, selected at run time, see adaptPermanences_.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define NTA_ADAPT_AVX2
+  #include <immintrin.h>
+#endif
+
 
 using std::endl;
 using std::string;
@@ -63,6 +70,8 @@ void Connections::initialize(CellIdx numCells, Permanence connectedThreshold, bo
 
   timeseries_ = timeseries;
   reset();
+
+  rebuildSlabs_(); // keeps packed_, see setPackedSynapses.
 }
 
 
@@ -125,6 +134,10 @@ Segment Connections::createSegment(const CellIdx cell,
 	    << (size_t)segments_.size() << " < " << (size_t)std::numeric_limits<Segment>::max();
     segment = static_cast<Segment>(segments_.size());
     segments_.push_back(segmentData);
+    if( packed_ ) {
+      slabOffset_.push_back( static_cast<Synapse>(slabPermanence_.size()) );
+      slabCapacity_.push_back( 0u );
+    }
   }
 
   CellData &cellData = cells_[cell];
@@ -152,7 +165,18 @@ Synapse Connections::createSynapse(Segment segment,
   // That would give such input a stronger connection.
   // Synapses are supposed to have binary effects (0 or 1) but duplicate synapses give
   // them (synapses 0/1) varying levels of strength.
-  for (const Synapse& syn : synapsesForSegment(segment)) {
+  if( packed_ ) {
+    const auto begin = slabPresynapticCell_.cbegin() + slabOffset_[segment];
+    const auto end   = begin + numSynapses(segment);
+    const auto found = std::find(begin, end, presynapticCell);
+    if( found != end ) {
+      const Synapse syn = synapsesForSegment(segment)[found - begin];
+      NTA_ASSERT(synapseExists_(syn));
+      if(permanence > synapses_[syn].permanence) updateSynapsePermanence(syn, permanence);
+      return syn;
+    }
+  }
+  else for (const Synapse& syn : synapsesForSegment(segment)) {
     const CellIdx existingPresynapticCell = dataForSynapse(syn).presynapticCell; //TODO 1; add way to get all presynaptic cells for segment (fast)
     if (presynapticCell == existingPresynapticCell) {
       //synapse (connecting to this presyn cell) already exists on the segment; don't create a new one, exit early and return the existing
@@ -169,6 +193,50 @@ Synapse Connections::createSynapse(Segment segment,
     }
   } //else: the new synapse is not duplicit, so keep creating it. 
 
+  return createNewSynapse_(segment, presynapticCell, permanence);
+}
+
+
+void Connections::createSynapses(const Segment segment,
+                                 const vector<CellIdx> &presynapticCells,
+                                 const vector<Permanence> &permanences) {
+  NTA_CHECK( presynapticCells.size() == permanences.size() );
+  NTA_ASSERT( segment < segments_.size() ) << "Segment out of bounds! " << segment;
+  const bool unique = numSynapses(segment) == 0u and
+      std::adjacent_find(presynapticCells.cbegin(), presynapticCells.cend(),
+                         std::greater_equal<CellIdx>()) == presynapticCells.cend();
+  if( not unique ) {
+    for( size_t i = 0u; i < presynapticCells.size(); i++ ) {
+      createSynapse(segment, presynapticCells[i], permanences[i]);
+    }
+    return;
+  }
+  if( presynapticCells.empty() ) return;
+
+  const size_t numNew = presynapticCells.size();
+  if( numNew > destroyedSynapses_.size() ) {
+    const size_t size = synapses_.size() + numNew - destroyedSynapses_.size();
+    if( size > synapses_.capacity() ) {
+      synapses_.reserve( std::max(size, 2u * synapses_.capacity()) );
+    }
+  }
+  segments_[segment].synapses.reserve( numNew );
+  const size_t numPresyns = static_cast<size_t>(presynapticCells.back()) + 1u;
+  if( numPresyns > potentialSynapsesForPresynapticCell_.size() ) {
+    potentialSynapsesForPresynapticCell_.resize( numPresyns );
+    connectedSynapsesForPresynapticCell_.resize( numPresyns );
+    potentialSegmentsForPresynapticCell_.resize( numPresyns );
+    connectedSegmentsForPresynapticCell_.resize( numPresyns );
+  }
+  for( size_t i = 0u; i < numNew; i++ ) {
+    createNewSynapse_(segment, presynapticCells[i], permanences[i]);
+  }
+}
+
+
+Synapse Connections::createNewSynapse_(const Segment segment,
+                                       const CellIdx presynapticCell,
+                                       const Permanence permanence) {
   // Get an index into the synapses_ list, for the new synapse to reside at.
   Synapse synapse;
   if (!destroyedSynapses_.empty() ) {
@@ -188,15 +256,24 @@ Synapse Connections::createSynapse(Segment segment,
   synapseData.segment         = segment;
   // Start in disconnected state.
   synapseData.permanence           = connectedThreshold_ - static_cast<Permanence>(1.0);
+  if( presynapticCell >= potentialSynapsesForPresynapticCell_.size() ) {
+    const size_t numPresyns = static_cast<size_t>(presynapticCell) + 1u;
+    potentialSynapsesForPresynapticCell_.resize( numPresyns );
+    connectedSynapsesForPresynapticCell_.resize( numPresyns );
+    potentialSegmentsForPresynapticCell_.resize( numPresyns );
+    connectedSegmentsForPresynapticCell_.resize( numPresyns );
+  }
   synapseData.presynapticMapIndex_ = 
     (Synapse)potentialSynapsesForPresynapticCell_[presynapticCell].size();
   potentialSynapsesForPresynapticCell_[presynapticCell].push_back(synapse);
   potentialSegmentsForPresynapticCell_[presynapticCell].push_back(segment);
 
+  if( packed_ ) {
+    appendToSlab_(segment, synapse);
+  }
   SegmentData &segmentData = segments_[segment];
   segmentData.synapses.push_back(synapse);
 
-
   for (auto h : eventHandlers_) {
     h.second->onCreateSynapse(synapse);
   }
@@ -296,27 +373,24 @@ void Connections::destroySynapse(const Synapse synapse) {
 
     removeSynapseFromPresynapticMap_(
       synapseData.presynapticMapIndex_,
-      connectedSynapsesForPresynapticCell_.at( presynCell ),
-      connectedSegmentsForPresynapticCell_.at( presynCell ));
-
-    if( connectedSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      connectedSynapsesForPresynapticCell_.erase( presynCell );
-      connectedSegmentsForPresynapticCell_.erase( presynCell );
-    }
+      connectedSynapsesForPresynapticCell_[ presynCell ],
+      connectedSegmentsForPresynapticCell_[ presynCell ]);
   }
   else {
     removeSynapseFromPresynapticMap_(
       synapseData.presynapticMapIndex_,
-      potentialSynapsesForPresynapticCell_.at( presynCell ),
-      potentialSegmentsForPresynapticCell_.at( presynCell ));
-
-    if( potentialSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      potentialSynapsesForPresynapticCell_.erase( presynCell );
-      potentialSegmentsForPresynapticCell_.erase( presynCell );
-    }
+      potentialSynapsesForPresynapticCell_[ presynCell ],
+      potentialSegmentsForPresynapticCell_[ presynCell ]);
   }
 
-  for(auto i = 0u; i < segmentData.synapses.size(); i++) {
+  if( packed_ ) {
+    const auto i = slabIndex_[synapse];
+    NTA_ASSERT(segmentData.synapses[i] == synapse);
+    removeFromSlab_(synapseData.segment, synapse);
+    segmentData.synapses[i] = segmentData.synapses.back();
+    segmentData.synapses.pop_back();
+  }
+  else for(auto i = 0u; i < segmentData.synapses.size(); i++) {
     if (segmentData.synapses[i] == synapse) {
       segmentData.synapses[i] = segmentData.synapses.back();
       segmentData.synapses.pop_back();
@@ -330,6 +404,13 @@ void Connections::destroySynapse(const Synapse synapse) {
 
 void Connections::updateSynapsePermanence(const Synapse synapse,
                                           Permanence permanence) {
+  updateSynapsePermanence_(synapse, permanence, nullptr);
+}
+
+
+void Connections::updateSynapsePermanence_(const Synapse synapse,
+                                           Permanence permanence,
+                                           vector<Crossing_> *crossings) {
   permanence = std::min(permanence, maxPermanence );
   permanence = std::max(permanence, minPermanence );
 
@@ -340,21 +421,39 @@ void Connections::updateSynapsePermanence(const Synapse synapse,
 
   // update the permanence
   synData.permanence = permanence;
+  if( packed_ ) {
+    slabPermanence_[ slabOffset_[synData.segment] + slabIndex_[synapse] ] = permanence;
+  }
 
   if( before == after ) { //no change in dis/connected status
       return;
   }
+  auto &segmentData = segments_[synData.segment];
+  if( after ) {
+    segmentData.numConnected++;
+  }
+  else {
+    segmentData.numConnected--;
+  }
+
+  if( crossings != nullptr ) { // The presynaptic maps are updated later.
+    crossings->push_back({ synapse, permanence });
+    return;
+  }
+  moveSynapse_(synapse, permanence);
+}
+
+
+void Connections::moveSynapse_(const Synapse synapse, const Permanence permanence) {
+    auto &synData         = synapses_[synapse];
     const auto &presyn    = synData.presynapticCell;
     auto &potentialPresyn = potentialSynapsesForPresynapticCell_[presyn];
     auto &potentialPreseg = potentialSegmentsForPresynapticCell_[presyn];
     auto &connectedPresyn = connectedSynapsesForPresynapticCell_[presyn];
     auto &connectedPreseg = connectedSegmentsForPresynapticCell_[presyn];
     const auto &segment   = synData.segment;
-    auto &segmentData     = segments_[segment];
     
-    if( after ) { //connect
-      segmentData.numConnected++;
-
+    if( permanence >= connectedThreshold_ ) { //connect
       // Remove this synapse from presynaptic potential synapses.
       removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
                                         potentialPresyn, potentialPreseg );
@@ -365,8 +464,6 @@ void Connections::updateSynapsePermanence(const Synapse synapse,
       connectedPreseg.push_back( segment );
     }
     else { //disconnected
-      segmentData.numConnected--;
-
       // Remove this synapse from presynaptic connected synapses.
       removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
                                         connectedPresyn, connectedPreseg );
@@ -383,6 +480,16 @@ void Connections::updateSynapsePermanence(const Synapse synapse,
 }
 
 
+void Connections::moveCrossedSynapses_() {
+  for( auto &crossings : threadCrossings_ ) {
+    for( const auto &crossing : crossings ) {
+      moveSynapse_( crossing.synapse, crossing.permanence );
+    }
+    crossings.clear();
+  }
+}
+
+
 SegmentIdx Connections::idxOnCellForSegment(const Segment segment) const {
   const vector<Segment> &segments = segmentsForCell(cellForSegment(segment));
   const auto it = std::find(segments.begin(), segments.end(), segment);
@@ -402,18 +509,104 @@ bool Connections::compareSegments(const Segment a, const Segment b) const {
 }
 
 
-vector<Synapse> Connections::synapsesForPresynapticCell(const CellIdx presynapticCell) const {
-  vector<Synapse> all;
+void Connections::appendToSlab_(const Segment segment, const Synapse synapse) {
+  NTA_ASSERT(packed_);
+  const Synapse size = static_cast<Synapse>(segments_[segment].synapses.size());
+  if( size == slabCapacity_[segment] ) {
+    // The slab is full, move it to the end of the arrays with room to grow.
+    const Synapse oldOffset = slabOffset_[segment];
+    const Synapse newOffset = static_cast<Synapse>(slabPermanence_.size());
+    const Synapse newCapacity = std::max<Synapse>(8u, 2u * size);
+    slabPresynapticCell_.resize( newOffset + newCapacity );
+    slabPermanence_.resize( newOffset + newCapacity );
+    std::copy_n( slabPresynapticCell_.begin() + oldOffset, size, slabPresynapticCell_.begin() + newOffset );
+    std::copy_n( slabPermanence_.begin() + oldOffset, size, slabPermanence_.begin() + newOffset );
+    slabOffset_[segment]   = newOffset;
+    slabCapacity_[segment] = newCapacity;
+
+    // Compact once less than a third of the store holds live synapses, the
+    // rest being orphaned slabs and the unused capacity of pruned segments.
+    if( slabPermanence_.size() > 64u + 3u * numSynapses() ) {
+      rebuildSlabs_();
+      if( size == slabCapacity_[segment] ) { //empty segment, grow its slab again
+        appendToSlab_(segment, synapse);
+        return;
+      }
+    }
+  }
+  if( slabIndex_.size() < synapses_.size() ) {
+    slabIndex_.resize( synapses_.size() );
+  }
+  const auto &synData = synapses_[synapse];
+  slabPresynapticCell_[ slabOffset_[segment] + size ] = synData.presynapticCell;
+  slabPermanence_[      slabOffset_[segment] + size ] = synData.permanence;
+  slabIndex_[synapse] = size;
+}
 
-  if (potentialSynapsesForPresynapticCell_.count(presynapticCell)) {
-    const auto& potential = potentialSynapsesForPresynapticCell_.at(presynapticCell);
-    all.assign(potential.cbegin(), potential.cend());
+
+void Connections::removeFromSlab_(const Segment segment, const Synapse synapse) {
+  NTA_ASSERT(packed_);
+  const auto &synapses = segments_[segment].synapses;
+  const Synapse offset = slabOffset_[segment];
+  const Synapse index  = slabIndex_[synapse];
+  const Synapse last   = static_cast<Synapse>(synapses.size() - 1u);
+  slabPresynapticCell_[offset + index] = slabPresynapticCell_[offset + last];
+  slabPermanence_[offset + index]      = slabPermanence_[offset + last];
+  slabIndex_[ synapses[last] ] = index;
+}
+
+
+void Connections::rebuildSlabs_() {
+  slabOffset_.clear();
+  slabCapacity_.clear();
+  slabIndex_.clear();
+  slabPresynapticCell_.clear();
+  slabPermanence_.clear();
+  if( not packed_ ) {
+    slabOffset_.shrink_to_fit();
+    slabCapacity_.shrink_to_fit();
+    slabIndex_.shrink_to_fit();
+    slabPresynapticCell_.shrink_to_fit();
+    slabPermanence_.shrink_to_fit();
+    return;
   }
 
-  if (connectedSynapsesForPresynapticCell_.count(presynapticCell)) {
-    const auto& connected = connectedSynapsesForPresynapticCell_.at(presynapticCell);
-    all.insert( all.cend(), connected.cbegin(), connected.cend());
+  slabOffset_.resize( segments_.size() );
+  slabCapacity_.resize( segments_.size() );
+  slabIndex_.resize( synapses_.size() );
+  // Leave every slab some room to grow, so that the segments which are still
+  // learning are not all relocated again right away.
+  size_t total = 0;
+  for( Segment seg = 0; seg < segments_.size(); seg++ ) {
+    const auto size = segments_[seg].synapses.size();
+    slabOffset_[seg]   = static_cast<Synapse>(total);
+    slabCapacity_[seg] = static_cast<Synapse>(size + size / 2u);
+    total += slabCapacity_[seg];
+  }
+  slabPresynapticCell_.resize( total );
+  slabPermanence_.resize( total );
+  for( Segment seg = 0; seg < segments_.size(); seg++ ) {
+    const auto &synapses = segments_[seg].synapses;
+    for( Synapse i = 0; i < synapses.size(); i++ ) {
+      const auto &synData = synapses_[ synapses[i] ];
+      slabPresynapticCell_[ slabOffset_[seg] + i ] = synData.presynapticCell;
+      slabPermanence_[      slabOffset_[seg] + i ] = synData.permanence;
+      slabIndex_[ synapses[i] ] = i;
+    }
   }
+}
+
+
+vector<Synapse> Connections::synapsesForPresynapticCell(const CellIdx presynapticCell) const {
+  vector<Synapse> all;
+  if (presynapticCell >= potentialSynapsesForPresynapticCell_.size())
+    return all; // No synapses were ever created for this presynaptic cell.
+
+  const auto& potential = potentialSynapsesForPresynapticCell_[presynapticCell];
+  const auto& connected = connectedSynapsesForPresynapticCell_[presynapticCell];
+  all.reserve(potential.size() + connected.size());
+  all.assign(potential.cbegin(), potential.cend());
+  all.insert( all.cend(), connected.cbegin(), connected.cend());
 
   return all;
 }
@@ -430,7 +623,37 @@ void Connections::reset() noexcept
 
 vector<SynapseIdx> Connections::computeActivity(const vector<CellIdx> &activePresynapticCells, const bool learn) {
 
-  vector<SynapseIdx> numActiveConnectedSynapsesForSegment(segments_.size(), 0);
+  vector<SynapseIdx> numActiveConnectedSynapsesForSegment;
+  vector<Segment>    touched;
+  computeActivity(numActiveConnectedSynapsesForSegment, touched, activePresynapticCells, learn);
+  return numActiveConnectedSynapsesForSegment;
+}
+
+
+vector<SynapseIdx> Connections::computeActivity(
+    vector<SynapseIdx> &numActivePotentialSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells,
+    const bool learn) {
+  NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
+
+  vector<SynapseIdx> numActiveConnectedSynapsesForSegment;
+  vector<Segment>    touched;
+  numActivePotentialSynapsesForSegment.assign(segments_.size(), 0);
+  computeActivity(numActiveConnectedSynapsesForSegment,
+                  numActivePotentialSynapsesForSegment,
+                  touched, activePresynapticCells, learn);
+  return numActiveConnectedSynapsesForSegment;
+}
+
+
+void Connections::computeActivity(
+    vector<SynapseIdx> &numActiveConnectedSynapsesForSegment,
+    vector<Segment>    &touchedSegments,
+    const vector<CellIdx> &activePresynapticCells,
+    const bool learn) {
+
+  maybeCompact_();
+
   if(learn) iteration_++;
 
   if( timeseries_ ) {
@@ -440,41 +663,392 @@ vector<SynapseIdx> Connections::computeActivity(const vector<CellIdx> &activePre
     currentUpdates_.clear();
   }
 
+  // Zero the entries of the previous call, then grow for any new segments.
+  for( const auto segment : touchedSegments ) {
+    numActiveConnectedSynapsesForSegment[segment] = 0;
+  }
+  touchedSegments.clear();
+  numActiveConnectedSynapsesForSegment.resize(segments_.size(), 0);
+
   // Iterate through all connected synapses.
-  for (const auto& cell : activePresynapticCells) {
-    if (connectedSegmentsForPresynapticCell_.count(cell)) {
-      for(const auto& segment : connectedSegmentsForPresynapticCell_.at(cell)) {
-        ++numActiveConnectedSynapsesForSegment[segment];
+  scatter_( connectedSegmentsForPresynapticCell_, activePresynapticCells,
+            numActiveConnectedSynapsesForSegment, touchedSegments );
+}
+
+
+void Connections::computeActivityBatch(
+    vector<vector<SynapseIdx>> &numActiveConnectedSynapsesForSegment,
+    const SDR *inputs, const size_t numInputs) const {
+  NTA_CHECK( numInputs <= std::numeric_limits<UInt32>::max() );
+
+  // For every active presynaptic cell, find the inputs which it is active in:
+  // sort the (cell, input) pairs by cell.
+  const auto numPresyns = connectedSegmentsForPresynapticCell_.size();
+  vector<UInt64> activity;
+  for( size_t input = 0u; input < numInputs; input++ ) {
+    for( const auto cell : inputs[input].getSparse() ) {
+      if( cell < numPresyns ) {
+        activity.push_back( (static_cast<UInt64>(cell) << 32u) | input );
       }
     }
   }
-  return numActiveConnectedSynapsesForSegment;
+  countActivityBatch_( numActiveConnectedSynapsesForSegment, numInputs, activity );
 }
 
 
-vector<SynapseIdx> Connections::computeActivity(
+void Connections::computeActivityBatch(
+    vector<vector<SynapseIdx>> &numActiveConnectedSynapsesForSegment,
+    const SDRBatch &inputs, const size_t begin, const size_t end) const {
+  NTA_CHECK( begin <= end and end <= inputs.size() );
+  NTA_CHECK( end - begin <= std::numeric_limits<UInt32>::max() );
+
+  const auto numPresyns = connectedSegmentsForPresynapticCell_.size();
+  vector<UInt64> activity;
+  for( size_t input = begin; input < end; input++ ) {
+    for( const auto cell : inputs[input] ) {
+      if( cell < numPresyns ) {
+        activity.push_back( (static_cast<UInt64>(cell) << 32u) | (input - begin) );
+      }
+    }
+  }
+  countActivityBatch_( numActiveConnectedSynapsesForSegment, end - begin, activity );
+}
+
+
+void Connections::countActivityBatch_(
+    vector<vector<SynapseIdx>> &counts, const size_t numInputs,
+    vector<UInt64> &activity) const {
+  counts.resize( numInputs );
+  for( auto &count : counts ) {
+    count.assign( segments_.size(), 0 );
+  }
+
+  std::sort( activity.begin(), activity.end() );
+  for( auto it = activity.cbegin(); it != activity.cend(); ) {
+    const auto cell = static_cast<CellIdx>(*it >> 32u);
+    const auto &segments = connectedSegmentsForPresynapticCell_[cell];
+    for( ; it != activity.cend() and static_cast<CellIdx>(*it >> 32u) == cell; ++it ) {
+      auto &count = counts[ static_cast<UInt32>(*it) ];
+      for( const auto segment : segments ) {
+        count[segment]++;
+      }
+    }
+  }
+}
+
+
+void Connections::computeActivity(
+    vector<SynapseIdx> &numActiveConnectedSynapsesForSegment,
     vector<SynapseIdx> &numActivePotentialSynapsesForSegment,
+    vector<Segment>    &touchedSegments,
     const vector<CellIdx> &activePresynapticCells,
     const bool learn) {
-  NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
+
+  // Before touching the buffers: this may shrink them, see compact().
+  maybeCompact_();
+
+  // Zero the entries of the previous call, then grow for any new segments.
+  for( const auto segment : touchedSegments ) {
+    numActivePotentialSynapsesForSegment[segment] = 0;
+  }
+  numActivePotentialSynapsesForSegment.resize(segments_.size(), 0);
 
   // Iterate through all connected synapses.
-  const vector<SynapseIdx>& numActiveConnectedSynapsesForSegment = computeActivity( activePresynapticCells, learn );
-  NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
+  computeActivity( numActiveConnectedSynapsesForSegment, touchedSegments,
+                   activePresynapticCells, learn );
+
+  // Iterate through all potential synapses.  The potential counts include the
+  // connected synapses.
+  for( const auto segment : touchedSegments ) {
+    numActivePotentialSynapsesForSegment[segment] = numActiveConnectedSynapsesForSegment[segment];
+  }
+  scatter_( potentialSegmentsForPresynapticCell_, activePresynapticCells,
+            numActivePotentialSynapsesForSegment, touchedSegments );
+}
 
-  // Iterate through all potential synapses.
-  std::copy( numActiveConnectedSynapsesForSegment.begin(),
-             numActiveConnectedSynapsesForSegment.end(),
-             numActivePotentialSynapsesForSegment.begin());
 
+void Connections::scatter_(
+    const vector<vector<Segment>> &segmentsForPresynapticCell,
+    const vector<CellIdx> &activePresynapticCells,
+    vector<SynapseIdx> &counts,
+    vector<Segment> &touched) {
+  NTA_ASSERT( counts.size() == segments_.size() );
+  if( threadPool_ ) {
+    scatterParallel_( segmentsForPresynapticCell, activePresynapticCells, counts, touched );
+    return;
+  }
+  const auto numPresyns = segmentsForPresynapticCell.size();
+  // Make room for the worst case, so that the loop below can append without branching.
+  size_t maxTouched = 0u;
   for (const auto& cell : activePresynapticCells) {
-    if (potentialSegmentsForPresynapticCell_.count(cell)) {
-      for(const auto& segment : potentialSegmentsForPresynapticCell_.at(cell)) {
-        ++numActivePotentialSynapsesForSegment[segment];
+    if (cell < numPresyns) maxTouched += segmentsForPresynapticCell[cell].size();
+  }
+  size_t numTouched = touched.size();
+  touched.resize( numTouched + maxTouched + 1u );
+  for (const auto& cell : activePresynapticCells) {
+    if (cell >= numPresyns) continue; // No synapses on this cell.
+    for(const auto& segment : segmentsForPresynapticCell[cell]) {
+      touched[numTouched] = segment;
+      numTouched += (counts[segment]++ == 0);
+    }
+  }
+  touched.resize( numTouched );
+}
+
+
+void Connections::setNumThreads(const UInt numThreads) {
+  threadCounts_.clear();
+  threadTouched_.clear();
+  if( numThreads == 1u ) {
+    threadPool_.reset();
+    return;
+  }
+  threadPool_ = std::make_shared<ThreadPool>( numThreads );
+  if( threadPool_->size() == 1u ) { // numThreads == 0 on a single core machine.
+    threadPool_.reset();
+  }
+}
+
+
+void Connections::setPackedSynapses(const bool packed) {
+  if( packed == packed_ ) return;
+  packed_ = packed;
+  rebuildSlabs_();
+}
+
+
+void Connections::scatterParallel_(
+    const vector<vector<Segment>> &segmentsForPresynapticCell,
+    const vector<CellIdx> &activePresynapticCells,
+    vector<SynapseIdx> &counts,
+    vector<Segment> &touched) {
+  const UInt numThreads = threadPool_->size();
+  threadCounts_.resize( numThreads - 1u );
+  threadTouched_.resize( numThreads );
+  for( auto &threadCounts : threadCounts_ ) {
+    threadCounts.resize( segments_.size(), 0u ); // Existing entries are already zero.
+  }
+  for( auto &chunkTouched : threadTouched_ ) {
+    chunkTouched.clear();
+  }
+
+  // Each thread counts a contiguous share of the active cells.  The first
+  // one counts straight into the output, the others into their own private
+  // counters.  Each lists the segments whose count it raised from zero.
+  const auto numPresyns = segmentsForPresynapticCell.size();
+  threadPool_->parallelFor( activePresynapticCells.size(),
+      [&](const size_t begin, const size_t end, const UInt chunk) {
+    auto &chunkCounts  = chunk == 0u ? counts : threadCounts_[chunk - 1u];
+    auto &chunkTouched = threadTouched_[chunk];
+    for(size_t i = begin; i < end; i++) {
+      const auto cell = activePresynapticCells[i];
+      if (cell >= numPresyns) continue; // No synapses on this cell.
+      for(const auto& segment : segmentsForPresynapticCell[cell]) {
+        if( chunkCounts[segment]++ == 0u ) {
+          chunkTouched.push_back( segment );
+        }
+      }
+    }
+  });
+
+  // Add the private counters of the touched segments into the output, and
+  // zero them for the next call.  This is in chunk order, so the touched
+  // segments are listed in the same order for any timing of the threads.
+  touched.insert( touched.end(), threadTouched_[0].begin(), threadTouched_[0].end() );
+  for( UInt chunk = 1u; chunk < numThreads; chunk++ ) {
+    auto &threadCounts = threadCounts_[chunk - 1u];
+    for( const Segment segment : threadTouched_[chunk] ) {
+      if( counts[segment] == 0u ) {
+        touched.push_back( segment );
       }
+      counts[segment] += threadCounts[segment];
+      threadCounts[segment] = 0u;
     }
   }
-  return numActiveConnectedSynapsesForSegment;
+}
+
+
+void Connections::setAutoCompact(const Real maxDestroyedFraction) {
+  NTA_CHECK( maxDestroyedFraction >= 0.0f and maxDestroyedFraction <= 1.0f )
+    << "Connections::setAutoCompact fraction out of range [0, 1]: " << maxDestroyedFraction;
+  autoCompact_ = maxDestroyedFraction;
+}
+
+
+void Connections::maybeCompact_() {
+  if( autoCompact_ <= 0.0f ) return;
+  if( destroyedSegments_.size() > autoCompact_ * segments_.size() or
+      destroyedSynapses_.size() > autoCompact_ * synapses_.size() ) {
+    compact();
+  }
+}
+
+
+void Connections::compact() {
+  const Segment noSegment = std::numeric_limits<Segment>::max();
+  const Synapse noSynapse = std::numeric_limits<Synapse>::max();
+  vector<Segment> segmentRemap( segments_.size(), noSegment );
+  vector<Synapse> synapseRemap( synapses_.size(), noSynapse );
+
+  // Number the segments cell by cell, keeping their relative order within
+  // the cell.  The cells' lists keep their own order.
+  vector<SegmentData> segments;
+  segments.reserve( numSegments() );
+  vector<Segment> sorted;
+  for( auto &cellData : cells_ ) {
+    sorted.assign( cellData.segments.cbegin(), cellData.segments.cend() );
+    std::sort( sorted.begin(), sorted.end() );
+    for( const Segment segment : sorted ) {
+      segmentRemap[segment] = static_cast<Segment>( segments.size() );
+      segments.push_back( std::move(segments_[segment]) );
+    }
+    for( auto &segment : cellData.segments ) {
+      segment = segmentRemap[segment];
+    }
+  }
+
+  // Number the synapses segment by segment, likewise.
+  vector<SynapseData> synapses;
+  synapses.reserve( numSynapses() );
+  vector<Synapse> sortedSynapses;
+  for( Segment segment = 0; segment < segments.size(); segment++ ) {
+    auto &segmentSynapses = segments[segment].synapses;
+    sortedSynapses.assign( segmentSynapses.cbegin(), segmentSynapses.cend() );
+    std::sort( sortedSynapses.begin(), sortedSynapses.end() );
+    for( const Synapse synapse : sortedSynapses ) {
+      synapseRemap[synapse] = static_cast<Synapse>( synapses.size() );
+      synapses.push_back( synapses_[synapse] );
+      synapses.back().segment = segment;
+    }
+    for( auto &synapse : segmentSynapses ) {
+      synapse = synapseRemap[synapse];
+    }
+  }
+
+  // The presynaptic lists keep their order, so presynapticMapIndex_ is unchanged.
+  for( auto *synapseMap : { &potentialSynapsesForPresynapticCell_, &connectedSynapsesForPresynapticCell_ } ) {
+    for( auto &list : *synapseMap ) {
+      for( auto &synapse : list ) synapse = synapseRemap[synapse];
+    }
+  }
+  for( auto *segmentMap : { &potentialSegmentsForPresynapticCell_, &connectedSegmentsForPresynapticCell_ } ) {
+    for( auto &list : *segmentMap ) {
+      for( auto &segment : list ) segment = segmentRemap[segment];
+    }
+  }
+
+  if( timeseries_ ) {
+    for( auto *updates : { &previousUpdates_, &currentUpdates_ } ) {
+      if( updates->empty() ) continue;
+      vector<Permanence> remapped( synapses.size(), minPermanence );
+      for( Synapse synapse = 0; synapse < updates->size(); synapse++ ) {
+        if( synapseRemap[synapse] != noSynapse )
+          remapped[synapseRemap[synapse]] = (*updates)[synapse];
+      }
+      updates->swap( remapped );
+    }
+  }
+
+  segments_.swap( segments );
+  synapses_.swap( synapses );
+  destroyedSegments_.clear();
+  destroyedSynapses_.clear();
+  threadCounts_.clear();
+  rebuildSlabs_();
+
+  for( auto h : eventHandlers_ ) {
+    h.second->onCompact( segmentRemap, synapseRemap );
+  }
+}
+
+
+namespace {
+/*
+ * Kernels for the first pass of Connections::adaptSegment.  For every synapse
+ * i: out[i] = clip(permanences[i] +/- increment/decrement), depending on
+ * whether input[presynapticCells[i]] is on.  The AVX2 kernel gathers 8 input
+ * bits at once, and is picked at run time when the CPU supports it.  Both
+ * kernels give exactly the same results.
+ */
+using AdaptKernel = void (*)(const CellIdx *presynapticCells, const Permanence *permanences,
+                             Permanence *out, size_t size,
+                             const ElemDense *input, size_t inputSize,
+                             Permanence increment, Permanence decrement);
+
+void adaptPermanencesScalar(const CellIdx *presynapticCells, const Permanence *permanences,
+                            Permanence *out, const size_t size,
+                            const ElemDense *input, const size_t inputSize,
+                            const Permanence increment, const Permanence decrement) {
+  for(size_t i = 0; i < size; i++) {
+    NTA_ASSERT(presynapticCells[i] < inputSize);
+    out[i] = input[presynapticCells[i]] ? increment : -decrement;
+  }
+  // The clipping vectorizes when it is a separate loop.
+  for(size_t i = 0; i < size; i++) {
+    out[i] = std::max(std::min(permanences[i] + out[i], maxPermanence), minPermanence);
+  }
+}
+
+#if defined(NTA_ADAPT_AVX2)
+__attribute__((target("avx2")))
+void adaptPermanencesAVX2(const CellIdx *presynapticCells, const Permanence *permanences,
+                          Permanence *out, const size_t size,
+                          const ElemDense *input, const size_t inputSize,
+                          const Permanence increment, const Permanence decrement) {
+  static_assert(sizeof(CellIdx) == 4u and sizeof(Permanence) == 4u and sizeof(ElemDense) == 1u,
+                "adaptPermanencesAVX2 needs 32 bit cells & permanences, and byte inputs.");
+  const __m256  inc     = _mm256_set1_ps( increment );
+  const __m256  dec     = _mm256_set1_ps( -decrement );
+  const __m256  minPerm = _mm256_set1_ps( minPermanence );
+  const __m256  maxPerm = _mm256_set1_ps( maxPermanence );
+  const __m256i lowByte = _mm256_set1_epi32( 0xFF );
+  const __m256i zero    = _mm256_setzero_si256();
+  // The gather reads 4 bytes per cell, so cells past lastSafe would read
+  // beyond the end of the input.  Those blocks take the scalar path.
+  const __m256i lastSafe = _mm256_set1_epi32( static_cast<int>(inputSize) - 4 );
+
+  size_t i = 0;
+  for( ; i + 8u <= size; i += 8u) {
+    const __m256i cells  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(presynapticCells + i) );
+    const __m256i unsafe = _mm256_cmpgt_epi32( cells, lastSafe );
+    if( not _mm256_testz_si256(unsafe, unsafe) ) {
+      adaptPermanencesScalar( presynapticCells + i, permanences + i, out + i, 8u,
+                              input, inputSize, increment, decrement );
+      continue;
+    }
+    const __m256i bytes  = _mm256_and_si256( lowByte,
+        _mm256_i32gather_epi32( reinterpret_cast<const int*>(input), cells, 1 ) );
+    const __m256  active = _mm256_castsi256_ps( _mm256_cmpgt_epi32(bytes, zero) );
+    const __m256  update = _mm256_blendv_ps( dec, inc, active );
+    __m256 perm = _mm256_add_ps( _mm256_loadu_ps(permanences + i), update );
+    // Operand order as in std::min / std::max, for identical results.
+    perm = _mm256_min_ps( maxPerm, perm );
+    perm = _mm256_max_ps( minPerm, perm );
+    _mm256_storeu_ps( out + i, perm );
+  }
+  adaptPermanencesScalar( presynapticCells + i, permanences + i, out + i, size - i,
+                          input, inputSize, increment, decrement );
+}
+#endif
+
+AdaptKernel selectAdaptKernel() {
+#if defined(NTA_ADAPT_AVX2)
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports("avx2") ) {
+    return adaptPermanencesAVX2;
+  }
+#endif
+  return adaptPermanencesScalar;
+}
+} // end anonymous namespace
+
+
+void Connections::adaptPermanences_(const CellIdx *presynapticCells, const Permanence *permanences,
+                                    Permanence *out, const size_t size,
+                                    const ElemDense *input, const size_t inputSize,
+                                    const Permanence increment, const Permanence decrement) {
+  static const AdaptKernel kernel = selectAdaptKernel();
+  kernel( presynapticCells, permanences, out, size, input, inputSize, increment, decrement );
 }
 
 
@@ -484,6 +1058,21 @@ void Connections::adaptSegment(const Segment segment,
                                const Permanence decrement, 
 			       const bool pruneZeroSynapses, 
 			       const UInt segmentThreshold)
+{
+  adaptSegment_(segment, inputs, increment, decrement, pruneZeroSynapses, segmentThreshold,
+                scratch_, nullptr, nullptr);
+}
+
+
+void Connections::adaptSegment_(const Segment segment,
+                                const SDR &inputs,
+                                const Permanence increment,
+                                const Permanence decrement,
+                                const bool pruneZeroSynapses,
+                                const UInt segmentThreshold,
+                                LearnScratch_ &scratch,
+                                vector<Crossing_> *crossings,
+                                vector<Synapse> *pruned)
 {
   const auto &inputArray = inputs.getDense();
 
@@ -492,48 +1081,93 @@ void Connections::adaptSegment(const Segment segment,
     currentUpdates_.resize(  synapses_.size(), minPermanence );
   }
 
-  vector<Synapse> destroyLater;
-  for(const auto synapse: synapsesForSegment(segment)) {
-      const SynapseData &synapseData = dataForSynapse(synapse);
+  const auto &synapses = synapsesForSegment(segment);
+  const size_t numSynapses = synapses.size();
+  const CellIdx    *presynapticCells;
+  const Permanence *permanences;
+  if( packed_ ) {
+    presynapticCells = &slabPresynapticCell_[slabOffset_[segment]];
+    permanences      = &slabPermanence_[slabOffset_[segment]];
+  }
+  else {
+    scratch.presynapticCells.resize( numSynapses );
+    scratch.permanences.resize( numSynapses );
+    for(size_t i = 0; i < numSynapses; i++) {
+      const auto &synData = synapses_[synapses[i]];
+      scratch.presynapticCells[i] = synData.presynapticCell;
+      scratch.permanences[i]      = synData.permanence;
+    }
+    presynapticCells = scratch.presynapticCells.data();
+    permanences      = scratch.permanences.data();
+  }
 
-      Permanence update;
-      if( inputArray[synapseData.presynapticCell] ) {
-        update = increment;
-      } else {
-        update = -decrement;
-      }
+  // First pass: compute all of the new permanences at once.
+  auto &adapted = scratch.adapted;
+  adapted.resize( numSynapses );
+  adaptPermanences_( presynapticCells, permanences, adapted.data(), numSynapses,
+                     inputArray.data(), inputArray.size(), increment, decrement );
+
+  // Second pass: store them, and do the bookkeeping of the synapses which
+  // got (dis)connected or pruned.
+  vector<Synapse> destroyLater;
+  vector<Synapse> &prune = pruned != nullptr ? *pruned : destroyLater;
+  for(size_t i = 0; i < numSynapses; i++) {
+    const Synapse    synapse    = synapses[i];
+    const Permanence permanence = adapted[i];
+    NTA_ASSERT(synapseExists_(synapse));
 
     //prune permanences that reached zero
     if (pruneZeroSynapses and 
-        synapseData.permanence + update < htm::minPermanence + htm::Epsilon) { //new value will disconnect the synapse
-      destroyLater.push_back(synapse);
-      prunedSyns_++; //for statistics
+        permanence < htm::minPermanence + htm::Epsilon) { //new value will disconnect the synapse
+      prune.push_back(synapse);
       continue;
     }
 
     //update synapse, but for TS only if changed
     if(timeseries_) {
+      const Permanence update = inputArray[presynapticCells[i]] ? increment : -decrement;
       if( update != previousUpdates_[synapse] ) {
-        updateSynapsePermanence(synapse, synapseData.permanence + update);
+        updateSynapsePermanence(synapse, permanence);
       }
       currentUpdates_[ synapse ] = update;
-    } else {
-      updateSynapsePermanence(synapse, synapseData.permanence + update);
+    }
+    else if( (permanences[i] >= connectedThreshold_) == (permanence >= connectedThreshold_) ) {
+      // No change in dis/connected status, only store the new value.
+      synapses_[synapse].permanence = permanence;
+      if( packed_ ) {
+        slabPermanence_[ slabOffset_[segment] + i ] = permanence;
+      }
+    }
+    else {
+      updateSynapsePermanence_(synapse, permanence, crossings);
     }
   }
 
-  //destroy synapses accumulated for pruning
-  for(const auto pruneSyn : destroyLater) {
-    destroySynapse(pruneSyn);
-  }
-
-  //destroy segment if it has too few synapses left -> will never be able to connect again
   #ifdef NTA_ASSERTIONS_ON
   if(segmentThreshold > 0) {
     NTA_ASSERT(pruneZeroSynapses) << "Setting segmentThreshold only makes sense when pruneZeroSynapses is allowed.";
   }
   #endif
-  if(pruneZeroSynapses and synapsesForSegment(segment).size() < segmentThreshold) { 
+  if( pruneZeroSynapses and pruned == nullptr ) {
+    pruneSegment_(segment, destroyLater.data(), destroyLater.data() + destroyLater.size(),
+                  segmentThreshold);
+  }
+}
+
+
+void Connections::pruneSegment_(const Segment segment,
+                                const Synapse *prunedBegin,
+                                const Synapse *prunedEnd,
+                                const UInt segmentThreshold)
+{
+  //destroy synapses accumulated for pruning
+  for(auto pruneSyn = prunedBegin; pruneSyn != prunedEnd; pruneSyn++) {
+    destroySynapse(*pruneSyn);
+    prunedSyns_++; //for statistics
+  }
+
+  //destroy segment if it has too few synapses left -> will never be able to connect again
+  if(synapsesForSegment(segment).size() < segmentThreshold) { 
     destroySegment(segment);
     prunedSegs_++; //statistics
   }
@@ -548,16 +1182,26 @@ void Connections::adaptSegment(const Segment segment,
 void Connections::raisePermanencesToThreshold(
                   const Segment    segment,
                   const UInt       segmentThreshold)
+{
+  raisePermanencesToThreshold_(segment, segmentThreshold, scratch_, nullptr);
+}
+
+
+void Connections::raisePermanencesToThreshold_(
+                  const Segment    segment,
+                  const UInt       segmentThreshold,
+                  LearnScratch_    &scratch,
+                  vector<Crossing_> *crossings)
 {
   if( segmentThreshold == 0 ) // No synapses requested to be connected, done.
     return;
 
   NTA_ASSERT(segment < segments_.size()) << "Accessing segment out of bounds.";
-  auto &segData = segments_[segment];
+  const auto &segData = segments_[segment];
   if( segData.numConnected >= segmentThreshold )
     return;   // The segment already satisfies the requirement, done.
 
-  vector<Synapse> &synapses = segData.synapses;
+  const auto &synapses = segData.synapses;
   if( synapses.empty())
     return;   // No synapses to raise permanences to, no work to do.
 
@@ -573,26 +1217,171 @@ void Connections::raisePermanencesToThreshold(
   // Keep segmentThreshold within synapses range.
   const auto threshold = std::min((size_t)segmentThreshold, synapses.size());
 
-  // Sort the potential pool by permanence values, and look for the synapse with
-  // the N'th greatest permanence, where N is the desired minimum number of
-  // connected synapses.  Then calculate how much to increase the N'th synapses
-  // permance by such that it becomes a connected synapse.  After that there
-  // will be at least N synapses connected.
+  // Look for the synapse with the N'th greatest permanence, where N is the
+  // desired minimum number of connected synapses.  Then calculate how much to
+  // increase the N'th synapses permance by such that it becomes a connected
+  // synapse.  After that there will be at least N synapses connected.
+  const auto increment = connectedThreshold_ -
+      nthGreatestPermanence_(segment, static_cast<SynapseIdx>(threshold), scratch);
+  if( increment <= static_cast<Permanence>(0.0) ) // If the N'th synapse is already connected then ...
+    return;            // Enough synapses are already connected.
 
-  // Threshold is ensured to be >=1 by condition at very beginning if(thresh == 0)... 
-  auto minPermSynPtr = synapses.begin() + threshold - 1;
+  // Raise the permanence of all synapses in the potential pool uniformly.
+  bumpSegment_(segment, increment, crossings);
+}
 
-  const auto permanencesGreater = [&](const Synapse &A, const Synapse &B)
-    { return synapses_[A].permanence > synapses_[B].permanence; };
-  // Do a partial sort, it's faster than a full sort.
-  std::nth_element(synapses.begin(), minPermSynPtr, synapses.end(), permanencesGreater);
 
-  const auto increment = connectedThreshold_ - synapses_[ *minPermSynPtr ].permanence;
-  if( increment <= static_cast<Permanence>(0.0) ) // If minPermSynPtr is already connected then ...
-    return;            // Enough synapses are already connected.
+Permanence Connections::nthGreatestPermanence_(const Segment segment,
+                                               const SynapseIdx n,
+                                               LearnScratch_ &scratch) const {
+  const auto &segData  = segments_[segment];
+  const auto &synapses = segData.synapses;
+  NTA_ASSERT(n >= 1u and n <= synapses.size());
+  const Permanence *slab = packed_ ? &slabPermanence_[slabOffset_[segment]] : nullptr;
+  const auto permanence = [&](const size_t i)
+    { return slab ? slab[i] : synapses_[synapses[i]].permanence; };
+
+  // The connected synapses have the numConnected greatest permanences, so the
+  // N'th greatest is on a known side of the threshold.  Only search that
+  // side, starting from whichever of its ends is closer.
+  const bool connected = n <= segData.numConnected;
+  const size_t count   = connected ? segData.numConnected : synapses.size() - segData.numConnected;
+  const size_t rank    = connected ? n : n - segData.numConnected; // Greatest first.
+  const bool greatest  = rank <= count - rank + 1u;
+  const size_t k       = greatest ? rank : count - rank + 1u;
+  const auto onSide = [&](const Permanence p)
+    { return (p >= connectedThreshold_) == connected; };
+  const auto before = [&](const Permanence a, const Permanence b)
+    { return greatest ? a > b : a < b; };
+
+  // Usually only a few more synapses need to be connected: keep the best k
+  // permanences in a short sorted list, in one pass and without copying.
+  const size_t maxShortList = 4u;
+  if( k <= maxShortList ) {
+    Permanence best[maxShortList];
+    size_t found = 0u;
+    for(size_t i = 0; i < synapses.size(); i++) {
+      const Permanence p = permanence(i);
+      if( not onSide(p) or (found == k and not before(p, best[k - 1u])) ) {
+        continue;
+      }
+      size_t j = found < k ? found++ : k - 1u;
+      for( ; j > 0u and before(p, best[j - 1u]); j-- ) {
+        best[j] = best[j - 1u];
+      }
+      best[j] = p;
+    }
+    NTA_ASSERT(found == k);
+    return best[k - 1u];
+  }
 
-  // Raise the permanence of all synapses in the potential pool uniformly.
-  bumpSegment(segment, increment);
+  // Otherwise do a partial sort of a copy, this does not reorder the synapses.
+  auto &permanences = scratch.permanences;
+  permanences.clear();
+  for(size_t i = 0; i < synapses.size(); i++) {
+    const Permanence p = permanence(i);
+    if( onSide(p) ) {
+      permanences.push_back(p);
+    }
+  }
+  const auto nth = permanences.begin() + k - 1u;
+  std::nth_element(permanences.begin(), nth, permanences.end(), before);
+  return *nth;
+}
+
+
+void Connections::adaptSegments(const vector<Segment> &segments,
+                                const SDR &inputs,
+                                const Permanence increment,
+                                const Permanence decrement,
+                                const UInt segmentThreshold)
+{
+  if( not threadPool_ or timeseries_ or segments.size() < 2u ) {
+    for( const auto segment : segments ) {
+      adaptSegment( segment, inputs, increment, decrement );
+      raisePermanencesToThreshold( segment, segmentThreshold );
+    }
+    return;
+  }
+
+  inputs.getDense(); // Convert the input once, before the threads read it.
+  threadScratch_.resize( threadPool_->size() );
+  threadCrossings_.resize( threadPool_->size() );
+  threadPool_->parallelFor( segments.size(),
+      [&](const size_t begin, const size_t end, const UInt chunk) {
+    auto &scratch   = threadScratch_[chunk];
+    auto &crossings = threadCrossings_[chunk];
+    for(size_t i = begin; i < end; i++) {
+      adaptSegment_( segments[i], inputs, increment, decrement, false, 0u, scratch, &crossings, nullptr );
+      raisePermanencesToThreshold_( segments[i], segmentThreshold, scratch, &crossings );
+    }
+  });
+  moveCrossedSynapses_();
+}
+
+
+void Connections::prepareDeferredAdaptations() {
+  NTA_CHECK( threadPool_ ) << "Deferred adaptations need the threads of setNumThreads.";
+  NTA_CHECK( not timeseries_ ) << "Deferred adaptations do not support timeseries mode.";
+  const size_t numChunks = threadPool_->size();
+  threadScratch_.resize( numChunks );
+  threadCrossings_.resize( numChunks );
+  threadPruned_.resize( numChunks );
+  threadDeferred_.resize( numChunks );
+  threadDeferredNext_.assign( numChunks, 0u );
+  for(size_t chunk = 0; chunk < numChunks; chunk++) {
+    threadCrossings_[chunk].clear();
+    threadPruned_[chunk].clear();
+    threadDeferred_[chunk].clear();
+  }
+}
+
+
+void Connections::adaptSegmentDeferred(const Segment segment,
+                                       const SDR &inputs,
+                                       const Permanence increment,
+                                       const Permanence decrement,
+                                       const bool pruneZeroSynapses,
+                                       const UInt segmentThreshold,
+                                       const UInt chunk)
+{
+  NTA_ASSERT( chunk < threadDeferred_.size() ) << "Call prepareDeferredAdaptations first.";
+  auto &crossings = threadCrossings_[chunk];
+  auto &pruned    = threadPruned_[chunk];
+  adaptSegment_( segment, inputs, increment, decrement, pruneZeroSynapses, segmentThreshold,
+                 threadScratch_[chunk], &crossings, &pruned );
+  threadDeferred_[chunk].push_back({ segment, pruneZeroSynapses, segmentThreshold,
+                                     crossings.size(), pruned.size() });
+}
+
+
+void Connections::applyDeferredAdaptation(const UInt chunk) {
+  auto &next = threadDeferredNext_[chunk];
+  const auto &deferred = threadDeferred_[chunk];
+  NTA_ASSERT( next < deferred.size() ) << "No deferred adaptation left in chunk " << chunk;
+  const auto &work = deferred[next];
+  const size_t crossingsBegin = next == 0u ? 0u : deferred[next - 1u].crossingsEnd;
+  const size_t prunedBegin    = next == 0u ? 0u : deferred[next - 1u].prunedEnd;
+  next++;
+
+  // In the same order as adaptSegment: first the (dis)connected synapses,
+  // then the pruning.
+  const auto &crossings = threadCrossings_[chunk];
+  for(size_t i = crossingsBegin; i < work.crossingsEnd; i++) {
+    moveSynapse_( crossings[i].synapse, crossings[i].permanence );
+  }
+  if( work.pruneZeroSynapses ) {
+    const auto &pruned = threadPruned_[chunk];
+    pruneSegment_( work.segment, pruned.data() + prunedBegin, pruned.data() + work.prunedEnd,
+                   work.segmentThreshold );
+  }
+
+  if( next == deferred.size() ) { // The chunk is done, see moveCrossedSynapses_.
+    threadCrossings_[chunk].clear();
+    threadPruned_[chunk].clear();
+    threadDeferred_[chunk].clear();
+    next = 0u;
+  }
 }
 
 
@@ -609,11 +1398,10 @@ void Connections::synapseCompetition(
   if( segData.synapses.empty())
     return;   // No synapses to work with, no work to do.
 
-  // Sort the potential pool by permanence values, and look for the synapse with
-  // the N'th greatest permanence, where N is the desired number of connected
-  // synapses.  Then calculate how much to change the N'th synapses permance by
-  // such that it becomes a connected synapse.  After that there will be exactly
-  // N synapses connected.
+  // Look for the synapse with the N'th greatest permanence, where N is the
+  // desired number of connected synapses.  Then calculate how much to change
+  // the N'th synapses permance by such that it becomes a connected synapse.
+  // After that there will be exactly N synapses connected.
   SynapseIdx desiredConnected;
   if( segData.numConnected < minimumSynapses ) {
     desiredConnected = minimumSynapses;
@@ -626,23 +1414,9 @@ void Connections::synapseCompetition(
   }
   // Can't connect more synapses than there are in the potential pool.
   desiredConnected = std::min( (SynapseIdx) segData.synapses.size(), desiredConnected);
-  // The N'th synapse is at index N-1
-  if( desiredConnected != 0 ) {
-    desiredConnected--;
-  }
-  // else {
-  //   Corner case: there are no synapses on this segment.
-  // }
-
-  vector<Permanence> permanences; permanences.reserve( segData.synapses.size() );
-  for( Synapse syn : segData.synapses )
-    permanences.push_back( synapses_[syn].permanence );
 
-  // Do a partial sort, it's faster than a full sort.
-  auto minPermPtr = permanences.begin() + (segData.synapses.size() - 1 - desiredConnected);
-  std::nth_element(permanences.begin(), minPermPtr, permanences.end());
-
-  Permanence delta = (connectedThreshold_ + htm::Epsilon) - *minPermPtr;
+  const Permanence delta = (connectedThreshold_ + htm::Epsilon) -
+      nthGreatestPermanence_( segment, desiredConnected, scratch_ );
 
   // Change the permance of all synapses in the potential pool uniformly.
   bumpSegment( segment, delta ) ;
@@ -650,14 +1424,54 @@ void Connections::synapseCompetition(
 
 
 void Connections::bumpSegment(const Segment segment, const Permanence delta) {
+  bumpSegment_(segment, delta, nullptr);
+}
+
+
+void Connections::bumpSegment_(const Segment segment, const Permanence delta,
+                               vector<Crossing_> *crossings) {
   // TODO: vectorize?
-  for( const auto syn : synapsesForSegment(segment) ) {
-    updateSynapsePermanence(syn, synapses_[syn].permanence + delta);
+  const auto &synapses = synapsesForSegment(segment);
+  if( packed_ ) {
+    const Permanence *permanences = &slabPermanence_[slabOffset_[segment]];
+    for( size_t i = 0; i < synapses.size(); i++ ) {
+      updateSynapsePermanence_(synapses[i], permanences[i] + delta, crossings);
+    }
+    return;
+  }
+  for( const auto syn : synapses ) {
+    updateSynapsePermanence_(syn, synapses_[syn].permanence + delta, crossings);
+  }
+}
+
+
+void Connections::bumpSegments(const vector<Segment> &segments, const Permanence delta) {
+  if( not threadPool_ or segments.size() < 2u ) {
+    for( const auto segment : segments ) {
+      bumpSegment( segment, delta );
+    }
+    return;
   }
+
+  threadCrossings_.resize( threadPool_->size() );
+  threadPool_->parallelFor( segments.size(),
+      [&](const size_t begin, const size_t end, const UInt chunk) {
+    auto &crossings = threadCrossings_[chunk];
+    for(size_t i = begin; i < end; i++) {
+      bumpSegment_( segments[i], delta, &crossings );
+    }
+  });
+  moveCrossedSynapses_();
 }
 
 
 vector<CellIdx> Connections::presynapticCellsForSegment(const Segment segment) const { //TODO optimize by storing the vector in SegmentData?
+  if( packed_ ) { // Synapses on a segment never share a presynaptic cell, see createSynapse.
+    const auto begin = slabPresynapticCell_.cbegin() + slabOffset_[segment];
+    vector<CellIdx> presynCells(begin, begin + numSynapses(segment));
+    std::sort(presynCells.begin(), presynCells.end());
+    return presynCells;
+  }
   set<CellIdx> presynCells;
   for(const auto synapse: synapsesForSegment(segment)) {
     const auto presynapticCell = dataForSynapse(synapse).presynapticCell;
@@ -747,7 +1561,13 @@ namespace htm {
 std::ostream& operator<< (std::ostream& stream, const Connections& self)
 {
   stream << "Connections:" << std::endl;
-  const auto numPresyns = self.potentialSynapsesForPresynapticCell_.size();
+  size_t numPresyns = 0u;
+  for( size_t cell = 0; cell < self.potentialSynapsesForPresynapticCell_.size(); cell++ ) {
+    if( not self.potentialSynapsesForPresynapticCell_[cell].empty() or
+        not self.connectedSynapsesForPresynapticCell_[cell].empty() ) {
+      numPresyns++;
+    }
+  }
   stream << "    Inputs (" << numPresyns
          << ") ~> Outputs (" << self.cells_.size()
          << ") via Segments (" << self.numSegments() << ")" << std::endl;
@@ -815,6 +1635,21 @@ std::ostream& operator<< (std::ostream& stream, const Connections& self)
 
 
 
+namespace {
+// The presynaptic maps only grow, so one Connections may have more (empty)
+// lists at the end than another with the same synapses.
+template<typename T>
+bool samePresynapticLists(const vector<vector<T>> &a, const vector<vector<T>> &b) {
+  const auto &shorter = a.size() <= b.size() ? a : b;
+  const auto &longer  = a.size() <= b.size() ? b : a;
+  if( not std::equal(shorter.cbegin(), shorter.cend(), longer.cbegin()) ) {
+    return false;
+  }
+  return std::all_of(longer.cbegin() + shorter.size(), longer.cend(),
+                     [](const vector<T> &list) { return list.empty(); });
+}
+} // end anonymous namespace
+
 bool Connections::operator==(const Connections &o) const {
   try {
   NTA_CHECK (cells_.size() == o.cells_.size()) << "Connections equals: cells_" << cells_.size() << " vs. " << o.cells_.size();
@@ -846,10 +1681,10 @@ bool Connections::operator==(const Connections &o) const {
   NTA_CHECK (connectedThreshold_ == o.connectedThreshold_ ) << "Connections equals: connectedThreshold_";
   NTA_CHECK (iteration_ == o.iteration_ ) << "Connections equals: iteration_"; 
 
-  NTA_CHECK(potentialSynapsesForPresynapticCell_ == o.potentialSynapsesForPresynapticCell_);
-  NTA_CHECK(connectedSynapsesForPresynapticCell_ == o.connectedSynapsesForPresynapticCell_);
-  NTA_CHECK(potentialSegmentsForPresynapticCell_ == o.potentialSegmentsForPresynapticCell_);
-  NTA_CHECK(connectedSegmentsForPresynapticCell_ == o.connectedSegmentsForPresynapticCell_);
+  NTA_CHECK(samePresynapticLists(potentialSynapsesForPresynapticCell_, o.potentialSynapsesForPresynapticCell_));
+  NTA_CHECK(samePresynapticLists(connectedSynapsesForPresynapticCell_, o.connectedSynapsesForPresynapticCell_));
+  NTA_CHECK(samePresynapticLists(potentialSegmentsForPresynapticCell_, o.potentialSegmentsForPresynapticCell_));
+  NTA_CHECK(samePresynapticLists(connectedSegmentsForPresynapticCell_, o.connectedSegmentsForPresynapticCell_));
 
   NTA_CHECK (timeseries_ == o.timeseries_ ) << "Connections equals: timeseries_";
   NTA_CHECK (previousUpdates_ == o.previousUpdates_ ) << "Connections equals: previousUpdates_";
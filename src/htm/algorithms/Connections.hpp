@@ -22,8 +22,10 @@
 #ifndef NTA_CONNECTIONS_HPP
 #define NTA_CONNECTIONS_HPP
 
+#include <algorithm>
 #include <limits>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <set>
 #include <utility>
@@ -33,6 +35,8 @@
 #include <htm/types/Types.hpp>
 #include <htm/types/Serializable.hpp>
 #include <htm/types/Sdr.hpp>
+#include <htm/types/SdrBatch.hpp>
+#include <htm/utils/ThreadPool.hpp>
 
 namespace htm {
 
@@ -240,6 +244,15 @@ public:
    */
   virtual void onUpdateSynapsePermanence(Synapse synapse,
                                          Permanence permanence) {}
+
+  /**
+   * Called after Connections::compact renumbered the segments and synapses.
+   * The segment which was `s` is now `segmentRemap[s]`, likewise for the
+   * synapses.  Destroyed segments and synapses map to
+   * `std::numeric_limits<Segment / Synapse>::max()`.
+   */
+  virtual void onCompact(const std::vector<Segment> &segmentRemap,
+                         const std::vector<Synapse> &synapseRemap) {}
 };
 
 /**
@@ -362,6 +375,20 @@ public:
                         const CellIdx presynapticCell,
                         Permanence permanence);
 
+  /**
+   * Creates many synapses on a segment, the same as calling createSynapse for
+   * each of the presynaptic cells in order.  If the segment has no synapses
+   * yet and the presynaptic cells are sorted and unique, this skips the
+   * search for duplicate synapses and reserves all of the memory up front.
+   *
+   * @param segment          Segment to create synapses on.
+   * @param presynapticCells Cells to synapse on.
+   * @param permanences      Initial permanence of each new synapse.
+   */
+  void createSynapses(const Segment segment,
+                      const std::vector<CellIdx> &presynapticCells,
+                      const std::vector<Permanence> &permanences);
+
 
 
   /**
@@ -573,6 +600,146 @@ public:
   std::vector<SynapseIdx> computeActivity(const std::vector<CellIdx> &activePresynapticCells, 
 		                          const bool learn = true);
 
+  /**
+   * Compute the segment excitations into caller owned buffers, which are
+   * reused from call to call.  Instead of allocating and zeroing vectors of
+   * length segmentFlatListLength() every time, this only zeroes the entries
+   * which were touched by the previous call, and grows the buffers as new
+   * segments are created.
+   *
+   * The buffers must be passed to every call unmodified: all entries must be
+   * zero except for the segments listed in touchedSegments.  Start with empty
+   * vectors.
+   *
+   * @param numActiveConnectedSynapsesForSegment
+   * Output, active connected synapse counts per segment.
+   *
+   * @param numActivePotentialSynapsesForSegment
+   * (optional) Output, active potential synapse counts per segment.  This
+   * includes the connected synapses.
+   *
+   * @param touchedSegments
+   * Output, every segment which has at least one active synapse, ie a
+   * non-zero count (potential count, if computed), in no particular order.
+   *
+   * @param activePresynapticCells
+   * Active cells in the input.
+   *
+   * @param bool learn : enable learning updates (default true)
+   */
+  void computeActivity(std::vector<SynapseIdx> &numActiveConnectedSynapsesForSegment,
+                       std::vector<SynapseIdx> &numActivePotentialSynapsesForSegment,
+                       std::vector<Segment>    &touchedSegments,
+                       const std::vector<CellIdx> &activePresynapticCells,
+                       const bool learn = true);
+
+  void computeActivity(std::vector<SynapseIdx> &numActiveConnectedSynapsesForSegment,
+                       std::vector<Segment>    &touchedSegments,
+                       const std::vector<CellIdx> &activePresynapticCells,
+                       const bool learn = true);
+
+  /**
+   * Computes the number of active connected synapses of every segment for
+   * several inputs at once.  The result for each input is the same as from
+   * computeActivity without learning.  The connected synapses of each
+   * presynaptic cell are visited once for all the inputs in which that cell is
+   * active, so pass a block of inputs whose buffers together fit in the cache.
+   *
+   * Unlike computeActivity this does not change the Connections: it never
+   * compacts (see setAutoCompact) and keeps no timeseries state.  So it can be
+   * called from several threads at once, each with its own buffers.
+   *
+   * @param numActiveConnectedSynapsesForSegment  Output, resized to one
+   *        vector per input, each with one count per segment.
+   * @param inputs     The active presynaptic cells of each input.
+   * @param numInputs  Number of inputs.
+   */
+  void computeActivityBatch(std::vector<std::vector<SynapseIdx>> &numActiveConnectedSynapsesForSegment,
+                            const SDR *inputs, const size_t numInputs) const;
+
+  /**
+   * Same as above, for the inputs [begin, end) of a batch.
+   */
+  void computeActivityBatch(std::vector<std::vector<SynapseIdx>> &numActiveConnectedSynapsesForSegment,
+                            const SDRBatch &inputs, const size_t begin, const size_t end) const;
+
+  /**
+   * Number of threads used by computeActivity.  The active presynaptic cells
+   * are split between the threads.  The first thread counts into the output,
+   * the others into buffers of their own, of which only the touched segments
+   * are then added to the output.  The results, including the order of the
+   * touched segments, are identical to the single threaded computation.
+   *
+   * This is a run-time setting, it is not serialized.  Only large models
+   * (many segments and active cells) benefit from multiple threads.
+   *
+   * @param numThreads  1 (default) computes on the calling thread only,
+   *                    0 uses all of the hardware threads.
+   */
+  void setNumThreads(const UInt numThreads);
+  UInt getNumThreads() const noexcept
+    { return threadPool_ ? threadPool_->size() : 1u; }
+
+  /**
+   * Additionally store the synapses of each segment in a compressed sparse
+   * row (CSR) layout: every segment owns a contiguous slab inside of two
+   * parallel arrays, one of presynaptic cells and one of permanences
+   * (structure of arrays).  The per-segment methods (adaptSegment,
+   * raisePermanencesToThreshold, synapseCompetition, bumpSegment,
+   * createSynapse) then stream through these slabs instead of chasing Synapse
+   * indices into the SynapseData array, which greatly reduces cache misses on
+   * large models.  The slabs are compacted automatically once too much space
+   * is wasted by relocated slabs.  The results are the same as with the
+   * default storage, at the cost of some extra memory.
+   *
+   * This is a run-time setting, it is not serialized.  The slabs are derived
+   * data: they are built when this is turned on, and rebuilt on load.
+   *
+   * @param packed  false (default) to keep the synapses in SynapseData only.
+   */
+  void setPackedSynapses(const bool packed);
+
+  /**
+   * Removes the destroyed segments and synapses from the internal tables.
+   *
+   * Destroyed segments and synapses leave holes, which are reused by later
+   * creates, so segmentFlatListLength() and every per-segment buffer only
+   * shrink when this is called.  The live segments and synapses get new,
+   * dense indices: the segments are numbered cell by cell and the synapses
+   * segment by segment.  Within a cell (segment) they keep their relative
+   * order, so compareSegments gives the same order as before.  Everything
+   * else, like the order of segmentsForCell, stays the same.
+   *
+   * Any segment or synapse index held outside of this class is invalid
+   * afterwards.  Subscribers are given the remap tables, see
+   * ConnectionsEventHandler::onCompact.  The buffers of computeActivity may be
+   * passed on as they are.
+   */
+  void compact();
+
+  /**
+   * Automatically compact (see compact()) at the start of computeActivity
+   * when more than the given fraction of the segment or synapse indices are
+   * destroyed ones.  Because new segments reuse the lower indices of
+   * destroyed ones, compacting can change the order in which the TM breaks
+   * ties between segments, and so its results.
+   *
+   * This is a run-time setting, it is not serialized.
+   *
+   * @param maxDestroyedFraction  in range (0, 1], or 0 (default) to never
+   *                              compact automatically.
+   */
+  void setAutoCompact(const Real maxDestroyedFraction);
+  Real getAutoCompact() const noexcept { return autoCompact_; }
+
+  /**
+   * @returns The threads behind setNumThreads, or nullptr when computing on
+   * the calling thread only.  The owner of the Connections (TM, SP) may use
+   * them for its own loops.
+   */
+  ThreadPool *getThreadPool() const noexcept
+    { return threadPool_.get(); }
+
   /**
    * The primary method in charge of learning.   Adapts the permanence values of
    * the synapses based on the input SDR.  Learning is applied to a single
@@ -580,6 +747,10 @@ public:
    * bits that are turned on, and decreased for synapses connected to inputs
    * bits that are turned off.
    *
+   * The new permanences are computed for the whole segment at once (with
+   * AVX2 instructions when the CPU has them), then only the synapses which
+   * cross the connected threshold go through updateSynapsePermanence.
+   *
    * @param segment  Index of segment to apply learning to.  Is returned by 
    *        method getSegment.
    * @param inputVector  An SDR
@@ -610,6 +781,62 @@ public:
   void raisePermanencesToThreshold(const Segment    segment,
                                    const UInt       segmentThreshold);
 
+  /**
+   * Learns on many segments at once.  This is the same as calling, for each
+   * segment in order:
+   *
+   *     adaptSegment( segment, inputs, increment, decrement );
+   *     raisePermanencesToThreshold( segment, segmentThreshold );
+   *
+   * The segments are split between the threads, see setNumThreads.  Each
+   * thread updates the permanences of its own segments, while the synapses
+   * which get (dis)connected are only recorded.  Afterwards they are moved
+   * between the presynaptic maps (and the event handlers are notified) in
+   * the order of the segments, so the result is identical to the single
+   * threaded computation.
+   *
+   * Timeseries mode and pruning are not supported in parallel, with
+   * timeseries mode this always runs on the calling thread.
+   *
+   * @param segments  Segments to learn on.  No segment may be listed twice.
+   */
+  void adaptSegments(const std::vector<Segment> &segments,
+                     const SDR &inputs,
+                     const Permanence increment,
+                     const Permanence decrement,
+                     const UInt segmentThreshold = 0);
+
+  /**
+   * Learning from the threads of the owner, see getThreadPool.  This is for
+   * owners which split their own loop between the threads and learn on
+   * segments inside of it, like the TemporalMemory does.
+   *
+   * adaptSegmentDeferred is adaptSegment, except that it may be called
+   * concurrently from the chunks of a parallelFor, for distinct segments.  It
+   * only writes the permanences of the segment: the synapses which get
+   * (dis)connected or pruned are recorded for the chunk.  Afterwards each
+   * call to applyDeferredAdaptation makes the recorded changes of the next
+   * segment of the chunk, in the order they were adapted.  Applying the chunks
+   * in order leaves the Connections as if adaptSegment had been called on the
+   * segments one by one.  Other changes may be made in between the calls, as
+   * long as they don't touch the segments which are not applied yet.
+   *
+   * Call prepareDeferredAdaptations before the parallelFor, and make the
+   * inputs dense beforehand (see SDR::getDense).  Every adapted segment must
+   * be applied.  Timeseries mode is not supported.
+   *
+   * @param chunk  The chunk of the parallelFor which is calling.
+   */
+  void prepareDeferredAdaptations();
+  void adaptSegmentDeferred(const Segment segment,
+                            const SDR &inputs,
+                            const Permanence increment,
+                            const Permanence decrement,
+                            const bool pruneZeroSynapses,
+                            const UInt segmentThreshold,
+                            const UInt chunk);
+  void applyDeferredAdaptation(const UInt chunk);
+
 
   /**
    *  iteration: ever increasing step count. 
@@ -651,6 +878,14 @@ public:
    */
   void bumpSegment(const Segment segment, const Permanence delta);
 
+  /**
+   * Calls bumpSegment for each of the segments, split between the threads.
+   * See adaptSegments.
+   *
+   * @param segments  Segments to bump.  No segment may be listed twice.
+   */
+  void bumpSegments(const std::vector<Segment> &segments, const Permanence delta);
+
   /**
    * Destroy the synapses with the lowest permanence values.  This method is
    * useful for making room for more synapses on a segment which is already
@@ -683,10 +918,15 @@ public:
     ar(CEREAL_NVP(destroyedSynapses_));
     ar(CEREAL_NVP(destroyedSegments_));
 
-    ar(CEREAL_NVP(potentialSynapsesForPresynapticCell_));
-    ar(CEREAL_NVP(connectedSynapsesForPresynapticCell_));
-    ar(CEREAL_NVP(potentialSegmentsForPresynapticCell_));
-    ar(CEREAL_NVP(connectedSegmentsForPresynapticCell_));
+    // The presynaptic maps are archived in their original (hash map) layout.
+    const auto potentialSynapses = toArchiveMap_(potentialSynapsesForPresynapticCell_);
+    const auto connectedSynapses = toArchiveMap_(connectedSynapsesForPresynapticCell_);
+    const auto potentialSegments = toArchiveMap_(potentialSegmentsForPresynapticCell_);
+    const auto connectedSegments = toArchiveMap_(connectedSegmentsForPresynapticCell_);
+    ar(cereal::make_nvp("potentialSynapsesForPresynapticCell_", potentialSynapses));
+    ar(cereal::make_nvp("connectedSynapsesForPresynapticCell_", connectedSynapses));
+    ar(cereal::make_nvp("potentialSegmentsForPresynapticCell_", potentialSegments));
+    ar(cereal::make_nvp("connectedSegmentsForPresynapticCell_", connectedSegments));
 
     ar(CEREAL_NVP(timeseries_));
     ar(CEREAL_NVP(previousUpdates_));
@@ -709,10 +949,21 @@ public:
     ar(CEREAL_NVP(destroyedSynapses_));
     ar(CEREAL_NVP(destroyedSegments_));
 
-    ar(CEREAL_NVP(potentialSynapsesForPresynapticCell_));
-    ar(CEREAL_NVP(connectedSynapsesForPresynapticCell_));
-    ar(CEREAL_NVP(potentialSegmentsForPresynapticCell_));
-    ar(CEREAL_NVP(connectedSegmentsForPresynapticCell_));
+    ArchiveMap_<Synapse> potentialSynapses, connectedSynapses;
+    ArchiveMap_<Segment> potentialSegments, connectedSegments;
+    ar(cereal::make_nvp("potentialSynapsesForPresynapticCell_", potentialSynapses));
+    ar(cereal::make_nvp("connectedSynapsesForPresynapticCell_", connectedSynapses));
+    ar(cereal::make_nvp("potentialSegmentsForPresynapticCell_", potentialSegments));
+    ar(cereal::make_nvp("connectedSegmentsForPresynapticCell_", connectedSegments));
+    size_t numPresyns = 0u;
+    for( const auto &entry : potentialSynapses ) numPresyns = std::max<size_t>(numPresyns, entry.first + 1u);
+    for( const auto &entry : connectedSynapses ) numPresyns = std::max<size_t>(numPresyns, entry.first + 1u);
+    for( const auto &entry : potentialSegments ) numPresyns = std::max<size_t>(numPresyns, entry.first + 1u);
+    for( const auto &entry : connectedSegments ) numPresyns = std::max<size_t>(numPresyns, entry.first + 1u);
+    fromArchiveMap_(potentialSynapses, numPresyns, potentialSynapsesForPresynapticCell_);
+    fromArchiveMap_(connectedSynapses, numPresyns, connectedSynapsesForPresynapticCell_);
+    fromArchiveMap_(potentialSegments, numPresyns, potentialSegmentsForPresynapticCell_);
+    fromArchiveMap_(connectedSegments, numPresyns, connectedSegmentsForPresynapticCell_);
 
     ar(CEREAL_NVP(timeseries_));
     ar(CEREAL_NVP(previousUpdates_));
@@ -720,6 +971,8 @@ public:
 
     ar(CEREAL_NVP(prunedSyns_));
     ar(CEREAL_NVP(prunedSegs_));
+
+    rebuildSlabs_(); // the packed synapse store is not serialized, see setPackedSynapses.
   }
 
   /**
@@ -731,6 +984,12 @@ public:
 
   constexpr Permanence getConnectedThreshold() const noexcept { return connectedThreshold_; }
 
+  /**
+   * @retval True if the synapses are (also) kept in the packed CSR store.
+   * See setPackedSynapses.
+   */
+  bool packedSynapses() const noexcept { return packed_; }
+
   /**
    * Gets the number of segments.
    *
@@ -782,6 +1041,8 @@ public:
    * while this instance is still using it. It will be deleted on
    * `unsubscribe`.
    *
+   * Subscriptions are not copied along with the Connections.
+   *
    * @param handler
    * An object implementing the ConnectionsEventHandler interface
    *
@@ -835,11 +1096,159 @@ protected:
                               std::vector<Synapse> &synapsesForPresynapticCell,
                               std::vector<Segment> &segmentsForPresynapticCell);
 
+  /**
+   * The presynaptic maps used to be hash maps from the presynaptic cell to its
+   * list, without empty lists.  They are still archived that way, so that the
+   * archives of older versions load and vice versa.
+   */
+  struct identity { constexpr size_t operator()( const CellIdx t ) const noexcept { return t; };   };	//TODO in c++20 use std::identity 
+  template<typename T>
+  using ArchiveMap_ = std::unordered_map<CellIdx, std::vector<T>, identity>;
+
+  template<typename T>
+  static ArchiveMap_<T> toArchiveMap_(const std::vector<std::vector<T>> &lists) {
+    ArchiveMap_<T> map;
+    for( size_t cell = 0; cell < lists.size(); cell++ ) {
+      if( not lists[cell].empty() ) {
+        map.emplace( static_cast<CellIdx>(cell), lists[cell] );
+      }
+    }
+    return map;
+  }
+
+  template<typename T>
+  static void fromArchiveMap_(const ArchiveMap_<T> &map, const size_t numPresyns,
+                              std::vector<std::vector<T>> &lists) {
+    lists.assign( numPresyns, std::vector<T>() );
+    for( const auto &entry : map ) {
+      lists[entry.first] = entry.second;
+    }
+  }
+
   /** 
    *  Remove least useful Segment from cell. 
    */
   void pruneSegment_(const CellIdx& cell);
 
+  /**
+   * Packed synapse store helpers, only used if packed_ is set.
+   *
+   * appendToSlab_ adds the synapse to the end of its segment's slab, moving the
+   * slab to the end of the arrays (with doubled capacity) if it is full.
+   * removeFromSlab_ removes the synapse by moving the last synapse of the slab
+   * over it, which mirrors how destroySynapse edits SegmentData::synapses.
+   * rebuildSlabs_ discards the slabs and lays them out again compactly, in
+   * segment order, from the authoritative synapses_ data.
+   */
+  void appendToSlab_(const Segment segment, const Synapse synapse);
+
+  /**
+   * createSynapse without the search for a duplicate synapse.
+   */
+  Synapse createNewSynapse_(const Segment segment,
+                            const CellIdx presynapticCell,
+                            const Permanence permanence);
+  void removeFromSlab_(const Segment segment, const Synapse synapse);
+  void rebuildSlabs_();
+
+  /**
+   * Add the number of active presynaptic cells to `counts[segment]` for each
+   * segment listed in segmentsForPresynapticCell.  Segments whose count
+   * was zero are appended to `touched`.  Uses threadPool_ if set.
+   */
+  void scatter_(const std::vector<std::vector<Segment>> &segmentsForPresynapticCell,
+                const std::vector<CellIdx> &activePresynapticCells,
+                std::vector<SynapseIdx> &counts,
+                std::vector<Segment> &touched);
+  void scatterParallel_(const std::vector<std::vector<Segment>> &segmentsForPresynapticCell,
+                        const std::vector<CellIdx> &activePresynapticCells,
+                        std::vector<SynapseIdx> &counts,
+                        std::vector<Segment> &touched);
+
+  /**
+   * The counting of computeActivityBatch.  The activity holds one
+   * (cell << 32 | input) pair per active presynaptic cell of each input, it
+   * is sorted here.
+   */
+  void countActivityBatch_(std::vector<std::vector<SynapseIdx>> &counts,
+                           const size_t numInputs,
+                           std::vector<UInt64> &activity) const;
+
+  // compact() if the setAutoCompact policy says so.
+  void maybeCompact_();
+
+  // Reused buffers of the learning methods: the segment's synapses in SoA
+  // layout when not packed, and their permanences after the update.  The
+  // permanences are also used for the partial sorts.
+  struct LearnScratch_ {
+    std::vector<CellIdx>    presynapticCells;
+    std::vector<Permanence> permanences;
+    std::vector<Permanence> adapted;
+  };
+
+  // A synapse which was (dis)connected by adaptSegments, bumpSegments or
+  // adaptSegmentDeferred, whose presynaptic maps are not updated yet.
+  struct Crossing_ {
+    Synapse    synapse;
+    Permanence permanence;
+  };
+
+  // A segment adapted by adaptSegmentDeferred.  Its crossings and pruned
+  // synapses end at these indices of the chunk's logs, and begin where the
+  // previous segment's end.
+  struct DeferredAdaptation_ {
+    Segment segment;
+    bool    pruneZeroSynapses;
+    UInt    segmentThreshold;
+    size_t  crossingsEnd;
+    size_t  prunedEnd;
+  };
+
+  /**
+   * Implementations of the learning methods, using the given buffers.  If
+   * `crossings` is set then the synapses which get (dis)connected are
+   * appended to it instead of being moved between the presynaptic maps, see
+   * moveSynapse_.  Likewise if `pruned` is set then adaptSegment_ appends the
+   * synapses to prune to it, instead of calling pruneSegment_.  Otherwise they
+   * only touch the data of the given segment.
+   */
+  void adaptSegment_(const Segment segment, const SDR &inputs,
+                     const Permanence increment, const Permanence decrement,
+                     const bool pruneZeroSynapses, const UInt segmentThreshold,
+                     LearnScratch_ &scratch, std::vector<Crossing_> *crossings,
+                     std::vector<Synapse> *pruned);
+  void raisePermanencesToThreshold_(const Segment segment, const UInt segmentThreshold,
+                                    LearnScratch_ &scratch, std::vector<Crossing_> *crossings);
+  void bumpSegment_(const Segment segment, const Permanence delta,
+                    std::vector<Crossing_> *crossings);
+  void updateSynapsePermanence_(const Synapse synapse, Permanence permanence,
+                                std::vector<Crossing_> *crossings);
+
+  // The n'th (1-based) greatest permanence of the segment's synapses, the
+  // segment must have at least n synapses.  Uses the numConnected of the
+  // segment to only look at one side of the connected threshold.
+  Permanence nthGreatestPermanence_(const Segment segment, const SynapseIdx n,
+                                    LearnScratch_ &scratch) const;
+
+  // Moves a synapse whose permanence crossed the connected threshold between
+  // the potential and connected presynaptic maps, and notifies the handlers.
+  void moveSynapse_(const Synapse synapse, const Permanence permanence);
+
+  // Moves the synapses in threadCrossings_, in chunk order.
+  void moveCrossedSynapses_();
+
+  // Destroys the pruned synapses of a segment, and then the segment if fewer
+  // than segmentThreshold synapses are left.
+  void pruneSegment_(const Segment segment, const Synapse *prunedBegin,
+                     const Synapse *prunedEnd, const UInt segmentThreshold);
+
+  // First pass of adaptSegment: the new permanences of a segment's synapses.
+  // Uses SIMD instructions when the CPU has them.
+  static void adaptPermanences_(const CellIdx *presynapticCells, const Permanence *permanences,
+                                Permanence *out, const size_t size,
+                                const ElemDense *input, const size_t inputSize,
+                                const Permanence increment, const Permanence decrement);
+
 private:
   std::vector<CellData>    cells_;
   std::vector<SegmentData> segments_;
@@ -850,13 +1259,13 @@ private:
   UInt32 iteration_ = 0;
 
   // Extra bookkeeping for faster computing of segment activity.
- 
-  struct identity { constexpr size_t operator()( const CellIdx t ) const noexcept { return t; };   };	//TODO in c++20 use std::identity 
-
-  std::unordered_map<CellIdx, std::vector<Synapse>, identity> potentialSynapsesForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Synapse>, identity> connectedSynapsesForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Segment>, identity> potentialSegmentsForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Segment>, identity> connectedSegmentsForPresynapticCell_;
+  // These are indexed directly by the presynaptic cell, as the cell indices
+  // are dense. They are grown on demand (see createSynapse) to cover the
+  // largest presynaptic cell seen so far, and all four always have the same size.
+  std::vector<std::vector<Synapse>> potentialSynapsesForPresynapticCell_;
+  std::vector<std::vector<Synapse>> connectedSynapsesForPresynapticCell_;
+  std::vector<std::vector<Segment>> potentialSegmentsForPresynapticCell_;
+  std::vector<std::vector<Segment>> connectedSegmentsForPresynapticCell_;
 
   // These three members should be used when working with highly correlated
   // data. The vectors store the permanence changes made by adaptSegment.
@@ -868,9 +1277,47 @@ private:
   Synapse prunedSyns_ = 0; //how many synapses have been removed?
   Segment prunedSegs_ = 0;
 
+  // Optional packed (CSR, structure of arrays) copy of the synapses.
+  // Segment `seg` owns the range [slabOffset_[seg], slabOffset_[seg] + slabCapacity_[seg])
+  // of slabPresynapticCell_ and slabPermanence_, of which the first
+  // numSynapses(seg) entries are in use, in the same order as SegmentData::synapses.
+  // slabIndex_[syn] is the position of the synapse within its segment's slab.
+  // See setPackedSynapses.  Not serialized.
+  bool packed_ = false;
+  std::vector<Synapse>    slabOffset_;
+  std::vector<Synapse>    slabCapacity_;
+  std::vector<Synapse>    slabIndex_;
+  std::vector<CellIdx>    slabPresynapticCell_;
+  std::vector<Permanence> slabPermanence_;
+  LearnScratch_ scratch_;
+
+  // Optional threads for computeActivity, see setNumThreads.  Not serialized.
+  // threadCounts_[t - 1] is the (all zero between calls) private counter of
+  // chunk t > 0, threadTouched_[t] lists the segments which chunk t touched.
+  std::shared_ptr<ThreadPool> threadPool_;
+  std::vector<std::vector<SynapseIdx>> threadCounts_;
+  std::vector<std::vector<Segment>>    threadTouched_;
+  // Per chunk buffers of adaptSegments, bumpSegments and adaptSegmentDeferred.
+  std::vector<LearnScratch_>           threadScratch_;
+  std::vector<std::vector<Crossing_>>  threadCrossings_;
+  std::vector<std::vector<Synapse>>    threadPruned_;
+  std::vector<std::vector<DeferredAdaptation_>> threadDeferred_;
+  std::vector<size_t>                  threadDeferredNext_;
+
+  // See setAutoCompact.  Not serialized.
+  Real autoCompact_ = 0.0f;
+
   //for listeners //TODO listeners are not serialized, nor included in equals ==
+  // A subscription belongs to the instance it was made on: copies start
+  // without any, and assigning to a Connections drops its subscriptions (as
+  // initialize does).  Otherwise a copy would notify the original's handlers.
+  struct EventHandlers_ : public std::map<UInt32, ConnectionsEventHandler *> {
+    EventHandlers_() = default;
+    EventHandlers_(const EventHandlers_ &) {}
+    EventHandlers_ &operator=(const EventHandlers_ &) { clear(); return *this; }
+  };
   UInt32 nextEventToken_;
-  std::map<UInt32, ConnectionsEventHandler *> eventHandlers_;
+  EventHandlers_ eventHandlers_;
 }; // end class Connections
 
 } // end namespace htm
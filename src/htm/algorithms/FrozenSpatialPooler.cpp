@@ -0,0 +1,195 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of the FrozenSpatialPooler class
+ */
+
+#include <algorithm>
+#include <numeric> // partial_sum
+
+#include <htm/algorithms/FrozenSpatialPooler.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace std;
+using namespace htm;
+
+
+FrozenSpatialPooler::FrozenSpatialPooler() {
+  setNumThreads(1u);
+}
+
+
+FrozenSpatialPooler::FrozenSpatialPooler(const SpatialPooler &sp)
+  : inputDimensions_(  sp.getInputDimensions() ),
+    columnDimensions_( sp.getColumnDimensions() ),
+    numInputs_(  sp.getNumInputs() ),
+    numColumns_( sp.getNumColumns() ),
+    globalInhibition_(  sp.isInhibitionGlobal_() ),
+    density_(           sp.inhibitionDensity_() ),
+    stimulusThreshold_( sp.getStimulusThreshold() ),
+    inhibitionRadius_(  sp.getInhibitionRadius() ),
+    wrapAround_(        sp.getWrapAround() )
+{
+  if( sp.getBoostStrength() >= static_cast<Real>(htm::Epsilon) ) {
+    boostFactors_.resize( numColumns_ );
+    sp.getBoostFactors( boostFactors_.data() );
+  }
+
+  // Transpose the connected synapses of the columns into rows per input.
+  const Connections &connections = sp.getConnections();
+  const Permanence connected = connections.getConnectedThreshold();
+  inputOffsets_.assign( numInputs_ + 1u, 0u );
+  for(CellIdx column = 0; column < numColumns_; column++) {
+    for(const auto syn : connections.synapsesForSegment( column )) {
+      const auto &data = connections.dataForSynapse( syn );
+      if( data.permanence >= connected ) {
+        inputOffsets_[ data.presynapticCell + 1u ]++;
+      }
+    }
+  }
+  std::partial_sum( inputOffsets_.begin(), inputOffsets_.end(), inputOffsets_.begin() );
+  inputColumns_.resize( inputOffsets_.back() );
+  vector<UInt> next( inputOffsets_.begin(), inputOffsets_.end() - 1u );
+  for(CellIdx column = 0; column < numColumns_; column++) {
+    for(const auto syn : connections.synapsesForSegment( column )) {
+      const auto &data = connections.dataForSynapse( syn );
+      if( data.permanence >= connected ) {
+        inputColumns_[ next[ data.presynapticCell ]++ ] = column;
+      }
+    }
+  }
+  setNumThreads(1u);
+}
+
+
+void FrozenSpatialPooler::setNumThreads(const UInt numThreads) {
+  threadPool_.reset();
+  if( numThreads != 1u ) {
+    threadPool_ = std::make_shared<ThreadPool>( numThreads );
+    if( threadPool_->size() == 1u ) { // numThreads == 0 on a single core machine.
+      threadPool_.reset();
+    }
+  }
+  scratch_.resize( getNumThreads() );
+}
+
+
+const vector<SynapseIdx> &FrozenSpatialPooler::compute(const SDR &input, SDR &active) {
+  compute_( input, active, scratch_[0] );
+  return scratch_[0].overlaps;
+}
+
+
+void FrozenSpatialPooler::compute(const vector<SDR> &inputs, vector<SDR> &actives) {
+  NTA_CHECK( actives.size() == inputs.size() )
+      << "FrozenSpatialPooler needs one output SDR per input, got " << actives.size()
+      << " for " << inputs.size() << " inputs";
+
+  if( not threadPool_ ) {
+    for(size_t i = 0; i < inputs.size(); i++) {
+      compute_( inputs[i], actives[i], scratch_[0] );
+    }
+    return;
+  }
+  threadPool_->parallelFor( inputs.size(), [&](size_t begin, size_t end, UInt chunk) {
+    for(size_t i = begin; i < end; i++) {
+      compute_( inputs[i], actives[i], scratch_[chunk] );
+    }
+  });
+}
+
+
+void FrozenSpatialPooler::compute_(const SDR &input, SDR &active, Scratch_ &scratch) const {
+  input.reshape(  inputDimensions_ );
+  active.reshape( columnDimensions_ );
+
+  // Clear the overlaps of the previous input.
+  auto &overlaps = scratch.overlaps;
+  auto &boosted  = scratch.boosted;
+  if( overlaps.size() != numColumns_ ) {
+    overlaps.assign( numColumns_, 0u );
+    boosted.assign(  numColumns_, 0.0f );
+  }
+  for(const auto column : scratch.touched) {
+    overlaps[column] = 0u;
+    boosted[column]  = 0.0f;
+  }
+
+  // Count the connected synapses to the active inputs.  Like
+  // Connections::computeActivity, make room for the worst case so that the
+  // loop appends the touched columns without branching.
+  const auto &sparse = input.getSparse();
+  auto &touched = scratch.touched;
+  size_t maxTouched = 0u;
+  for(const auto cell : sparse) {
+    maxTouched += inputOffsets_[cell + 1u] - inputOffsets_[cell];
+  }
+  touched.resize( maxTouched + 1u );
+  size_t numTouched = 0u;
+  const CellIdx *columns = inputColumns_.data();
+  for(const auto cell : sparse) {
+    for(UInt i = inputOffsets_[cell]; i < inputOffsets_[cell + 1u]; i++) {
+      const CellIdx column = columns[i];
+      touched[numTouched] = column;
+      numTouched += (overlaps[column]++ == 0u);
+    }
+  }
+  touched.resize( numTouched );
+
+  // Boost, and find the columns which can win.  If most columns have an
+  // overlap then do it in one pass over all of them, see
+  // SpatialPooler::boostOverlaps_.  Otherwise only visit the touched columns,
+  // and sort the candidates.
+  auto &candidates = scratch.candidates;
+  const Real *factors = boostFactors_.empty() ? nullptr : boostFactors_.data();
+  if( touched.size() * 8u >= numColumns_ ) {
+    SpatialPooler::boostOverlaps_( overlaps, factors, boosted, stimulusThreshold_, &candidates );
+  }
+  else {
+    candidates.clear();
+    for(const auto column : touched) {
+      const Real overlap = static_cast<Real>(overlaps[column]);
+      boosted[column] = factors ? overlap * factors[column] : overlap;
+      if( boosted[column] > 0.0f and boosted[column] >= stimulusThreshold_ ) {
+        candidates.push_back( column );
+      }
+    }
+    std::sort( candidates.begin(), candidates.end() );
+  }
+
+  auto activeVector = globalInhibition_
+      ? SpatialPooler::inhibitColumnsGlobal_( boosted, density_, stimulusThreshold_, &candidates )
+      : SpatialPooler::inhibitColumnsLocal_(  boosted, density_, stimulusThreshold_, columnDimensions_,
+                                              inhibitionRadius_, wrapAround_, &candidates );
+  std::sort( activeVector.begin(), activeVector.end() );
+  active.setSparse( activeVector );
+}
+
+
+bool FrozenSpatialPooler::operator==(const FrozenSpatialPooler &other) const {
+  return inputDimensions_   == other.inputDimensions_   and
+         columnDimensions_  == other.columnDimensions_  and
+         globalInhibition_  == other.globalInhibition_  and
+         density_           == other.density_           and
+         stimulusThreshold_ == other.stimulusThreshold_ and
+         inhibitionRadius_  == other.inhibitionRadius_  and
+         wrapAround_        == other.wrapAround_        and
+         boostFactors_      == other.boostFactors_      and
+         inputOffsets_      == other.inputOffsets_      and
+         inputColumns_      == other.inputColumns_;
+}
@@ -0,0 +1,187 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the FrozenSpatialPooler class
+ */
+
+#ifndef NTA_FROZEN_SPATIAL_POOLER_HPP
+#define NTA_FROZEN_SPATIAL_POOLER_HPP
+
+#include <memory>
+#include <vector>
+
+#include <htm/algorithms/SpatialPooler.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/types/Serializable.hpp>
+#include <htm/types/Types.hpp>
+#include <htm/utils/ThreadPool.hpp>
+
+namespace htm {
+
+/**
+ * FrozenSpatialPooler class
+ *
+ * An immutable, inference only copy of a trained SpatialPooler.  It computes
+ * exactly the same active columns as SpatialPooler::compute with learning
+ * disabled, but it keeps only what that needs: the connected synapses, the
+ * boost factors and the inhibition parameters.
+ *
+ * The connected synapses are stored as a compressed sparse row matrix from
+ * each input to the columns which it is connected to.  The overlaps are
+ * computed by visiting only the rows of the active inputs, and only the
+ * columns with an overlap are boosted and considered by the inhibition.
+ *
+ * Example usage:
+ *
+ *     SpatialPooler sp(...);
+ *     <train the sp>
+ *     FrozenSpatialPooler frozen( sp );
+ *     frozen.save( file );
+ *     ...
+ *     frozen.compute( input, active ); // same as sp.compute( input, false, active )
+ */
+class FrozenSpatialPooler : public Serializable
+{
+public:
+  /**
+   * Empty model, for use with load.
+   */
+  FrozenSpatialPooler();
+
+  /**
+   * Copies the current state of the spatial pooler.  Later changes to the
+   * spatial pooler are not reflected in the frozen model.
+   */
+  explicit FrozenSpatialPooler(const SpatialPooler &sp);
+
+  /**
+   * Computes the active columns for the input, see SpatialPooler::compute.
+   *
+   * @param input   SDR of the input dimensions.
+   * @param active  Output, SDR of the column dimensions.
+   *
+   * @returns The overlap of each column.  The vector is owned by the model
+   * and is overwritten by the next call to compute.
+   */
+  const std::vector<SynapseIdx> &compute(const SDR &input, SDR &active);
+
+  /**
+   * Computes the active columns for many inputs at once.  The inputs are
+   * split between the threads, see setNumThreads.
+   *
+   * @param inputs   SDRs of the input dimensions.
+   * @param actives  Output, one SDR of the column dimensions per input.
+   */
+  void compute(const std::vector<SDR> &inputs, std::vector<SDR> &actives);
+
+  /**
+   * Number of threads which a batch of inputs is split between.  This is a
+   * run-time setting, it does not change the results.
+   *
+   * @param numThreads  1 (default) computes on the calling thread only,
+   *                    0 uses all of the hardware threads.
+   */
+  void setNumThreads(const UInt numThreads);
+  UInt getNumThreads() const
+    { return threadPool_ ? threadPool_->size() : 1u; }
+
+  const std::vector<UInt> &getInputDimensions() const  { return inputDimensions_; }
+  const std::vector<UInt> &getColumnDimensions() const { return columnDimensions_; }
+  UInt getNumInputs() const  { return numInputs_; }
+  UInt getNumColumns() const { return numColumns_; }
+
+  /**
+   * @returns Total number of connected synapses of all columns.
+   */
+  size_t numConnectedSynapses() const { return inputColumns_.size(); }
+
+  CerealAdapter;  // see Serializable.hpp
+  template<class Archive>
+  void save_ar(Archive &ar) const {
+    ar(CEREAL_NVP(inputDimensions_),
+       CEREAL_NVP(columnDimensions_),
+       CEREAL_NVP(numInputs_),
+       CEREAL_NVP(numColumns_),
+       CEREAL_NVP(globalInhibition_),
+       CEREAL_NVP(density_),
+       CEREAL_NVP(stimulusThreshold_),
+       CEREAL_NVP(inhibitionRadius_),
+       CEREAL_NVP(wrapAround_),
+       CEREAL_NVP(boostFactors_),
+       CEREAL_NVP(inputOffsets_),
+       CEREAL_NVP(inputColumns_));
+  }
+
+  template<class Archive>
+  void load_ar(Archive &ar) {
+    ar(CEREAL_NVP(inputDimensions_),
+       CEREAL_NVP(columnDimensions_),
+       CEREAL_NVP(numInputs_),
+       CEREAL_NVP(numColumns_),
+       CEREAL_NVP(globalInhibition_),
+       CEREAL_NVP(density_),
+       CEREAL_NVP(stimulusThreshold_),
+       CEREAL_NVP(inhibitionRadius_),
+       CEREAL_NVP(wrapAround_),
+       CEREAL_NVP(boostFactors_),
+       CEREAL_NVP(inputOffsets_),
+       CEREAL_NVP(inputColumns_));
+    setNumThreads( getNumThreads() );
+  }
+
+  bool operator==(const FrozenSpatialPooler &other) const;
+  bool operator!=(const FrozenSpatialPooler &other) const { return !operator==(other); }
+
+private:
+  // Buffers of a single compute, one per thread.  The dense overlaps are
+  // zero except for the touched columns of the previous compute.
+  struct Scratch_ {
+    std::vector<SynapseIdx> overlaps;
+    std::vector<Real>       boosted;
+    std::vector<CellIdx>    touched;
+    std::vector<CellIdx>    candidates;
+  };
+
+  void compute_(const SDR &input, SDR &active, Scratch_ &scratch) const;
+
+  std::vector<UInt> inputDimensions_;
+  std::vector<UInt> columnDimensions_;
+  UInt numInputs_  = 0u;
+  UInt numColumns_ = 0u;
+
+  // Inhibition, see SpatialPooler::inhibitColumns_.
+  bool globalInhibition_   = true;
+  Real density_            = 0.0f;
+  UInt stimulusThreshold_  = 0u;
+  UInt inhibitionRadius_   = 0u;
+  bool wrapAround_         = true;
+
+  // Empty if boosting is disabled.
+  std::vector<Real> boostFactors_;
+
+  // Connected synapses: the columns of input i are
+  // inputColumns_[ inputOffsets_[i] ... inputOffsets_[i + 1] ).
+  std::vector<UInt>    inputOffsets_;
+  std::vector<CellIdx> inputColumns_;
+
+  std::vector<Scratch_> scratch_;
+  std::shared_ptr<ThreadPool> threadPool_;
+};
+
+} // namespace htm
+#endif // NTA_FROZEN_SPATIAL_POOLER_HPP
@@ -44,19 +44,42 @@ void Classifier::initialize(const Real alpha)
 }
 
 
-PDF Classifier::infer(const SDR & pattern) const {
+namespace {
+  // View of the sparse indices of an SDR.
+  inline SDRBatch::Row sparseRow(const SDR &pattern) {
+    const auto &sparse = pattern.getSparse();
+    return SDRBatch::Row( sparse.data(), sparse.data() + sparse.size() );
+  }
+}
+
+
+PDF Classifier::infer(const SDR & pattern) const
+  { return infer_( pattern.size, sparseRow( pattern ) ); }
+
+
+vector<PDF> Classifier::infer(const SDRBatch & patterns) const {
+  vector<PDF> pdfs;
+  pdfs.reserve( patterns.size() );
+  for( size_t i = 0u; i < patterns.size(); i++ ) {
+    pdfs.push_back( infer_( patterns.getSDRSize(), patterns[i] ) );
+  }
+  return pdfs;
+}
+
+
+PDF Classifier::infer_(const UInt size, const SDRBatch::Row &pattern) const {
   // Check input dimensions, or if this is the first time the Classifier is used and dimensions
   // are unset, return zeroes.
-  NTA_CHECK(pattern.size > 0) << "No Data pased to Classifier. Pattern is empty.";
+  NTA_CHECK(size > 0) << "No Data pased to Classifier. Pattern is empty.";
   if (dimensions_ == 0) {
     NTA_WARN << "Classifier: must call `learn` before `infer`.";
     return PDF(numCategories_, std::nan("")); //empty array []
   }
-  NTA_ASSERT(pattern.size == dimensions_) << "Input SDR does not match previously seen size!";
+  NTA_ASSERT(size == dimensions_) << "Input SDR does not match previously seen size!";
 
   // Accumulate feed forward input.
   PDF probabilities( numCategories_, 0.0f );
-  for( const auto bit : pattern.getSparse() ) {
+  for( const auto bit : pattern ) {
     for( size_t i = 0; i < numCategories_; i++ ) {
       probabilities[i] += weights_[bit][i];
     }
@@ -80,18 +103,47 @@ void Classifier::learn(const SDR &pattern, UInt category)
 // If you have more than one category to be learned with this pattern,
 // pass in an array of categories using this overlay.
 void Classifier::learn(const SDR &pattern, const vector<UInt> &categoryIdxList)
+  { learn_( pattern.size, sparseRow( pattern ), categoryIdxList ); }
+
+
+void Classifier::learn(const SDRBatch &patterns, const vector<UInt> &categories)
+{
+  NTA_CHECK( categories.size() == patterns.size() )
+      << "Classifier needs one category per pattern, got " << categories.size()
+      << " for " << patterns.size() << " patterns";
+  std::vector<UInt> categoryList( 1u );
+  for( size_t i = 0u; i < patterns.size(); i++ ) {
+    categoryList[0] = categories[i];
+    learn_( patterns.getSDRSize(), patterns[i], categoryList );
+  }
+}
+
+
+void Classifier::learn(const SDRBatch &patterns, const vector<vector<UInt>> &categoryIdxLists)
+{
+  NTA_CHECK( categoryIdxLists.size() == patterns.size() )
+      << "Classifier needs one list of categories per pattern, got " << categoryIdxLists.size()
+      << " for " << patterns.size() << " patterns";
+  for( size_t i = 0u; i < patterns.size(); i++ ) {
+    learn_( patterns.getSDRSize(), patterns[i], categoryIdxLists[i] );
+  }
+}
+
+
+void Classifier::learn_(const UInt size, const SDRBatch::Row &pattern,
+                        const vector<UInt> &categoryIdxList)
 {
   // If this is the first time the Classifier is being used, weights are empty, 
   // so we set the dimensions to that of the input `pattern`
   if( dimensions_ == 0 ) {
-    dimensions_ = pattern.size;
-    while( weights_.size() < pattern.size ) {
+    dimensions_ = size;
+    while( weights_.size() < size ) {
       const auto initialEmptyWeights = PDF( numCategories_, 0.0f );
       weights_.push_back( initialEmptyWeights );
     }
   }
-  NTA_CHECK(pattern.size > 0) << "No Data passed to Classifier. Pattern is empty.";
-  NTA_ASSERT(pattern.size == dimensions_) << "Input SDR does not match previously seen size!";
+  NTA_CHECK(size > 0) << "No Data passed to Classifier. Pattern is empty.";
+  NTA_ASSERT(size == dimensions_) << "Input SDR does not match previously seen size!";
 
   // Check if this is a new category & resize the weights table to hold it.
   const auto maxCategoryIdx = *max_element(categoryIdxList.cbegin(), categoryIdxList.cend());
@@ -106,7 +158,7 @@ void Classifier::learn(const SDR &pattern, const vector<UInt> &categoryIdxList)
 
   // Compute errors and update weights.
   const auto& error = calculateError_(categoryIdxList, pattern);
-  for( const auto& bit : pattern.getSparse() ) {
+  for( const auto& bit : pattern ) {
     for(size_t i = 0u; i < numCategories_; i++) {
       weights_[bit][i] += alpha_ * error[i];
     }
@@ -116,9 +168,9 @@ void Classifier::learn(const SDR &pattern, const vector<UInt> &categoryIdxList)
 
 // Helper function to compute the error signal in learning.
 std::vector<Real64> Classifier::calculateError_(const std::vector<UInt> &categoryIdxList, 
-		                                const SDR &pattern) const {
+		                                const SDRBatch::Row &pattern) const {
   // compute predicted likelihoods
-  auto likelihoods = infer(pattern);
+  auto likelihoods = infer_(dimensions_, pattern);
 
   // Compute target likelihoods
   PDF targetDistribution(numCategories_ + 1u, 0.0f);
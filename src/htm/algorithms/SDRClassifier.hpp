@@ -42,6 +42,7 @@
 
 #include <htm/types/Types.hpp>
 #include <htm/types/Sdr.hpp>
+#include <htm/types/SdrBatch.hpp>
 #include <htm/types/Serializable.hpp>
 
 namespace htm {
@@ -142,6 +143,23 @@ public:
   void learn(const SDR & pattern, UInt categoryIdx);
   void learn(const SDR & pattern, const std::vector<UInt> & categoryIdxList);
 
+  /**
+   * Compute the likelihoods of each pattern of a batch, see infer above.
+   *
+   * @param patterns: Batch of SDRs with the same size as the learned patterns.
+   * @returns: One PDF per pattern.
+   */
+  std::vector<PDF> infer(const SDRBatch & patterns) const;
+
+  /**
+   * Learn each pattern of a batch in turn, see learn above.
+   *
+   * @param patterns:  Batch of active input bit SDRs.
+   * @param categories:  One category, or one list of categories, per pattern.
+   */
+  void learn(const SDRBatch & patterns, const std::vector<UInt> & categories);
+  void learn(const SDRBatch & patterns, const std::vector<std::vector<UInt>> & categoryIdxLists);
+
   CerealAdapter;
   template<class Archive>
   void save_ar(Archive & ar) const
@@ -175,9 +193,13 @@ private:
    */
   std::vector<std::vector<Real64>> weights_;
 
+  // infer & learn of one pattern, given by its size and its sparse indices.
+  PDF infer_(UInt size, const SDRBatch::Row &pattern) const;
+  void learn_(UInt size, const SDRBatch::Row &pattern, const std::vector<UInt> &categoryIdxList);
+
   // Helper function to compute the error signal for learning.
   std::vector<Real64> calculateError_(const std::vector<UInt> &bucketIdxList,
-                                      const SDR &pattern) const;
+                                      const SDRBatch::Row &pattern) const;
 };
 
 /**
@@ -23,12 +23,22 @@
 #include <algorithm>
 #include <iterator> //begin()
 #include <cmath> //fmod
+#include <functional> //greater
+#include <limits>
 #include <numeric> //iota
 
 #include <htm/algorithms/SpatialPooler.hpp>
+#include <htm/utils/ThreadPool.hpp>
 #include <htm/utils/Topology.hpp>
 #include <htm/utils/VectorHelpers.hpp>
 
+// AVX2 kernel for boostOverlaps_, selected at run time, see boostKernel.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(NTA_DOUBLE_PRECISION)
+  #define NTA_BOOST_AVX2
+  #include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace htm;
 
@@ -163,10 +173,7 @@ UInt SpatialPooler::getInhibitionRadius() const { return inhibitionRadius_; }
 
 void SpatialPooler::setInhibitionRadius(UInt inhibitionRadius) {
   NTA_ASSERT(inhibitionRadius > 0);
-  if (inhibitionRadius_ != inhibitionRadius) {
-    inhibitionRadius_ = inhibitionRadius;
-    neighborMap_ = Neighborhood::updateAllNeighbors(inhibitionRadius_, columnDimensions_, wrapAround_, /*skip_center=*/true);
-  }
+  inhibitionRadius_ = inhibitionRadius;
 }
 
 UInt SpatialPooler::getDutyCyclePeriod() const { return dutyCyclePeriod_; }
@@ -200,6 +207,20 @@ void SpatialPooler::setSpVerbosity(UInt spVerbosity) {
   spVerbosity_ = spVerbosity;
 }
 
+UInt SpatialPooler::getNumThreads() const { return connections_.getNumThreads(); }
+
+void SpatialPooler::setNumThreads(UInt numThreads) {
+  connections_.setNumThreads(numThreads);
+}
+
+void SpatialPooler::setLazyDutyCycles(bool lazy) {
+  if( not lazy ) {
+    normalizeDutyCycles_();
+  }
+  lazyDutyCycles_   = lazy;
+  weakColumnsValid_ = false; // not tracked unless lazy
+}
+
 bool SpatialPooler::getWrapAround() const { return wrapAround_; }
 
 void SpatialPooler::setWrapAround(bool wrapAround) { wrapAround_ = wrapAround; }
@@ -252,27 +273,39 @@ void SpatialPooler::setMinPctOverlapDutyCycles(Real minPctOverlapDutyCycles) {
 }
 
 void SpatialPooler::getBoostFactors(Real boostFactors[]) const { //TODO make vector
-  copy(boostFactors_.begin(), boostFactors_.end(), boostFactors);
+  if( not lazyBoostFactors_ ) {
+    copy(boostFactors_.begin(), boostFactors_.end(), boostFactors);
+    return;
+  }
+  for(UInt i = 0; i < numColumns_; i++) {
+    boostFactors[i] = boostFactor_(i);
+  }
 }
 
 void SpatialPooler::setBoostFactors(Real boostFactors[]) {
   boostFactors_.assign(&boostFactors[0], &boostFactors[numColumns_]);
+  lazyBoostFactors_ = false;
 }
 
 void SpatialPooler::getOverlapDutyCycles(Real overlapDutyCycles[]) const {
-  copy(overlapDutyCycles_.begin(), overlapDutyCycles_.end(), overlapDutyCycles);
+  const auto scaled = scaledDutyCycles_(overlapDutyCycles_);
+  copy(scaled.begin(), scaled.end(), overlapDutyCycles);
 }
 
 void SpatialPooler::setOverlapDutyCycles(const Real overlapDutyCycles[]) {
+  normalizeDutyCycles_();
   overlapDutyCycles_.assign(&overlapDutyCycles[0],
                             &overlapDutyCycles[numColumns_]);
+  weakColumnsValid_ = false;
 }
 
 void SpatialPooler::getActiveDutyCycles(Real activeDutyCycles[]) const {
-  copy(activeDutyCycles_.begin(), activeDutyCycles_.end(), activeDutyCycles);
+  const auto scaled = scaledDutyCycles_(activeDutyCycles_);
+  copy(scaled.begin(), scaled.end(), activeDutyCycles);
 }
 
 void SpatialPooler::setActiveDutyCycles(const Real activeDutyCycles[]) {
+  normalizeDutyCycles_();
   activeDutyCycles_.assign(&activeDutyCycles[0],
                            &activeDutyCycles[numColumns_]);
 }
@@ -285,6 +318,7 @@ void SpatialPooler::getMinOverlapDutyCycles(Real minOverlapDutyCycles[]) const {
 void SpatialPooler::setMinOverlapDutyCycles(const Real minOverlapDutyCycles[]) {
   minOverlapDutyCycles_.assign(&minOverlapDutyCycles[0],
                                &minOverlapDutyCycles[numColumns_]);
+  weakColumnsValid_ = false;
 }
 
 void SpatialPooler::getPotential(UInt column, UInt potential[]) const {
@@ -443,24 +477,17 @@ void SpatialPooler::initialize(
   activeDutyCycles_.assign(numColumns_, 0);
   minOverlapDutyCycles_.assign(numColumns_, 0.0);
   boostFactors_.assign(numColumns_, 1.0); //1 is neutral value for boosting
+  dutyCycleScale_   = 1.0;
+  lazyBoostFactors_ = false;
+  weakColumnsValid_ = false;
   boostedOverlaps_.resize(numColumns_);
+  overlaps_.clear();
+  overlapsTouched_.clear();
 
   inhibitionRadius_ = 0;
 
   connections_.initialize(numColumns_, synPermConnected_);
-  for (Size i = 0; i < numColumns_; ++i) {
-    connections_.createSegment( static_cast<CellIdx>(i) , 1 /* max segments per cell is fixed for SP to 1 */);
-
-    // Note: initMapPotential_ & initPermanence_ return dense arrays.
-    vector<UInt> potential = initMapPotential_((UInt)i, wrapAround_);
-    vector<Permanence> perm = initPermanence_(potential, initConnectedPct_);
-    for(size_t presyn = 0; presyn < numInputs_; presyn++) {
-      if( potential[presyn] )
-        connections_.createSynapse( static_cast<Segment>(i), static_cast<htm::CellIdx>(presyn), perm[presyn] );
-    }
-
-    connections_.raisePermanencesToThreshold( (Segment)i, stimulusThreshold_ );
-  }
+  initSynapses_();
 
   updateInhibitionRadius_();
 
@@ -471,16 +498,17 @@ void SpatialPooler::initialize(
 }
 
 
-const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool learn, SDR &active) {
+const vector<SynapseIdx> &SpatialPooler::compute(const SDR &input, const bool learn, SDR &active) {
   input.reshape(  inputDimensions_ );
   active.reshape( columnDimensions_ );
   updateBookeepingVars_(learn);
 
-  const auto& overlaps = connections_.computeActivity(input.getSparse(), learn);
+  connections_.computeActivity(overlaps_, overlapsTouched_, input.getSparse(), learn);
+  const auto& overlaps = overlaps_;
 
-  boostOverlaps_(overlaps, boostedOverlaps_);
-
-  auto activeVector = inhibitColumns_(boostedOverlaps_);
+  // Boost the overlaps, and in the same pass find the columns which can win.
+  boostOverlaps_(overlaps, boostedOverlaps_, &candidates_);
+  auto activeVector = inhibitColumns_(boostedOverlaps_, &candidates_);
   // Notify the active SDR that its internal data vector has changed.  Always
   // call SDR's setter methods even if when modifying the SDR's own data
   // inplace.
@@ -489,7 +517,7 @@ const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool lea
 
   if (learn) {
     adaptSynapses_(input, active);
-    updateDutyCycles_(overlaps, active);
+    updateDutyCycles_(overlapsTouched_, active.getSparse());
     bumpUpWeakColumns_();
     updateBoostFactors_();
     if (isUpdateRound_()) {
@@ -502,16 +530,232 @@ const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool lea
 }
 
 
-void SpatialPooler::boostOverlaps_(const vector<SynapseIdx> &overlaps, //TODO use Eigen sparse vector here
-                                   vector<Real> &boosted) const {
-  if(boostStrength_ < static_cast<Real>(htm::Epsilon)) { //boost ~ 0.0, we can skip these computations, just copy the data
-    boosted.assign(overlaps.begin(), overlaps.end());
+void SpatialPooler::compute(const vector<SDR> &inputs, const bool learn, vector<SDR> &actives) {
+  NTA_CHECK( actives.size() == inputs.size() )
+      << "SpatialPooler needs one output SDR per input, got " << actives.size()
+      << " for " << inputs.size() << " inputs";
+  if( learn ) {
+    for( size_t i = 0; i < inputs.size(); i++ ) {
+      compute( inputs[i], true, actives[i] );
+    }
     return;
   }
-  for (size_t i = 0; i < numColumns_; i++) {
-    boosted[i] = overlaps[i] * boostFactors_[i];
+
+  // Prepare the SDRs here, the threads below only read the inputs.
+  for( size_t i = 0; i < inputs.size(); i++ ) {
+    inputs[i].reshape( inputDimensions_ );
+    inputs[i].getSparse();
+    actives[i].reshape( columnDimensions_ );
+  }
+  computeBatch_( inputs.size(),
+      [&](vector<vector<SynapseIdx>> &overlaps, const size_t begin, const size_t size) {
+        connections_.computeActivityBatch( overlaps, &inputs[begin], size );
+      },
+      [&](const size_t input, UInt, vector<CellIdx> &active) {
+        actives[input].setSparse( active );
+      });
+}
+
+
+void SpatialPooler::compute(const SDRBatch &inputs, const bool learn, SDRBatch &actives) {
+  NTA_CHECK( inputs.getSDRSize() == numInputs_ )
+      << "SpatialPooler needs inputs of size " << numInputs_
+      << ", got a batch of size " << inputs.getSDRSize();
+  NTA_CHECK( &inputs != &actives );
+  actives.initialize( columnDimensions_ );
+  if( learn ) {
+    SDR input( inputDimensions_ );
+    SDR active( columnDimensions_ );
+    for( size_t i = 0; i < inputs.size(); i++ ) {
+      inputs.getSDR( i, input );
+      compute( input, true, active );
+      actives.push_back( active );
+    }
+    return;
+  }
+
+  // The first chunk appends to the actives, the others to their own batch,
+  // which are then appended in chunk order.
+  ThreadPool *threadPool = connections_.getThreadPool();
+  const UInt numChunks = threadPool == nullptr ? 1u : threadPool->size();
+  vector<SDRBatch> chunkActives( numChunks - 1u, actives );
+  computeBatch_( inputs.size(),
+      [&](vector<vector<SynapseIdx>> &overlaps, const size_t begin, const size_t size) {
+        connections_.computeActivityBatch( overlaps, inputs, begin, begin + size );
+      },
+      [&](size_t, const UInt chunk, vector<CellIdx> &active) {
+        (chunk == 0u ? actives : chunkActives[chunk - 1u]).push_back( active );
+      });
+  for( const auto &batch : chunkActives ) {
+    actives.append( batch );
+  }
+}
+
+
+void SpatialPooler::computeBatch_(const size_t numInputs,
+    const std::function<void(vector<vector<SynapseIdx>> &, size_t, size_t)> &computeOverlaps,
+    const std::function<void(size_t, UInt, vector<CellIdx> &)> &setActive) {
+  iterationNum_ += static_cast<UInt>(numInputs);
+
+  vector<Real> lazyFactors;
+  const Real *factors = nullptr;
+  if( boostStrength_ >= static_cast<Real>(htm::Epsilon) ) {
+    if( lazyBoostFactors_ ) {
+      lazyFactors.resize( numColumns_ );
+      getBoostFactors( lazyFactors.data() );
+      factors = lazyFactors.data();
+    }
+    else {
+      factors = boostFactors_.data();
+    }
+  }
+
+  // As many inputs per block as have overlaps fitting in about 256KB.
+  const size_t blockSize = std::max<size_t>( 1u, std::min<size_t>( 64u,
+      (256u * 1024u) / (sizeof(SynapseIdx) * numColumns_) ));
+  const auto computeRange = [&](const size_t begin, const size_t end, const UInt chunk) {
+    vector<vector<SynapseIdx>> overlaps;
+    vector<Real>    boosted;
+    vector<CellIdx> candidates;
+    for( size_t block = begin; block < end; block += blockSize ) {
+      const size_t size = std::min( blockSize, end - block );
+      computeOverlaps( overlaps, block, size );
+      for( size_t i = 0; i < size; i++ ) {
+        boostOverlaps_( overlaps[i], factors, boosted, stimulusThreshold_, &candidates );
+        auto activeVector = inhibitColumns_( boosted, &candidates );
+        sort( activeVector.begin(), activeVector.end() );
+        setActive( block + i, chunk, activeVector );
+      }
+    }
+  };
+  ThreadPool *threadPool = connections_.getThreadPool();
+  if( threadPool == nullptr ) {
+    computeRange( 0u, numInputs, 0u );
+  }
+  else {
+    threadPool->parallelFor( numInputs, computeRange );
+  }
+}
+
+
+namespace {
+/*
+ * Kernels for SpatialPooler::boostOverlaps_.  For every column i:
+ * boosted[i] = overlaps[i] * boostFactors[i], or just overlaps[i] if there
+ * are no boostFactors.  In the same pass the columns with a positive boosted
+ * overlap of at least the threshold are appended to the candidates, if given.
+ * The AVX2 kernel handles 8 columns at once, and is picked at run time when
+ * the CPU supports it.  Both kernels give exactly the same results.
+ */
+using BoostKernel = void (*)(const SynapseIdx *overlaps, const Real *boostFactors,
+                             Real *boosted, size_t size, Real threshold,
+                             vector<CellIdx> *candidates);
+
+void boostOverlapsScalar(const SynapseIdx *overlaps, const Real *boostFactors,
+                         Real *boosted, const size_t size, const Real threshold,
+                         vector<CellIdx> *candidates) {
+  for(size_t i = 0; i < size; i++) {
+    const Real overlap = static_cast<Real>(overlaps[i]);
+    boosted[i] = boostFactors ? overlap * boostFactors[i] : overlap;
+  }
+  // The multiplication vectorizes when it is a separate loop.
+  if( candidates == nullptr ) return;
+  for(size_t i = 0; i < size; i++) {
+    if( boosted[i] > 0.0f and boosted[i] >= threshold ) {
+      candidates->push_back( static_cast<CellIdx>(i) );
+    }
+  }
+}
+
+#if defined(NTA_BOOST_AVX2)
+__attribute__((target("avx2")))
+void boostOverlapsAVX2(const SynapseIdx *overlaps, const Real *boostFactors,
+                       Real *boosted, const size_t size, const Real threshold,
+                       vector<CellIdx> *candidates) {
+  static_assert(sizeof(SynapseIdx) == 2u and sizeof(Real) == 4u,
+                "boostOverlapsAVX2 needs 16 bit overlaps and 32 bit reals.");
+  const __m256 zero  = _mm256_setzero_ps();
+  const __m256 limit = _mm256_set1_ps( threshold );
+
+  size_t i = 0;
+  for( ; i + 8u <= size; i += 8u) {
+    const __m128i counts = _mm_loadu_si128( reinterpret_cast<const __m128i*>(overlaps + i) );
+    __m256 values = _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32(counts) );
+    if( boostFactors ) {
+      values = _mm256_mul_ps( values, _mm256_loadu_ps(boostFactors + i) );
+    }
+    _mm256_storeu_ps( boosted + i, values );
+    if( candidates == nullptr ) continue;
+    unsigned mask = static_cast<unsigned>( _mm256_movemask_ps( _mm256_and_ps(
+        _mm256_cmp_ps(values, zero,  _CMP_GT_OQ),
+        _mm256_cmp_ps(values, limit, _CMP_GE_OQ) )));
+    while( mask ) {
+      candidates->push_back( static_cast<CellIdx>(i + __builtin_ctz(mask)) );
+      mask &= mask - 1u;
+    }
+  }
+  for( ; i < size; i++) {
+    const Real overlap = static_cast<Real>(overlaps[i]);
+    boosted[i] = boostFactors ? overlap * boostFactors[i] : overlap;
+    if( candidates != nullptr and boosted[i] > 0.0f and boosted[i] >= threshold ) {
+      candidates->push_back( static_cast<CellIdx>(i) );
+    }
   }
 }
+#endif
+
+BoostKernel selectBoostKernel() {
+#if defined(NTA_BOOST_AVX2)
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports("avx2") ) {
+    return boostOverlapsAVX2;
+  }
+#endif
+  return boostOverlapsScalar;
+}
+} // end anonymous namespace
+
+
+void SpatialPooler::boostOverlaps_(const vector<SynapseIdx> &overlaps,
+                                   vector<Real> &boosted,
+                                   vector<CellIdx> *candidates) const {
+  NTA_ASSERT(overlaps.size() == numColumns_);
+  boosted.resize(numColumns_);
+  const Real threshold = static_cast<Real>(stimulusThreshold_);
+  if( candidates != nullptr ) {
+    candidates->clear();
+    candidates->reserve(numColumns_);
+  }
+  if( lazyBoostFactors_ and boostStrength_ >= static_cast<Real>(htm::Epsilon) ) {
+    // Only compute the factors which are needed.
+    for (UInt i = 0; i < numColumns_; i++) {
+      boosted[i] = overlaps[i] == 0 ? 0.0f : overlaps[i] * boostFactor_(i);
+      if( candidates != nullptr and boosted[i] > 0.0f and boosted[i] >= threshold ) {
+        candidates->push_back(i);
+      }
+    }
+    return;
+  }
+  // boost ~ 0.0, skip the multiplication and just copy the overlaps.
+  const Real *factors = boostStrength_ < static_cast<Real>(htm::Epsilon) ? nullptr : boostFactors_.data();
+  boostOverlaps_(overlaps, factors, boosted, stimulusThreshold_, candidates);
+}
+
+
+void SpatialPooler::boostOverlaps_(const vector<SynapseIdx> &overlaps,
+                                   const Real *boostFactors,
+                                   vector<Real> &boosted,
+                                   const UInt stimulusThreshold,
+                                   vector<CellIdx> *candidates) {
+  static const BoostKernel kernel = selectBoostKernel();
+  boosted.resize(overlaps.size());
+  if( candidates != nullptr ) {
+    candidates->clear();
+    candidates->reserve(overlaps.size());
+  }
+  kernel( overlaps.data(), boostFactors, boosted.data(), overlaps.size(),
+          static_cast<Real>(stimulusThreshold), candidates );
+}
 
 
 UInt SpatialPooler::initMapColumn_(UInt column) const {
@@ -534,28 +778,102 @@ UInt SpatialPooler::initMapColumn_(UInt column) const {
 
 
 vector<UInt> SpatialPooler::initMapPotential_(UInt column, bool wrapAround) {
+  const NeighborhoodStencil stencil(potentialRadius_, inputDimensions_, wrapAround);
+  vector<CellIdx> pool;
+  initPotentialPool_(column, stencil, rng_, pool);
+  vector<UInt> potential(numInputs_, 0u);
+  for (const auto input : pool) {
+    potential[input] = 1u;
+  }
+  return potential;
+}
+
+
+void SpatialPooler::initPotentialPool_(UInt column, const NeighborhoodStencil &stencil,
+                                       Random &rng, vector<CellIdx> &pool) const {
   NTA_ASSERT(column < numColumns_);
   const UInt centerInput = initMapColumn_(column);
 
-  vector<UInt> columnInputs;
-  for (const auto input : Neighborhood(centerInput, potentialRadius_, inputDimensions_, wrapAround, /*skip_center=*/false)) {
-      columnInputs.push_back(input);
+  pool.clear();
+  stencil.forEach(centerInput, [&pool](const UInt input) {
+      pool.push_back(input);
+  });
+
+  // Same as rng.sample(pool, numPotential), without copying the pool.
+  const UInt numPotential = static_cast<UInt>(round(pool.size() * potentialPct_));
+  if (numPotential > 0) {
+    rng.shuffle(pool.begin(), pool.end());
   }
+  pool.resize(numPotential);
+  std::sort(pool.begin(), pool.end());
+}
 
-  const UInt numPotential = static_cast<UInt>(round(columnInputs.size() * potentialPct_));
-  const auto selectedInputs = rng_.sample<UInt>(columnInputs, numPotential);
-  const vector<UInt> potential = VectorHelpers::sparseToBinary<UInt>(selectedInputs, numInputs_);
-  return potential;
+
+void SpatialPooler::initSynapses_() {
+  const NeighborhoodStencil stencil(potentialRadius_, inputDimensions_, wrapAround_);
+  const auto createColumn = [this](const UInt column,
+                                   const vector<CellIdx> &pool,
+                                   const vector<Permanence> &permanences) {
+    connections_.createSegment( static_cast<CellIdx>(column), 1 /* max segments per cell is fixed for SP to 1 */);
+    connections_.createSynapses( static_cast<Segment>(column), pool, permanences );
+    connections_.raisePermanencesToThreshold( static_cast<Segment>(column), stimulusThreshold_ );
+  };
+
+  if( not columnRandomStreams_ ) {
+    vector<CellIdx>    pool;
+    vector<Permanence> permanences;
+    for (UInt column = 0; column < numColumns_; column++) {
+      initPotentialPool_(column, stencil, rng_, pool);
+      initPermanence_(pool, initConnectedPct_, rng_, permanences);
+      createColumn(column, pool, permanences);
+    }
+    return;
+  }
+
+  // Sample a block of columns on all threads, then create their synapses in
+  // order.  The blocks bound the memory for the samples.
+  const UInt64 seedBase = 1u + rng_.getUInt32();
+  const UInt blockSize = 1024u;
+  vector<vector<CellIdx>>    pools( blockSize );
+  vector<vector<Permanence>> permanences( blockSize );
+  ThreadPool *threads = connections_.getThreadPool();
+  for (UInt first = 0; first < numColumns_; first += blockSize) {
+    const UInt size = std::min(blockSize, numColumns_ - first);
+    const auto sample = [&](const size_t begin, const size_t end, UInt) {
+      for (size_t i = begin; i < end; i++) {
+        const UInt column = first + static_cast<UInt>(i);
+        Random rng(seedBase + column);
+        initPotentialPool_(column, stencil, rng, pools[i]);
+        initPermanence_(pools[i], initConnectedPct_, rng, permanences[i]);
+      }
+    };
+    if( threads != nullptr ) {
+      threads->parallelFor(size, sample);
+    } else {
+      sample(0u, size, 0u);
+    }
+    for (UInt i = 0; i < size; i++) {
+      createColumn(first + i, pools[i], permanences[i]);
+    }
+  }
 }
 
 
 Permanence SpatialPooler::initPermConnected_() {
-  return static_cast<Permanence>(rng_.realRange(synPermConnected_, maxPermanence));
+  return initPermConnected_(rng_);
+}
+
+Permanence SpatialPooler::initPermConnected_(Random &rng) const {
+  return static_cast<Permanence>(rng.realRange(synPermConnected_, maxPermanence));
 }
 
 
 Permanence SpatialPooler::initPermNonConnected_() {
-  return static_cast<Permanence>(rng_.realRange(minPermanence, synPermConnected_));
+  return initPermNonConnected_(rng_);
+}
+
+Permanence SpatialPooler::initPermNonConnected_(Random &rng) const {
+  return static_cast<Permanence>(rng.realRange(minPermanence, synPermConnected_));
 }
 
 
@@ -578,6 +896,21 @@ vector<Permanence> SpatialPooler::initPermanence_(const vector<UInt> &potential,
 }
 
 
+void SpatialPooler::initPermanence_(const vector<CellIdx> &pool,
+                                    const Real connectedPct,
+                                    Random &rng,
+                                    vector<Permanence> &permanences) const {
+  permanences.resize(pool.size());
+  for (auto &permanence : permanences) {
+    if (rng.getReal64() <= connectedPct) {
+      permanence = initPermConnected_(rng);
+    } else {
+      permanence = initPermNonConnected_(rng);
+    }
+  }
+}
+
+
 void SpatialPooler::updateInhibitionRadius_() {
   if (globalInhibition_) {
     setInhibitionRadius( *max_element(columnDimensions_.cbegin(), columnDimensions_.cend()) );
@@ -606,12 +939,13 @@ void SpatialPooler::updateMinDutyCycles_() {
   } else {
     updateMinDutyCyclesLocal_();
   }
+  weakColumnsValid_ = false;
 }
 
 
 void SpatialPooler::updateMinDutyCyclesGlobal_() {
-  const Real maxOverlapDutyCycles =
-      *max_element(overlapDutyCycles_.begin(), overlapDutyCycles_.end());
+  const Real maxOverlapDutyCycles = static_cast<Real>(dutyCycleScale_ *
+      *max_element(overlapDutyCycles_.begin(), overlapDutyCycles_.end()));
 
   fill(minOverlapDutyCycles_.begin(), minOverlapDutyCycles_.end(),
        minPctOverlapDutyCycles_ * maxOverlapDutyCycles);
@@ -619,34 +953,100 @@ void SpatialPooler::updateMinDutyCyclesGlobal_() {
 
 
 void SpatialPooler::updateMinDutyCyclesLocal_() {
+  // The max over each column's neighborhood, including the column itself.
+  neighborhoodMax(overlapDutyCycles_, columnDimensions_, inhibitionRadius_,
+                  wrapAround_, minOverlapDutyCycles_);
   for (UInt i = 0; i < numColumns_; i++) {
-    Real maxOverlapDuty = overlapDutyCycles_[i]; //start with the center, which is column 'i'
-    const auto& hood = neighborMap_[i];
-    for(const auto column : hood) {
-      maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-    }
-    minOverlapDutyCycles_[i] = maxOverlapDuty * minPctOverlapDutyCycles_;
+    const Real maxOverlapDuty = minOverlapDutyCycles_[i];
+    minOverlapDutyCycles_[i] = static_cast<Real>(maxOverlapDuty * dutyCycleScale_) * minPctOverlapDutyCycles_;
   }
 }
 
 
 void SpatialPooler::updateDutyCycles_(const vector<SynapseIdx> &overlaps,
                                       SDR &active) {
-
-  // Turn the overlaps array into an SDR. Convert directly to flat-sparse to
-  // avoid copies and  type convertions.
-  SDR newOverlap({ numColumns_ });
-  auto &overlapsSparseVec = newOverlap.getSparse();
+  SDR_sparse_t overlapping;
   for (UInt i = 0; i < numColumns_; i++) {
     if( overlaps[i] != 0 )
-      overlapsSparseVec.push_back( i );
+      overlapping.push_back( i );
   }
-  newOverlap.setSparse( overlapsSparseVec );
+  updateDutyCycles_(overlapping, active.getSparse());
+}
 
+
+void SpatialPooler::updateDutyCycles_(const SDR_sparse_t &overlapping,
+                                      const SDR_sparse_t &active) {
   const UInt period = std::min(dutyCyclePeriod_, iterationNum_);
 
-  updateDutyCyclesHelper_(overlapDutyCycles_, newOverlap, period);
-  updateDutyCyclesHelper_(activeDutyCycles_, active, period);
+  if( not lazyDutyCycles_ ) {
+    updateDutyCyclesHelper_(overlapDutyCycles_, overlapping, period);
+    updateDutyCyclesHelper_(activeDutyCycles_,  active,      period);
+    return;
+  }
+
+  // Same as updateDutyCyclesHelper_, but the decay only changes the scale:
+  //   DC( time ) = stored( time ) * scale( time )
+  NTA_ASSERT(period > 0);
+  const Real decay = (period - 1) / static_cast<Real>(period);
+  if( decay == 0.0f ) {
+    std::fill(overlapDutyCycles_.begin(), overlapDutyCycles_.end(), 0.0f);
+    std::fill(activeDutyCycles_.begin(),  activeDutyCycles_.end(),  0.0f);
+    dutyCycleScale_   = 1.0;
+    weakColumnsValid_ = false;
+  }
+  else {
+    dutyCycleScale_ *= decay;
+    if( dutyCycleScale_ < 1.0e-6 ) { // before the stored values lose precision
+      normalizeDutyCycles_();
+    }
+  }
+  const Real increment = static_cast<Real>(1.0 / (period * dutyCycleScale_));
+  for(const auto idx : overlapping)
+    overlapDutyCycles_[idx] += increment;
+  for(const auto idx : active)
+    activeDutyCycles_[idx] += increment;
+
+  // Only the overlapping columns can stop being weak, see bumpUpWeakColumns_.
+  if( weakColumnsValid_ ) {
+    for(const auto idx : overlapping)
+      trackWeakColumn_(idx);
+  }
+}
+
+
+void SpatialPooler::normalizeDutyCycles_() {
+  if( lazyBoostFactors_ ) {
+    for(UInt i = 0; i < numColumns_; i++) {
+      boostFactors_[i] = boostFactor_(i);
+    }
+    lazyBoostFactors_ = false;
+  }
+  if( dutyCycleScale_ != 1.0 ) {
+    overlapDutyCycles_ = scaledDutyCycles_(overlapDutyCycles_);
+    activeDutyCycles_  = scaledDutyCycles_(activeDutyCycles_);
+    dutyCycleScale_    = 1.0;
+    weakColumnsValid_  = false;
+  }
+}
+
+
+vector<Real> SpatialPooler::scaledDutyCycles_(const vector<Real> &dutyCycles) const {
+  vector<Real> scaled(dutyCycles);
+  if( dutyCycleScale_ != 1.0 ) {
+    for(auto &dutyCycle : scaled) {
+      dutyCycle = static_cast<Real>(dutyCycle * dutyCycleScale_);
+    }
+  }
+  return scaled;
+}
+
+
+Real SpatialPooler::boostFactor_(const UInt column) const {
+  if( not lazyBoostFactors_ ) {
+    return boostFactors_[column];
+  }
+  const Real activeDutyCycle = static_cast<Real>(activeDutyCycles_[column] * dutyCycleScale_);
+  return exp((boostTargetDensity_ - activeDutyCycle) * boostStrength_);
 }
 
 
@@ -698,19 +1098,91 @@ Real SpatialPooler::avgConnectedSpanForColumnND_(const UInt column) const {
 
 void SpatialPooler::adaptSynapses_(const SDR &input,
                                    const SDR &active) {
-  for(const auto &column : active.getSparse()) {
-    connections_.adaptSegment(column, input, synPermActiveInc_, synPermInactiveDec_);
-    connections_.raisePermanencesToThreshold( column, stimulusThreshold_ );
-  }
+  // Each column has its own segment, so they can learn in parallel.
+  connections_.adaptSegments( active.getSparse(), input, synPermActiveInc_,
+                              synPermInactiveDec_, stimulusThreshold_ );
 }
 
 
 void SpatialPooler::bumpUpWeakColumns_() {
+  if( lazyDutyCycles_ ) {
+    // The stale entries pile up in the queue as the columns overlap.
+    if( not weakColumnsValid_ or weakQueue_.size() > 2u * numColumns_ ) {
+      rebuildWeakColumns_();
+    }
+    // Mark the queued columns whose scale is reached.  The threshold has some
+    // slack for rounding errors, the columns are then checked exactly.
+    const Real64 threshold = dutyCycleScale_ * (1.0 - 1.0e-9);
+    vector<std::pair<Real64, Segment>> notYet;
+    while( not weakQueue_.empty() and weakQueue_.front().first > threshold ) {
+      std::pop_heap( weakQueue_.begin(), weakQueue_.end() );
+      const auto entry = weakQueue_.back();
+      weakQueue_.pop_back();
+      const auto column = entry.second;
+      if( weakColumn_[column] or weakScale_[column] != entry.first ) {
+        continue; // stale
+      }
+      if( overlapDutyCycles_[column] * dutyCycleScale_ < minOverlapDutyCycles_[column] ) {
+        weakColumn_[column] = 1;
+        weakColumns_.push_back( column );
+      }
+      else {
+        notYet.push_back( entry );
+      }
+    }
+    for( const auto &entry : notYet ) {
+      weakQueue_.push_back( entry );
+      std::push_heap( weakQueue_.begin(), weakQueue_.end() );
+    }
+
+    // Same order as the scan below.
+    std::sort( weakColumns_.begin(), weakColumns_.end() );
+    weakColumns_.erase( std::unique( weakColumns_.begin(), weakColumns_.end() ), weakColumns_.end() );
+    weakColumns_.erase( std::remove_if( weakColumns_.begin(), weakColumns_.end(),
+                          [&](const Segment column) { return not weakColumn_[column]; }),
+                        weakColumns_.end() );
+    connections_.bumpSegments( weakColumns_, synPermBelowStimulusInc_ );
+    return;
+  }
+
+  vector<Segment> weakColumns;
   for (size_t i = 0; i < numColumns_; i++) {
-    if (overlapDutyCycles_[i] >= minOverlapDutyCycles_[i]) {
+    if (overlapDutyCycles_[i] * dutyCycleScale_ >= minOverlapDutyCycles_[i]) {
       continue;
     }
-    connections_.bumpSegment( static_cast<Segment>(i), synPermBelowStimulusInc_ );
+    weakColumns.push_back( static_cast<Segment>(i) );
+  }
+  connections_.bumpSegments( weakColumns, synPermBelowStimulusInc_ );
+}
+
+
+void SpatialPooler::trackWeakColumn_(const UInt column) {
+  if( overlapDutyCycles_[column] * dutyCycleScale_ < minOverlapDutyCycles_[column] ) {
+    if( not weakColumn_[column] ) {
+      weakColumn_[column] = 1;
+      weakColumns_.push_back( static_cast<Segment>(column) );
+    }
+    return;
+  }
+  weakColumn_[column] = 0;
+  // Weak once stored * scale < min.  A column whose minimum is zero never is.
+  if( minOverlapDutyCycles_[column] > 0.0f ) {
+    const Real64 scale = static_cast<Real64>(minOverlapDutyCycles_[column]) / overlapDutyCycles_[column];
+    weakScale_[column] = scale;
+    weakQueue_.emplace_back( scale, static_cast<Segment>(column) );
+    std::push_heap( weakQueue_.begin(), weakQueue_.end() );
+  }
+}
+
+
+void SpatialPooler::rebuildWeakColumns_() {
+  weakColumn_.assign( numColumns_, 0 );
+  weakScale_.assign( numColumns_, 0.0 );
+  weakColumns_.clear();
+  weakQueue_.clear();
+  weakColumnsValid_ = true;
+  for( UInt column = 0; column < numColumns_; column++ ) {
+    trackWeakColumn_( column );
   }
 }
 
@@ -718,8 +1190,15 @@ void SpatialPooler::bumpUpWeakColumns_() {
 void SpatialPooler::updateDutyCyclesHelper_(vector<Real> &dutyCycles,
                                             const SDR &newValues,
                                             const UInt period) {
-  NTA_ASSERT(period > 0);
   NTA_ASSERT(dutyCycles.size() == newValues.size) << "duty dims: " << dutyCycles.size() << " SDR dims: " << newValues.size;
+  updateDutyCyclesHelper_(dutyCycles, newValues.getSparse(), period);
+}
+
+
+void SpatialPooler::updateDutyCyclesHelper_(vector<Real> &dutyCycles,
+                                            const SDR_sparse_t &newValues,
+                                            const UInt period) {
+  NTA_ASSERT(period > 0);
 
   // Duty cycles are exponential moving averages, typically written like:
   //   alpha = 1 / period
@@ -732,7 +1211,7 @@ void SpatialPooler::updateDutyCyclesHelper_(vector<Real> &dutyCycles,
     dutyCycles[i] *= decay;
 
   const Real increment = 1.0f / period;  // All non-zero values are 1.
-  for(const auto idx : newValues.getSparse())
+  for(const auto idx : newValues)
     dutyCycles[idx] += increment;
 }
 
@@ -769,7 +1248,13 @@ void SpatialPooler::updateBoostFactorsGlobal_() {
   } else {
     targetDensity = localAreaDensity_;
   }
-  
+
+  if(boostStrength_ < htm::Epsilon) return; //skip for disabled boosting
+  if( lazyDutyCycles_ ) { // see boostFactor_
+    boostTargetDensity_ = targetDensity;
+    lazyBoostFactors_   = true;
+    return;
+  }
   for (size_t i = 0; i < numColumns_; ++i) { 
     applyBoosting_(i, targetDensity, activeDutyCycles_, boostStrength_, boostFactors_);
   }
@@ -777,23 +1262,16 @@ void SpatialPooler::updateBoostFactorsGlobal_() {
 
 
 void SpatialPooler::updateBoostFactorsLocal_() {
+  normalizeDutyCycles_(); // this computes all of the boost factors anyway
+  if(boostStrength_ < htm::Epsilon) return; //skip for disabled boosting
+
+  // The target density of a column is the mean active duty cycle within its
+  // neighborhood, including the column itself.
+  vector<Real> localActivityDensity;
+  neighborhoodMean(activeDutyCycles_, columnDimensions_, inhibitionRadius_,
+                   wrapAround_, localActivityDensity);
   for (UInt i = 0; i < numColumns_; ++i) {
-    Real localActivityDensity = 0.0f;
-    
-    const auto& hood = neighborMap_[i]; //hood is vector<> of cached neighborhood values
-    //optimization: In wrapAround, number of neighbors to be considered is solely a function of the inhibition radius,
-    // the number of dimensions, and of the size of each of those dimenions. 
-    // Or in non-wrap, if we use cached hood, we obtain the value the same as hood.size()
-    const UInt numNeighbors = static_cast<UInt>(hood.size()) + 1; 
-    //start by adding the center ('i') which is not included in the hood
-    localActivityDensity += activeDutyCycles_[i]; //include the center, which is 'i' (not included in hood)
-
-    //for(auto neighbor: Neighborhood(i, inhibitionRadius_, columnDimensions_, wrapAround_)) {
-    for (const auto neighbor : hood) {
-      localActivityDensity += activeDutyCycles_[neighbor];
-      //numNeighbors++;
-    }
-    const Permanence targetDensity = static_cast<Permanence>(localActivityDensity / numNeighbors);
+    const Permanence targetDensity = static_cast<Permanence>(localActivityDensity[i]);
     applyBoosting_(i, targetDensity, activeDutyCycles_, boostStrength_, boostFactors_);
   }
 }
@@ -828,7 +1306,7 @@ UInt getAreaND_(const vector<UInt>& dimensions, const Real radius) {
   return static_cast<UInt>(area);
 }
 
-vector<CellIdx> SpatialPooler::inhibitColumns_(const vector<Real> &overlaps) const {
+Real SpatialPooler::inhibitionDensity_() const {
   Real density = localAreaDensity_; //option 1: used localAreaDensity
   if (numActiveColumnsPerInhArea_ > 0) { //option 2: used numActiveColumnsPerInhArea in constructor
     const UInt inhibitionArea = getAreaND_(columnDimensions_, static_cast<Real>(inhibitionRadius_)); 
@@ -837,100 +1315,239 @@ vector<CellIdx> SpatialPooler::inhibitColumns_(const vector<Real> &overlaps) con
     density = min(density, (Real)MAX_LOCALAREADENSITY);
   }
   NTA_ASSERT(density > 0.0f and density < 1.0f);
+  return density;
+}
 
-  if (globalInhibition_ ||
-      inhibitionRadius_ > *max_element(columnDimensions_.begin(), columnDimensions_.end())) {
-    return inhibitColumnsGlobal_(overlaps, density);
+
+bool SpatialPooler::isInhibitionGlobal_() const {
+  return globalInhibition_ ||
+      inhibitionRadius_ > *max_element(columnDimensions_.begin(), columnDimensions_.end());
+}
+
+
+vector<CellIdx> SpatialPooler::inhibitColumns_(const vector<Real> &overlaps,
+                                               const vector<CellIdx> *candidates) const {
+  const Real density = inhibitionDensity_();
+  if (isInhibitionGlobal_()) {
+    return inhibitColumnsGlobal_(overlaps, density, candidates);
   } else {
-    return inhibitColumnsLocal_(overlaps, density);
+    return inhibitColumnsLocal_(overlaps, density, candidates);
   }
 }
 
 
 vector<CellIdx> SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
-                                          const Real density) const {
-  const UInt numDesired = static_cast<UInt>((density * numColumns_));
-  NTA_CHECK(numDesired > 0) << "Not enough columns (" << numColumns_ << ") "
+                                          const Real density,
+                                          const vector<CellIdx> *candidates) const {
+  NTA_ASSERT(overlaps.size() == numColumns_);
+  return inhibitColumnsGlobal_(overlaps, density, stimulusThreshold_, candidates);
+}
+
+
+vector<CellIdx> SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
+                                          const Real density,
+                                          const UInt stimulusThreshold,
+                                          const vector<CellIdx> *candidates) {
+  const UInt numColumns = static_cast<UInt>(overlaps.size());
+  const UInt numDesired = static_cast<UInt>((density * numColumns));
+  NTA_CHECK(numDesired > 0) << "Not enough columns (" << numColumns << ") "
                             << "for desired density (" << density << ").";
-  // Sort the columns by the amount of overlap.  First make a list of all of the
-  // column indexes.
-  vector<CellIdx> activeColumns(numColumns_);
-  std::iota(activeColumns.begin(), activeColumns.end(), 0); //fill with sequence 0,1,..N
 
   // Compare the column indexes by their overlap.
   auto compare = [&overlaps](const UInt &a, const UInt &b) -> bool
     {return (overlaps[a] == overlaps[b]) ? (a > b) : (overlaps[a] > overlaps[b]) ;};  //for determinism if overlaps match (tieBreaker does not solve that),
   //otherwise we'd return just `return overlaps[a] > overlaps[b]`. 
 
-  // Do a partial sort to divide the winners from the losers.  This sort is
-  // faster than a regular sort because it stops after it partitions the
-  // elements about the Nth element, with all elements on their correct side of
-  // the Nth element.
-  std::nth_element(
-    activeColumns.begin(),
-    activeColumns.begin() + numDesired,
-    activeColumns.end(),
-    compare);
-  // Remove the columns which lost the competition.
-  activeColumns.resize(numDesired);
+  // Make a list of the columns with a positive overlap, these rank above all
+  // others.  Note if their overlaps are all (small) integers.
+  vector<CellIdx> activeColumns;
+  bool integral = true;
+  Real maxOverlap = 0.0f;
+  const auto consider = [&](const CellIdx column) {
+    const Real overlap = overlaps[column];
+    if( not (overlap > 0.0f) ) return;
+    activeColumns.push_back( column );
+    integral   = integral and overlap == std::floor(overlap);
+    maxOverlap = std::max(maxOverlap, overlap);
+  };
+  if( candidates != nullptr ) {
+    activeColumns.reserve( candidates->size() );
+    for( const auto column : *candidates ) consider( column );
+  }
+  else {
+    for( CellIdx column = 0; column < numColumns; column++ ) consider( column );
+  }
+
+  if( activeColumns.size() > numDesired ) {
+    if( integral and maxOverlap <= std::numeric_limits<SynapseIdx>::max() ) {
+      // Count the columns per overlap, and find the least overlap which still
+      // wins.  Of the columns with exactly that overlap, only as many as
+      // needed win: the ones with the largest indexes.
+      vector<UInt> counts( static_cast<size_t>(maxOverlap) + 1u, 0u );
+      for( const auto column : activeColumns ) {
+        counts[ static_cast<size_t>(overlaps[column]) ]++;
+      }
+      size_t threshold = counts.size() - 1u;
+      UInt numAbove = 0u;
+      while( numAbove + counts[threshold] < numDesired ) {
+        numAbove += counts[threshold];
+        threshold--;
+      }
+      const Real thresholdOverlap = static_cast<Real>(threshold);
+      vector<CellIdx> ties;
+      size_t numWinners = 0u;
+      for( const auto column : activeColumns ) {
+        if( overlaps[column] > thresholdOverlap ) {
+          activeColumns[numWinners++] = column;
+        }
+        else if( overlaps[column] == thresholdOverlap ) {
+          ties.push_back( column );
+        }
+      }
+      activeColumns.resize( numWinners );
+      const UInt numTies = numDesired - numAbove;
+      std::nth_element( ties.begin(), ties.begin() + numTies - 1u, ties.end(), std::greater<CellIdx>() );
+      activeColumns.insert( activeColumns.end(), ties.begin(), ties.begin() + numTies );
+    }
+    else {
+      // Do a partial sort to divide the winners from the losers.  This sort is
+      // faster than a regular sort because it stops after it partitions the
+      // elements about the Nth element, with all elements on their correct side of
+      // the Nth element.
+      std::nth_element(
+        activeColumns.begin(),
+        activeColumns.begin() + numDesired,
+        activeColumns.end(),
+        compare);
+      // Remove the columns which lost the competition.
+      activeColumns.resize(numDesired);
+    }
+  }
   // Finish sorting the winner columns by their overlap.
   std::sort(activeColumns.begin(), activeColumns.end(), compare);
+
+  // Columns without overlap only win when there are not enough others.  They
+  // pass the stimulus threshold only if it is zero.
+  if( activeColumns.size() < numDesired and stimulusThreshold == 0u ) {
+    for( CellIdx column = numColumns; column-- > 0u and activeColumns.size() < numDesired; ) {
+      if( overlaps[column] == 0.0f ) {
+        activeColumns.push_back( column );
+      }
+    }
+  }
+
   // Remove sub-threshold winners
   while( !activeColumns.empty() &&
-         overlaps[activeColumns.back()] < stimulusThreshold_) {
+         overlaps[activeColumns.back()] < stimulusThreshold) {
       activeColumns.pop_back();
   }
-  
-  activeColumns.shrink_to_fit();
   return activeColumns;
 }
 
 
 vector<CellIdx> SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
-                                                    const Real density) const {
+                                                    const Real density,
+                                                    const vector<CellIdx> *candidates) const {
   NTA_ASSERT(overlaps.size() == numColumns_);
-  vector<CellIdx> activeColumns;
-  //optimization: reserve for numDesired approximation
-  const UInt approxNumDesired = static_cast<UInt>(density * numColumns_); //note: this is just a heuristic, not precise number. It can be used for global inh, 
-  //..but here the density is requested for inhibition radius. The guess is it correlates to the global somehow. 
-  activeColumns.reserve(approxNumDesired); 
+  return inhibitColumnsLocal_(overlaps, density, stimulusThreshold_, columnDimensions_,
+                              inhibitionRadius_, wrapAround_, candidates);
+}
 
-  // Tie-breaking: when overlaps are equal, columns that have already been
-  // selected are treated as "bigger".
-  vector<bool> alreadyUsedColumn(numColumns_, false); // in tie we prefer already used columns
 
-  for (UInt column = 0; column < numColumns_; column++) {
-    if (overlaps[column] < stimulusThreshold_) { //TODO make connections.computeActivity() already drop sub-threshold columns
-      continue;
+vector<CellIdx> SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
+                                                    const Real density,
+                                                    const UInt stimulusThreshold,
+                                                    const vector<UInt> &columnDimensions,
+                                                    const UInt inhibitionRadius,
+                                                    const bool wrapAround,
+                                                    const vector<CellIdx> *candidates) {
+  const UInt numColumns = static_cast<UInt>(overlaps.size());
+  // A column wins if fewer than numDesiredLocalActive of its neighbors are
+  // bigger than it.  When overlaps are equal, neighbors which have already
+  // been selected (in order of column index) count as "bigger".
+  //
+  // Visit the columns from the biggest overlap down, and within each overlap
+  // in order of column index.  Then the bigger neighbors of a column are
+  // exactly the neighbors which have been visited before it, excluding the
+  // losers with the same overlap, and they are counted without iterating over
+  // the neighborhood.
+  //
+  // The columns without overlap all come last, and they compete only if the
+  // stimulus threshold is zero.
+  vector<CellIdx> ranked;
+  bool integral = true;
+  Real maxOverlap = 0.0f;
+  const auto consider = [&](const CellIdx column) {
+    const Real overlap = overlaps[column];
+    if (overlap > 0.0f and overlap >= stimulusThreshold) {
+      ranked.push_back(column);
+      integral   = integral and overlap == std::floor(overlap);
+      maxOverlap = std::max(maxOverlap, overlap);
     }
-
-    UInt otherBigger = 0; //how many neighbor columns are bigger/better than this column 'column'. 
-    //..aka. how many times this column lost. 
-
-    const auto& hood = neighborMap_.at(column);
-    // Optimization: In wrapAround, number of neighbors to be considered is solely a function of the inhibition radius, 
-    // the number of dimensions, and of the size of each of those dimenion
-    const UInt numNeighbors = static_cast<UInt>(hood.size());
-    //const UInt numDesiredLocalActive = static_cast<UInt>(ceil(density * (numNeighbors + 1)));
-    const UInt numDesiredLocalActive = static_cast<UInt>(0.5f + (density * (numNeighbors + 1)));
-    NTA_ASSERT(numDesiredLocalActive > 0);
-    
-    //for(auto neighbor: Neighborhood(column, inhibitionRadius_,columnDimensions_, wrapAround_, false /*skip center*/)) { 
-    for (const auto neighbor: hood) {
-      NTA_ASSERT(neighbor != column);
-
-      if (overlaps[neighbor] > overlaps[column] || ( (overlaps[neighbor] == overlaps[column]) && alreadyUsedColumn[neighbor])) { //this column lost to a neighbor
-        otherBigger++;
-	if (otherBigger >= numDesiredLocalActive) { break; }
+  };
+  if( candidates != nullptr ) {
+    NTA_ASSERT( std::is_sorted(candidates->cbegin(), candidates->cend()) );
+    ranked.reserve(stimulusThreshold == 0u ? numColumns : candidates->size());
+    for( const auto column : *candidates ) consider( column );
+  }
+  else {
+    ranked.reserve(numColumns);
+    for (CellIdx column = 0; column < numColumns; column++) consider( column );
+  }
+  if( integral and maxOverlap <= std::numeric_limits<SynapseIdx>::max() ) {
+    // Sort the columns by counting them per overlap, this keeps the columns
+    // with equal overlaps in order of column index.
+    const size_t maxValue = static_cast<size_t>(maxOverlap);
+    vector<UInt> offsets( maxValue + 2u, 0u );
+    for( const auto column : ranked ) {
+      offsets[ maxValue - static_cast<size_t>(overlaps[column]) + 1u ]++;
+    }
+    std::partial_sum( offsets.begin(), offsets.end(), offsets.begin() );
+    vector<CellIdx> sorted( ranked.size() );
+    for( const auto column : ranked ) {
+      sorted[ offsets[ maxValue - static_cast<size_t>(overlaps[column]) ]++ ] = column;
+    }
+    ranked.swap( sorted );
+  }
+  else {
+    std::sort(ranked.begin(), ranked.end(),
+      [&overlaps](const CellIdx a, const CellIdx b) {
+        return overlaps[a] == overlaps[b] ? a < b : overlaps[a] > overlaps[b];
+    });
+  }
+  if( stimulusThreshold == 0u ) {
+    for (CellIdx column = 0; column < numColumns; column++) {
+      if( overlaps[column] == 0.0f ) {
+        ranked.push_back(column);
       }
-    } 
+    }
+  }
 
-    if (otherBigger < numDesiredLocalActive) { //successful column, add it
-      activeColumns.push_back(column);
-      alreadyUsedColumn[column] = true;
+  vector<CellIdx> activeColumns;
+  activeColumns.reserve(static_cast<size_t>(density * numColumns)); //note: this is just a heuristic
+  NeighborhoodCounter bigger(columnDimensions, inhibitionRadius, wrapAround);
+  vector<CellIdx> losers;
+  for (auto tie = ranked.cbegin(); tie != ranked.cend(); ) {
+    const Real overlap = overlaps[*tie];
+    losers.clear();
+    for ( ; tie != ranked.cend() && overlaps[*tie] == overlap; ++tie) {
+      const CellIdx column = *tie;
+      const UInt numNeighbors = bigger.size(column) - 1u; // excluding the column itself
+      const UInt numDesiredLocalActive = static_cast<UInt>(0.5f + (density * (numNeighbors + 1)));
+      NTA_ASSERT(numDesiredLocalActive > 0);
+
+      if (bigger.count(column, numDesiredLocalActive) < numDesiredLocalActive) { //successful column, add it
+        activeColumns.push_back(column);
+        bigger.add(column);
+      } else {
+        losers.push_back(column);
+      }
+    }
+    for (const auto column : losers) {
+      bigger.add(column);
     }
   }
-  //activeColumns.shrink_to_fit();
+  std::sort(activeColumns.begin(), activeColumns.end());
   return activeColumns;
 }
 
@@ -1030,9 +1647,12 @@ bool SpatialPooler::operator==(const SpatialPooler& o) const{
   // compare vectors.
   if (inputDimensions_      != o.inputDimensions_) return false;
   if (columnDimensions_     != o.columnDimensions_) return false;
-  if (boostFactors_         != o.boostFactors_) return false;
-  if (overlapDutyCycles_    != o.overlapDutyCycles_) return false;
-  if (activeDutyCycles_     != o.activeDutyCycles_) return false;
+  vector<Real> boostFactors(numColumns_), otherBoostFactors(numColumns_);
+  getBoostFactors(boostFactors.data());
+  o.getBoostFactors(otherBoostFactors.data());
+  if (boostFactors != otherBoostFactors) return false;
+  if (scaledDutyCycles_(overlapDutyCycles_) != o.scaledDutyCycles_(o.overlapDutyCycles_)) return false;
+  if (scaledDutyCycles_(activeDutyCycles_)  != o.scaledDutyCycles_(o.activeDutyCycles_)) return false;
   if (minOverlapDutyCycles_ != o.minOverlapDutyCycles_) return false;
 
   // compare connections
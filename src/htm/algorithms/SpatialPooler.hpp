@@ -22,14 +22,15 @@
 #ifndef NTA_spatial_pooler_HPP
 #define NTA_spatial_pooler_HPP
 
+#include <functional>
 #include <iostream>
 #include <vector>
-#include <unordered_map>
 #include <iomanip> // std::setprecision
 #include <htm/algorithms/Connections.hpp>
 #include <htm/types/Types.hpp>
 #include <htm/types/Serializable.hpp>
 #include <htm/types/Sdr.hpp>
+#include <htm/types/SdrBatch.hpp>
 #include <htm/utils/Topology.hpp>
 
 
@@ -254,10 +255,40 @@ public:
         an int vector containing the overlap score for each column. The
         overlap score for a column is defined as the number of synapses in
         a "connected state" (connected synapses) that are connected to
-        input bits which are turned on. 
+        input bits which are turned on.  The vector is owned by the SP and is
+        overwritten by the next call to compute.
         Replaces: SP.calculateOverlaps_(), SP.getOverlaps()
    */
-  virtual const vector<SynapseIdx> compute(const SDR &input, const bool learn, SDR &active);
+  virtual const vector<SynapseIdx> &compute(const SDR &input, const bool learn, SDR &active);
+
+  /**
+  Computes the active columns for many inputs, see compute above.
+
+  With learning each input is computed in turn.  Without learning the
+  inputs are independent: their overlaps are computed a block of inputs at a
+  time (see Connections::computeActivityBatch), and the blocks are split
+  between the threads, see setNumThreads.  The results are the same as from
+  calling compute for each input.
+
+  Unlike the single compute, this does not update the overlaps returned by
+  compute nor getBoostedOverlaps.
+
+  @param inputs   SDRs of the input dimensions.
+  @param learn    Whether or not learning is enabled.
+  @param actives  Output, one SDR of the column dimensions per input.
+   */
+  void compute(const vector<SDR> &inputs, const bool learn, vector<SDR> &actives);
+
+  /**
+  Same as above, for a batch of inputs.  The active columns of the inputs
+  are written into one batch without an SDR object per input.
+
+  @param inputs   Batch of SDRs of the input size.
+  @param learn    Whether or not learning is enabled.
+  @param actives  Output, reinitialized to the column dimensions, with the
+                  active columns of each input in order.
+   */
+  void compute(const SDRBatch &inputs, const bool learn, SDRBatch &actives);
 
 
   /**
@@ -303,9 +334,20 @@ public:
        CEREAL_NVP(wrapAround_),
        CEREAL_NVP(version_)
     );
-    ar(CEREAL_NVP(boostFactors_));
-    ar(CEREAL_NVP(overlapDutyCycles_));
-    ar(CEREAL_NVP(activeDutyCycles_));
+    if( dutyCycleScale_ == 1.0 and not lazyBoostFactors_ ) {
+      ar(CEREAL_NVP(boostFactors_));
+      ar(CEREAL_NVP(overlapDutyCycles_));
+      ar(CEREAL_NVP(activeDutyCycles_));
+    }
+    else { // Save the true values, see setLazyDutyCycles.
+      vector<Real> boostFactors(numColumns_);
+      getBoostFactors(boostFactors.data());
+      ar(cereal::make_nvp("boostFactors_", boostFactors));
+      const auto overlapDutyCycles = scaledDutyCycles_(overlapDutyCycles_);
+      const auto activeDutyCycles  = scaledDutyCycles_(activeDutyCycles_);
+      ar(cereal::make_nvp("overlapDutyCycles_", overlapDutyCycles));
+      ar(cereal::make_nvp("activeDutyCycles_",  activeDutyCycles));
+    }
     ar(CEREAL_NVP(minOverlapDutyCycles_));
     ar(CEREAL_NVP(connections_));
     ar(CEREAL_NVP(rng_));
@@ -351,9 +393,11 @@ public:
     ar(CEREAL_NVP(rng_));
     ar(CEREAL_NVP(minActiveDutyCycles_));
     ar(CEREAL_NVP(boostedOverlaps_));
-
-    //re-initialize map
-    neighborMap_ = Neighborhood::updateAllNeighbors(inhibitionRadius_, columnDimensions_, wrapAround_, /*skip_center=*/true);
+    dutyCycleScale_   = 1.0;
+    lazyBoostFactors_ = false;
+    weakColumnsValid_ = false;
+    overlaps_.clear();
+    overlapsTouched_.clear();
   }
 
   /**
@@ -554,6 +598,66 @@ public:
   */
   void setSpVerbosity(UInt spVerbosity);
 
+  /**
+  Returns the number of threads used to compute the overlaps, and to learn.
+
+  @returns integer number of threads.
+  */
+  UInt getNumThreads() const;
+
+  /**
+  Sets the number of threads, see Connections::setNumThreads.  Learning is
+  split between the threads by column, see Connections::adaptSegments.  This
+  is a run-time setting, it is not serialized and does not change the results.
+
+  @param numThreads integer number of threads, default 1.  If 0 then this
+  uses all of the hardware threads.
+  */
+  void setNumThreads(UInt numThreads);
+
+  /**
+  Returns true if the duty cycles are kept in lazily decayed form.
+  */
+  bool getLazyDutyCycles() const { return lazyDutyCycles_; }
+
+  /**
+  Keeps the duty cycles in a lazily decayed form, so that learning costs time
+  in proportion to the number of overlapping columns instead of the number of
+  columns.  The duty cycles are stored divided by a common scale factor, which
+  decays every step and is folded back into them once it gets small.  With
+  global inhibition the boost factors are then only computed for the columns
+  which overlap the input.
+
+  The duty cycles are the same up to rounding errors, which may change the
+  outcome of close decisions, like which columns are weak.  This is a run-time
+  setting, it is not serialized.
+
+  @param lazy boolean, default false.
+  */
+  void setLazyDutyCycles(bool lazy);
+
+  /**
+  Returns true if initialize draws every column's synapses from a random
+  stream of its own.
+  */
+  bool getColumnRandomStreams() const { return columnRandomStreams_; }
+
+  /**
+  Draws the potential pool and the initial permanences of every column from
+  a random stream of its own, seeded from the SP's seed and the column index,
+  instead of drawing all columns from the SP's random number generator in
+  turn.  Then initialize samples the columns on all threads of
+  setNumThreads, and its results do not depend on the number of threads.  The
+  initial synapses differ from those of the default initialization.
+
+  Call this before initialize, on a default constructed SpatialPooler.  This
+  is not serialized.
+
+  @param columnRandomStreams boolean, default false.
+  */
+  void setColumnRandomStreams(bool columnRandomStreams)
+    { columnRandomStreams_ = columnRandomStreams; }
+
   /**
   Returns boolean value of wrapAround which indicates if receptive
   fields should wrap around from the beginning the input dimensions
@@ -791,7 +895,26 @@ public:
   // NOT part of the public API
 
 
-  void boostOverlaps_(const vector<SynapseIdx> &overlaps, vector<Real> &boostedOverlaps) const;
+  /**
+    Multiplies the overlaps by the boost factors.
+
+    @param candidates optional, output.  In the same pass over the columns,
+    collects the columns whose boosted overlap is positive and at least the
+    stimulus threshold, in ascending order.  Only these columns (and with a
+    zero stimulus threshold, the columns without overlap) can win the
+    inhibition, see inhibitColumns_.
+  */
+  void boostOverlaps_(const vector<SynapseIdx> &overlaps, vector<Real> &boostedOverlaps,
+                      vector<CellIdx> *candidates = nullptr) const;
+
+  /**
+    As above, with the boost factors given explicitly, or nullptr to copy the
+    overlaps without boosting.  For use without an SP instance, see
+    FrozenSpatialPooler.
+  */
+  static void boostOverlaps_(const vector<SynapseIdx> &overlaps, const Real *boostFactors,
+                             vector<Real> &boostedOverlaps, const UInt stimulusThreshold,
+                             vector<CellIdx> *candidates);
 
   /**
     Maps a column to its respective input index, keeping to the topology of
@@ -848,6 +971,16 @@ public:
   */
   vector<UInt> initMapPotential_(UInt column, bool wrapAround);
 
+  /**
+  Sparse form of initMapPotential_: draws the potential pool of a column
+  from the given random number generator.
+
+  @param stencil  Neighborhoods of potentialRadius in the input space.
+  @param pool     Output, the inputs in the potential pool, sorted.
+  */
+  void initPotentialPool_(UInt column, const NeighborhoodStencil &stencil,
+                          Random &rng, vector<CellIdx> &pool) const;
+
   /**
   Returns a randomly generated permanence value for a synapses that is
   initialized in a connected state.
@@ -863,6 +996,7 @@ public:
   that is initialized in a connected state.
   */
   Permanence initPermConnected_();
+  Permanence initPermConnected_(Random &rng) const;
   /**
       Returns a randomly generated permanence value for a synapses that is to be
       initialized in a non-connected state.
@@ -871,6 +1005,7 @@ public:
      synapses that is to be initialized in a non-connected state.
   */
   Permanence initPermNonConnected_();
+  Permanence initPermNonConnected_(Random &rng) const;
 
   /**
     Initializes the permanences of a column. The method
@@ -888,6 +1023,18 @@ public:
   */
   vector<Permanence> initPermanence_(const vector<UInt> &potential, const Real connectedPct);
 
+  /**
+  Sparse form of initPermanence_: one initial permanence per input of the
+  potential pool, drawn from the given random number generator.
+  */
+  void initPermanence_(const vector<CellIdx> &pool, const Real connectedPct,
+                       Random &rng, vector<Permanence> &permanences) const;
+
+  /**
+  Creates the synapses of all columns, see setColumnRandomStreams.
+  */
+  void initSynapses_();
+
   void clip_(vector<Permanence> &perm) const;
 
   /**
@@ -901,11 +1048,16 @@ public:
      in a "connected state" (connected synapses) that are connected to input
      bits which are turned on.
 
+      @param candidates     optional, the columns which may have a non zero
+     overlap, in ascending order.  When given, inhibition only looks at these
+     and at the columns without any overlap.
+
       @return activeColumns
       a sparse SDR vector containing the indices of the active columns.
       Internally delegates to local/global inhibition functions.
   */
-  std::vector<CellIdx> inhibitColumns_(const vector<Real> &overlaps) const;
+  std::vector<CellIdx> inhibitColumns_(const vector<Real> &overlaps,
+                                       const vector<CellIdx> *candidates = nullptr) const;
 
   /**
      Perform global inhibition.
@@ -925,10 +1077,29 @@ public:
      @param density
      a real number of the fraction of columns to survive inhibition.
 
+     @param candidates
+     optional, the columns which may have a non zero overlap, in any order.
+     Otherwise all of the columns are scanned for them.
+
+     Only the columns with a positive overlap compete, the others can at most
+     fill up the remaining places.  When all of their overlaps are integers
+     (no boosting) the winners are found by counting the overlaps, otherwise
+     by a partial sort.  Ties are won by the column with the larger index.
+
      @return activeColumns
      an (sprase SDR) vector containing the indices of the active columns.
   */
-  std::vector<CellIdx> inhibitColumnsGlobal_(const vector<Real> &overlaps, const Real density) const;
+  std::vector<CellIdx> inhibitColumnsGlobal_(const vector<Real> &overlaps, const Real density,
+                                             const vector<CellIdx> *candidates = nullptr) const;
+
+  /**
+     As above, with the parameters of the SP given explicitly.  The number of
+     columns is the size of the overlaps.  For use without an SP instance,
+     see FrozenSpatialPooler.
+  */
+  static std::vector<CellIdx> inhibitColumnsGlobal_(const vector<Real> &overlaps, const Real density,
+                                                    const UInt stimulusThreshold,
+                                                    const vector<CellIdx> *candidates);
 
   /**
      Performs local inhibition.
@@ -953,10 +1124,39 @@ public:
      local fashion, the exact fraction of surviving columns is likely to
      vary.
 
+     @param candidates
+     optional, the columns which may have a non zero overlap, in ascending
+     order.  Otherwise all of the columns are scanned for them.
+
      @return activeColumns
      an (sparse SDR) vector containing the indices of the active columns.
   */
-  std::vector<CellIdx> inhibitColumnsLocal_(const vector<Real> &overlaps, const Real density) const;
+  std::vector<CellIdx> inhibitColumnsLocal_(const vector<Real> &overlaps, const Real density,
+                                            const vector<CellIdx> *candidates = nullptr) const;
+
+  /**
+     As above, with the parameters of the SP given explicitly.  The number of
+     columns is the size of the overlaps.  For use without an SP instance,
+     see FrozenSpatialPooler.
+  */
+  static std::vector<CellIdx> inhibitColumnsLocal_(const vector<Real> &overlaps, const Real density,
+                                                   const UInt stimulusThreshold,
+                                                   const vector<UInt> &columnDimensions,
+                                                   const UInt inhibitionRadius,
+                                                   const bool wrapAround,
+                                                   const vector<CellIdx> *candidates);
+
+  /**
+     The fraction of columns which should win the inhibition, from either
+     the localAreaDensity or the numActiveColumnsPerInhArea.
+  */
+  Real inhibitionDensity_() const;
+
+  /**
+     Whether inhibitColumns_ uses global inhibition, either because it is
+     configured or because the inhibition radius covers all of the columns.
+  */
+  bool isInhibitionGlobal_() const;
 
   /**
       The primary method in charge of learning.
@@ -982,6 +1182,12 @@ public:
       activity level has been too low. Such columns are identified by having an
       overlap duty cycle that drops too much below those of their peers. The
       permanence values for such columns are increased.
+
+      With lazy duty cycles (see setLazyDutyCycles) the weak columns are
+      tracked instead of found by a scan over all of the columns.  A column can
+      only stop being weak when it overlaps the input, and it becomes weak once
+      the decaying dutyCycleScale_ falls below its minimum over its duty cycle.
+      Everything is recomputed when the minimums change, on update rounds.
   */
   void bumpUpWeakColumns_();
 
@@ -1071,6 +1277,9 @@ public:
   static void updateDutyCyclesHelper_(vector<Real> &dutyCycles,
                                       const SDR &newValues, 
                                       const UInt period);
+  static void updateDutyCyclesHelper_(vector<Real> &dutyCycles,
+                                      const SDR_sparse_t &newValues,
+                                      const UInt period);
 
   /**
   Updates the duty cycles for each column. The OVERLAP duty cycle is a moving
@@ -1088,6 +1297,31 @@ public:
   */
   void updateDutyCycles_(const vector<SynapseIdx> &overlaps, SDR &active);
 
+  /**
+  As above, with the (unsorted) indices of the columns which have any overlap.
+  */
+  void updateDutyCycles_(const SDR_sparse_t &overlapping, const SDR_sparse_t &active);
+
+  /**
+  Folds dutyCycleScale_ into the duty cycles, and computes any boost factors
+  which are computed on demand.  See setLazyDutyCycles.
+  */
+  void normalizeDutyCycles_();
+
+  /**
+  Helpers of the lazy bumpUpWeakColumns_.  trackWeakColumn_ marks the column
+  as weak, or else queues it in weakQueue_ to become weak later.
+  rebuildWeakColumns_ tracks every column from scratch.
+  */
+  void trackWeakColumn_(const UInt column);
+  void rebuildWeakColumns_();
+
+  /**
+  The true duty cycles / boost factors, as the public getters return them.
+  */
+  vector<Real> scaledDutyCycles_(const vector<Real> &dutyCycles) const;
+  Real boostFactor_(const UInt column) const;
+
   /**
     Update the boost factors for all columns. The boost factors are used to
     increase the overlap of inactive columns to improve their chances of
@@ -1172,6 +1406,17 @@ public:
 
 
 protected:
+  /**
+  The inference of the batch computes: boosts and inhibits the overlaps of
+  the inputs [0, numInputs), a block at a time, on the threads of the
+  connections.  computeOverlaps(overlaps, begin, size) counts the overlaps
+  of a block, and setActive(input, chunk, activeColumns) stores the sorted
+  active columns of an input, see ThreadPool::parallelFor for the chunks.
+   */
+  void computeBatch_(const size_t numInputs,
+      const std::function<void(vector<vector<SynapseIdx>> &, size_t, size_t)> &computeOverlaps,
+      const std::function<void(size_t, UInt, vector<CellIdx> &)> &setActive);
+
   UInt numInputs_;
   UInt numColumns_;
   vector<UInt> columnDimensions_;
@@ -1206,6 +1451,27 @@ protected:
 
   Real minPctOverlapDutyCycles_;
 
+  // See setLazyDutyCycles.  The true duty cycles are the stored ones times
+  // dutyCycleScale_, which is 1 unless lazy.  With lazyBoostFactors_ set the
+  // boostFactors_ are stale, see boostFactor_.  Not serialized.
+  bool   lazyDutyCycles_     = false;
+  Real64 dutyCycleScale_     = 1.0;
+  bool   lazyBoostFactors_   = false;
+  Real   boostTargetDensity_ = 0.0f;
+  bool   columnRandomStreams_ = false; // See setColumnRandomStreams.  Not serialized.
+
+  // The weak columns of the lazy bumpUpWeakColumns_, valid while
+  // weakColumnsValid_ is set.  weakColumns_ lists the columns marked in
+  // weakColumn_, possibly with duplicates and columns unmarked since.
+  // weakQueue_ is a max heap of (dutyCycleScale_ below which the column is
+  // weak, column), whose entries are stale unless the scale matches
+  // weakScale_[column] and the column is not marked.  Not serialized.
+  bool   weakColumnsValid_   = false;
+  vector<char>    weakColumn_;
+  vector<Segment> weakColumns_;
+  vector<Real64>  weakScale_;
+  vector<std::pair<Real64, Segment>> weakQueue_;
+
   /*
    * Each mini-column is represented in the connections class by a single cell.
    * Each mini-column has a single segment.  Because all of these regularities,
@@ -1213,7 +1479,10 @@ protected:
    */
   Connections connections_;
 
+  vector<SynapseIdx> overlaps_; //reused from compute to compute, see Connections::computeActivity
+  vector<Segment>    overlapsTouched_;
   vector<Real> boostedOverlaps_;
+  vector<CellIdx> candidates_; //reused from compute to compute, see boostOverlaps_
 
 
   UInt version_;
@@ -1222,8 +1491,6 @@ protected:
 public:
   const Connections& connections = connections_; //for inspection of details in connections. Const, so users cannot break the SP internals.
   const Connections& getConnections() const { return connections_; } // as above, but for use in pybind11
-private:
-  std::unordered_map<UInt, std::vector<UInt>> neighborMap_; // col -> vector neighbors
 };
 
 std::ostream & operator<<(std::ostream & out, const SpatialPooler &sp);
@@ -34,6 +34,7 @@
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <string>
 #include <vector>
 #include <set>
@@ -131,6 +132,8 @@ void TemporalMemory::initialize(
 
   // Initialize member variables
   connections_ = Connections(static_cast<CellIdx>(numberOfColumns() * cellsPerColumn_), connectedPermanence_);
+  leastUsedCells_.subscribedTo = nullptr; // the assignment dropped all subscriptions
+  leastUsedCells_.valid = false;
   rng_ = Random(seed);
 
   maxSegmentsPerCell_ = maxSegmentsPerCell;
@@ -141,22 +144,101 @@ void TemporalMemory::initialize(
   reset();
 }
 
+// Index of the lowest set bit, bits must not be 0.
+static inline UInt lowestBit_(UInt64 bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<UInt>(__builtin_ctzll(bits));
+#else
+  UInt idx = 0u;
+  for( ; (bits & 1u) == 0u; bits >>= 1u) idx++;
+  return idx;
+#endif
+}
+
+void TemporalMemory::LeastUsedCells_::rebuild(TemporalMemory &owner) {
+  tm = &owner;
+  if (subscribedTo != &owner.connections_) {
+    owner.connections_.subscribe(this);
+    subscribedTo = &owner.connections_;
+  }
+  words = (owner.cellsPerColumn_ + 63u) / 64u;
+  minSegments.assign(owner.numberOfColumns(), 0u);
+  mask.assign(static_cast<size_t>(owner.numberOfColumns()) * words, 0u);
+  for (UInt column = 0; column < owner.numberOfColumns(); column++) {
+    rescanColumn(column);
+  }
+  valid = true;
+}
+
+void TemporalMemory::LeastUsedCells_::rescanColumn(const UInt column) {
+  UInt64 *bits = &mask[static_cast<size_t>(column) * words];
+  const CellIdx first = column * tm->cellsPerColumn_;
+  SegmentIdx least = std::numeric_limits<SegmentIdx>::max();
+  for (CellIdx i = 0; i < tm->cellsPerColumn_; i++) {
+    const auto numSegments = static_cast<SegmentIdx>(tm->connections_.numSegments(first + i));
+    if (numSegments < least) {
+      least = numSegments;
+      std::fill(bits, bits + words, 0u);
+    }
+    if (numSegments == least) {
+      bits[i / 64u] |= static_cast<UInt64>(1u) << (i % 64u);
+    }
+  }
+  minSegments[column] = least;
+}
+
+CellIdx TemporalMemory::LeastUsedCells_::get(const UInt column) const {
+  const UInt64 *bits = &mask[static_cast<size_t>(column) * words];
+  UInt w = 0u;
+  while (bits[w] == 0u) w++; // at least one cell has the least segments
+  return column * tm->cellsPerColumn_ + w * 64u + lowestBit_(bits[w]);
+}
+
+void TemporalMemory::LeastUsedCells_::onCreateSegment(const Segment segment) {
+  // Called after the segment is added to its cell.
+  const CellIdx cell   = tm->connections_.cellForSegment(segment);
+  const UInt    column = cell / tm->cellsPerColumn_;
+  const CellIdx i      = cell % tm->cellsPerColumn_;
+  if (tm->connections_.numSegments(cell) - 1u != minSegments[column]) return;
+
+  UInt64 *bits = &mask[static_cast<size_t>(column) * words];
+  bits[i / 64u] &= ~(static_cast<UInt64>(1u) << (i % 64u));
+  if (std::all_of(bits, bits + words, [](const UInt64 b) { return b == 0u; })) {
+    rescanColumn(column); // that was the last of the least used cells
+  }
+}
+
+void TemporalMemory::LeastUsedCells_::onDestroySegment(const Segment segment) {
+  // Called before the segment is removed from its cell.
+  const CellIdx cell   = tm->connections_.cellForSegment(segment);
+  const UInt    column = cell / tm->cellsPerColumn_;
+  const CellIdx i      = cell % tm->cellsPerColumn_;
+  const auto numSegments = static_cast<SegmentIdx>(tm->connections_.numSegments(cell) - 1u);
+
+  UInt64 *bits = &mask[static_cast<size_t>(column) * words];
+  if (numSegments < minSegments[column]) {
+    minSegments[column] = numSegments;
+    std::fill(bits, bits + words, 0u);
+  }
+  if (numSegments == minSegments[column]) {
+    bits[i / 64u] |= static_cast<UInt64>(1u) << (i % 64u);
+  }
+}
+
+
 CellIdx TemporalMemory::getLeastUsedCell_(const CellIdx column) {
   if(cellsPerColumn_ == 1) return column;
 
-  vector<CellIdx> cells = cellsForColumn(column);
-
-  //TODO: decide if we need to choose randomly from the "least used" cells, or if 1st is fine. 
-  //In that case the line below is not needed, and this method can become const, deterministic results in tests need to be updated
-  //un/comment line below: 
-  rng_.shuffle(cells.begin(), cells.end()); //as min_element selects 1st minimal element, and we want to randomly choose 1 from the minimals.
+  // This used to shuffle the column's cells with rng_ and then pick the first
+  // one with the fewest segments, but ties are broken by the cell index, so the
+  // result is always the lowest least used cell.  Keep drawing the same random
+  // numbers as the shuffle did, the rest of the TM depends on the sequence.
+  rng_.discard(cellsPerColumn_ - 1u);
 
-  const auto compareByNumSegments = [&](const CellIdx a, const CellIdx b) {
-    if(connections.numSegments(a) == connections.numSegments(b)) 
-      return a < b; //TODO rm? 
-    else return connections.numSegments(a) < connections.numSegments(b);
-  };
-  return *std::min_element(cells.begin(), cells.end(), compareByNumSegments);
+  if (leastUsedCells_.subscribedTo != &connections_ or not leastUsedCells_.valid) {
+    leastUsedCells_.rebuild(*this);
+  }
+  return leastUsedCells_.get(column);
 }
 
 
@@ -176,15 +258,7 @@ void TemporalMemory::activatePredictedColumn_(
     // This cell might have multiple active segments.
     do {
       if (learn) { 
-        connections_.adaptSegment(*activeSegment, prevActiveCells,
-                     permanenceIncrement_, permanenceDecrement_, true, minThreshold_);
-
-        const Int32 nGrowDesired =
-            static_cast<Int32>(maxNewSynapseCount_) -
-            numActivePotentialSynapsesForSegment_[*activeSegment];
-        if (nGrowDesired > 0) {
-          connections_.growSynapses(*activeSegment, prevWinnerCells, initialPermanence_, rng_, nGrowDesired, maxSynapsesPerSegment_);
-        }
+        learnOnSegment_(*activeSegment, prevActiveCells, prevWinnerCells);
       }
     } while (++activeSegment != columnActiveSegmentsEnd &&
              connections.cellForSegment(*activeSegment) == cell);
@@ -222,28 +296,47 @@ void TemporalMemory::burstColumn_(
   if (learn) {
     if (bestMatchingSegment != columnMatchingSegmentsEnd) {
       // Learn on the best matching segment.
-      connections_.adaptSegment(*bestMatchingSegment, prevActiveCells,
-                   permanenceIncrement_, permanenceDecrement_, true, minThreshold_); //TODO consolidate SP.stimulusThreshold_ & TM.minThreshold_ into Conn.stimulusThreshold ? (replacing segmentThreshold arg used in some methods in Conn) 
-
-      const Int32 nGrowDesired = maxNewSynapseCount_ - numActivePotentialSynapsesForSegment_[*bestMatchingSegment];
-      if (nGrowDesired > 0) {
-        connections_.growSynapses(*bestMatchingSegment, prevWinnerCells, initialPermanence_, rng_, nGrowDesired, maxSynapsesPerSegment_);
-      }
+      learnOnSegment_(*bestMatchingSegment, prevActiveCells, prevWinnerCells);
     } else {
       // No matching segments.
       // Grow a new segment and learn on it.
+      growNewSegment_(winnerCell, prevWinnerCells);
+    }
+  }
+}
 
-      // Don't grow a segment that will never match.
-      const UInt32 nGrowExact =
-          std::min(static_cast<UInt32>(maxNewSynapseCount_), static_cast<UInt32>(prevWinnerCells.size()));
-      if (nGrowExact > 0) {
-        const Segment segment =
-            connections_.createSegment(winnerCell, maxSegmentsPerCell_);
 
-        connections_.growSynapses(segment, prevWinnerCells, initialPermanence_, rng_, nGrowExact, maxSynapsesPerSegment_);
-        NTA_ASSERT(connections.numSynapses(segment) == nGrowExact);
-      }
-    }
+void TemporalMemory::learnOnSegment_(const Segment segment,
+                                     const SDR &prevActiveCells,
+                                     const vector<CellIdx> &prevWinnerCells) {
+  connections_.adaptSegment(segment, prevActiveCells,
+               permanenceIncrement_, permanenceDecrement_, true, minThreshold_); //TODO consolidate SP.stimulusThreshold_ & TM.minThreshold_ into Conn.stimulusThreshold ? (replacing segmentThreshold arg used in some methods in Conn) 
+  growOnSegment_(segment, prevWinnerCells);
+}
+
+
+void TemporalMemory::growOnSegment_(const Segment segment,
+                                    const vector<CellIdx> &prevWinnerCells) {
+  const Int32 nGrowDesired =
+      static_cast<Int32>(maxNewSynapseCount_) -
+      numActivePotentialSynapsesForSegment_[segment];
+  if (nGrowDesired > 0) {
+    connections_.growSynapses(segment, prevWinnerCells, initialPermanence_, rng_, nGrowDesired, maxSynapsesPerSegment_);
+  }
+}
+
+
+void TemporalMemory::growNewSegment_(const CellIdx cell,
+                                     const vector<CellIdx> &prevWinnerCells) {
+  // Don't grow a segment that will never match.
+  const UInt32 nGrowExact =
+      std::min(static_cast<UInt32>(maxNewSynapseCount_), static_cast<UInt32>(prevWinnerCells.size()));
+  if (nGrowExact > 0) {
+    const Segment segment =
+        connections_.createSegment(cell, maxSegmentsPerCell_);
+
+    connections_.growSynapses(segment, prevWinnerCells, initialPermanence_, rng_, nGrowExact, maxSynapsesPerSegment_);
+    NTA_ASSERT(connections.numSynapses(segment) == nGrowExact);
   }
 }
 
@@ -262,6 +355,11 @@ void TemporalMemory::punishPredictedColumn_(
 }
 
 void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
+  SDR prevActiveCells({static_cast<CellIdx>(numberOfCells() + externalPredictiveInputs_)});
+  activateCells_(activeColumns, learn, prevActiveCells);
+}
+
+void TemporalMemory::activateCells_(const SDR &activeColumns, const bool learn, SDR &prevActiveCells) {
     NTA_CHECK(columnDimensions_.size() > 0) << "TM constructed using the default TM() constructor, which may only be used for serialization. "
 	    << "Use TM constructor where you provide at least column dimensions, eg: TM tm({32});";
 
@@ -273,12 +371,19 @@ void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
     }
     auto &sparse = activeColumns.getSparse();
 
-  SDR prevActiveCells({static_cast<CellIdx>(numberOfCells() + externalPredictiveInputs_)});
+  NTA_ASSERT(prevActiveCells.size == numberOfCells() + externalPredictiveInputs_);
   prevActiveCells.setSparse(activeCells_);
   activeCells_.clear();
 
   const vector<CellIdx> prevWinnerCells = std::move(winnerCells_);
 
+  const ThreadPool *pool = connections_.getThreadPool();
+  if (pool != nullptr and sparse.size() >= pool->size()) {
+    activateCellsParallel_(sparse, prevActiveCells, prevWinnerCells, learn);
+    segmentsValid_ = false;
+    return;
+  }
+
   //maps segment S to a new segment that is at start of a column where
   //S belongs. 
   //for 3 cells per columns: 
@@ -339,6 +444,158 @@ void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
 }
 
 
+void TemporalMemory::activateCellsParallel_(const vector<UInt> &sparse,
+                                            const SDR &prevActiveCells,
+                                            const vector<CellIdx> &prevWinnerCells,
+                                            const bool learn) {
+  ThreadPool &pool = *connections_.getThreadPool();
+  NTA_ASSERT(sparse.size() >= pool.size()); // no empty chunks
+  activateCellsChunks_.resize(pool.size());
+
+  const auto toColumns = [&](const Segment segment) {
+    return connections.cellForSegment(segment) / cellsPerColumn_;
+  };
+  const auto identity = [](const ElemSparse a) {return a;};
+  const auto segmentBefore = [&](const Segment segment, const UInt column) {
+    return toColumns(segment) < column;
+  };
+  using SegmentIter = vector<Segment>::const_iterator;
+
+  if (learn) {
+    prevActiveCells.getDense(); // Convert the input once, before the threads read it.
+    connections_.prepareDeferredAdaptations();
+  }
+  const auto adapt = [&](const Segment segment, const Permanence increment,
+                         const Permanence decrement, const UInt chunk) {
+    connections_.adaptSegmentDeferred(segment, prevActiveCells, increment, decrement,
+                                      true, minThreshold_, chunk);
+  };
+
+  pool.parallelFor(sparse.size(), [&](size_t begin, size_t end, UInt chunk) {
+    // The chunk owns the columns [sparse[begin], sparse[end]).  The first and
+    // last chunks extend to the ends, to include the predicted inactive columns.
+    const UInt columnBegin = begin == 0u ? 0u : sparse[begin];
+    const UInt columnEnd   = end == sparse.size() ? numColumns_ : sparse[end];
+    const auto activeBegin   = std::lower_bound(activeSegments_.cbegin(),   activeSegments_.cend(),   columnBegin, segmentBefore);
+    const auto activeEnd     = std::lower_bound(activeBegin,                activeSegments_.cend(),   columnEnd,   segmentBefore);
+    const auto matchingBegin = std::lower_bound(matchingSegments_.cbegin(), matchingSegments_.cend(), columnBegin, segmentBefore);
+    const auto matchingEnd   = std::lower_bound(matchingBegin,              matchingSegments_.cend(), columnEnd,   segmentBefore);
+
+    auto &out = activateCellsChunks_[chunk];
+    out.activeCells.clear();
+    out.winnerCells.clear();
+    out.deferred.clear();
+
+    const GroupBy3<vector<UInt>::const_iterator, decltype(identity),
+                   SegmentIter, decltype(toColumns),
+                   SegmentIter, decltype(toColumns)> columns(
+        sparse.cbegin() + begin, sparse.cbegin() + end, identity,
+        activeBegin,   activeEnd,   toColumns,
+        matchingBegin, matchingEnd, toColumns);
+
+    for (auto &&columnData : columns) {
+      UInt column;
+      vector<UInt>::const_iterator activeColumnsBegin, activeColumnsEnd;
+      SegmentIter columnActiveSegmentsBegin, columnActiveSegmentsEnd,
+                  columnMatchingSegmentsBegin, columnMatchingSegmentsEnd;
+      std::tie(column,
+               activeColumnsBegin, activeColumnsEnd,
+               columnActiveSegmentsBegin, columnActiveSegmentsEnd,
+               columnMatchingSegmentsBegin, columnMatchingSegmentsEnd) = columnData;
+      const size_t activeIdx   = columnActiveSegmentsBegin   - activeSegments_.cbegin();
+      const size_t matchingIdx = columnMatchingSegmentsBegin - matchingSegments_.cbegin();
+      const size_t numMatching = columnMatchingSegmentsEnd   - columnMatchingSegmentsBegin;
+
+      if (activeColumnsBegin != activeColumnsEnd) {
+        if (columnActiveSegmentsBegin != columnActiveSegmentsEnd) {
+          // Predicted: the cells with active segments, see activatePredictedColumn_
+          for (auto segment = columnActiveSegmentsBegin; segment != columnActiveSegmentsEnd; segment++) {
+            const CellIdx cell = connections.cellForSegment(*segment);
+            if (out.activeCells.empty() or out.activeCells.back() != cell) {
+              out.activeCells.push_back(cell);
+              out.winnerCells.push_back(cell);
+            }
+          }
+          if (learn) {
+            for (auto segment = columnActiveSegmentsBegin; segment != columnActiveSegmentsEnd; segment++) {
+              adapt(*segment, permanenceIncrement_, permanenceDecrement_, chunk);
+            }
+            out.deferred.push_back({DeferredColumn_::PREDICTED, column, activeIdx,
+                                    activeIdx + (columnActiveSegmentsEnd - columnActiveSegmentsBegin), 0u});
+          }
+        } else {
+          // Bursting, see burstColumn_
+          for (CellIdx cell = column * cellsPerColumn_; cell < (column + 1u) * cellsPerColumn_; cell++) {
+            out.activeCells.push_back(cell);
+          }
+          const auto bestMatchingSegment =
+              std::max_element(columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
+                               [&](Segment a, Segment b) {
+                                 return (numActivePotentialSynapsesForSegment_[a] <
+                                         numActivePotentialSynapsesForSegment_[b]);
+                               });
+          if (bestMatchingSegment != columnMatchingSegmentsEnd) {
+            out.winnerCells.push_back(connections.cellForSegment(*bestMatchingSegment));
+            if (learn) {
+              adapt(*bestMatchingSegment, permanenceIncrement_, permanenceDecrement_, chunk);
+              const size_t best = bestMatchingSegment - matchingSegments_.cbegin();
+              out.deferred.push_back({DeferredColumn_::BURST, column, best, best + 1u, 0u});
+            }
+          } else {
+            // The least used cell draws random numbers, it's picked later.
+            out.deferred.push_back({DeferredColumn_::BURST, column, matchingIdx, matchingIdx,
+                                    out.winnerCells.size()});
+            out.winnerCells.push_back(0u);
+          }
+        }
+      } else if (learn and predictedSegmentDecrement_ > 0.0) {
+        for (auto segment = columnMatchingSegmentsBegin; segment != columnMatchingSegmentsEnd; segment++) {
+          adapt(*segment, -predictedSegmentDecrement_, 0.0f, chunk);
+        }
+        out.deferred.push_back({DeferredColumn_::PUNISH, column, matchingIdx,
+                                matchingIdx + numMatching, 0u});
+      }
+    }
+  });
+
+  // Apply the deferred work in column order, as activateCells_ would.
+  activeCells_.clear();
+  winnerCells_.clear();
+  for (UInt chunk = 0u; chunk < activateCellsChunks_.size(); chunk++) {
+    auto &out = activateCellsChunks_[chunk];
+    for (const auto &work : out.deferred) {
+      switch (work.kind) {
+        case DeferredColumn_::PREDICTED:
+          for (size_t i = work.begin; i < work.end; i++) {
+            connections_.applyDeferredAdaptation(chunk);
+            growOnSegment_(activeSegments_[i], prevWinnerCells);
+          }
+          break;
+        case DeferredColumn_::BURST:
+          if (work.begin != work.end) {
+            connections_.applyDeferredAdaptation(chunk);
+            growOnSegment_(matchingSegments_[work.begin], prevWinnerCells);
+          } else {
+            const CellIdx winnerCell = getLeastUsedCell_(work.column);
+            out.winnerCells[work.winner] = winnerCell;
+            if (learn) {
+              growNewSegment_(winnerCell, prevWinnerCells);
+            }
+          }
+          break;
+        case DeferredColumn_::PUNISH:
+          for (size_t i = work.begin; i < work.end; i++) {
+            connections_.applyDeferredAdaptation(chunk);
+          }
+          break;
+      }
+    }
+    activeCells_.insert(activeCells_.end(), out.activeCells.cbegin(), out.activeCells.cend());
+    winnerCells_.insert(winnerCells_.end(), out.winnerCells.cbegin(), out.winnerCells.cend());
+  }
+}
+
+
 void TemporalMemory::activateDendrites(const bool learn,
                                        const SDR &externalPredictiveInputsActive,
                                        const SDR &externalPredictiveInputsWinners)
@@ -373,37 +630,92 @@ void TemporalMemory::activateDendrites(const bool learn,
       winnerCells_.push_back( static_cast<CellIdx>(winner + numberOfCells()) );
   }
 
-  const size_t length = connections.segmentFlatListLength();
-
-  numActivePotentialSynapsesForSegment_.assign(length, 0);
-  numActiveConnectedSynapsesForSegment_ = connections_.computeActivity(
-                              numActivePotentialSynapsesForSegment_,
-                              activeCells_,
-			      learn);
-
-  // Active segments, connected synapses.
-  activeSegments_.clear();
-  for (size_t segment = 0; segment < numActiveConnectedSynapsesForSegment_.size(); segment++) {
-    if (numActiveConnectedSynapsesForSegment_[segment] >= activationThreshold_) { //TODO move to SegmentData.numConnected?
-      activeSegments_.push_back(static_cast<UInt>(segment));
+  // The buffers are reused from step to step, only the segments touched
+  // last time get zeroed.
+  connections_.computeActivity(numActiveConnectedSynapsesForSegment_,
+                               numActivePotentialSynapsesForSegment_,
+                               touchedSegments_,
+                               activeCells_,
+                               learn);
+
+  // Only the touched segments can pass either threshold, unless the
+  // minThreshold is zero: then every segment is matching, touched or not.
+  // Collect them keyed by (cell, segment), which is the order of
+  // Connections::compareSegments.
+  segmentSortKeys_.clear();
+  if (minThreshold_ == 0u) {
+    const size_t length = numActivePotentialSynapsesForSegment_.size();
+    for (size_t segment = 0; segment < length; segment++) {
+      segmentSortKeys_.push_back(
+          (static_cast<UInt64>(connections_.cellForSegment(static_cast<Segment>(segment))) << 32u) | segment);
+    }
+  }
+  else for (const Segment segment : touchedSegments_) {
+    if (numActiveConnectedSynapsesForSegment_[segment] >= activationThreshold_ or
+        numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
+      segmentSortKeys_.push_back(
+          (static_cast<UInt64>(connections_.cellForSegment(segment)) << 32u) | segment);
     }
   }
-  const auto compareSegments = [&](const Segment a, const Segment b) { return connections.compareSegments(a, b); };
-  std::sort( activeSegments_.begin(), activeSegments_.end(), compareSegments); //SDR requires sorted when constructed from activeSegments_
+  sortSegmentKeys_(); //SDR requires sorted when constructed from activeSegments_
 
+  // Active segments, connected synapses.
   // Matching segments, potential synapses.
+  activeSegments_.clear();
   matchingSegments_.clear();
-  for (size_t segment = 0; segment < numActivePotentialSynapsesForSegment_.size(); segment++) {
+  for (const UInt64 key : segmentSortKeys_) {
+    const Segment segment = static_cast<Segment>(key & 0xFFFFFFFFu);
+    if (numActiveConnectedSynapsesForSegment_[segment] >= activationThreshold_) { //TODO move to SegmentData.numConnected?
+      activeSegments_.push_back(segment);
+    }
     if (numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
-      matchingSegments_.push_back(static_cast<UInt>(segment));
+      matchingSegments_.push_back(segment);
     }
   }
-  std::sort( matchingSegments_.begin(), matchingSegments_.end(), compareSegments);
 
   segmentsValid_ = true;
 }
 
 
+void TemporalMemory::sortSegmentKeys_() {
+  const size_t n = segmentSortKeys_.size();
+  // Few keys: the fixed cost of the histograms would dominate.
+  if (n < 256u) {
+    std::sort(segmentSortKeys_.begin(), segmentSortKeys_.end());
+    return;
+  }
+
+  // LSD radix sort over bytes, skipping the bytes which are equal in all keys.
+  UInt64 anyBits = 0u, allBits = ~static_cast<UInt64>(0u);
+  for (const UInt64 key : segmentSortKeys_) {
+    anyBits |= key;
+    allBits &= key;
+  }
+  const UInt64 varying = anyBits ^ allBits;
+
+  segmentSortScratch_.resize(n);
+  size_t histogram[256];
+  for (UInt shift = 0u; shift < 64u; shift += 8u) {
+    if (((varying >> shift) & 0xFFu) == 0u) continue;
+
+    std::fill(std::begin(histogram), std::end(histogram), 0u);
+    for (const UInt64 key : segmentSortKeys_) {
+      histogram[(key >> shift) & 0xFFu]++;
+    }
+    size_t offset = 0u;
+    for (auto &count : histogram) {
+      const size_t c = count;
+      count  = offset;
+      offset += c;
+    }
+    for (const UInt64 key : segmentSortKeys_) {
+      segmentSortScratch_[histogram[(key >> shift) & 0xFFu]++] = key;
+    }
+    segmentSortKeys_.swap(segmentSortScratch_);
+  }
+}
+
+
 void TemporalMemory::compute(const SDR &activeColumns, 
                              const bool learn,
                              const SDR &externalPredictiveInputsActive,
@@ -480,6 +792,13 @@ UInt TemporalMemory::columnForCell(const CellIdx cell) const {
 
 
 SDR TemporalMemory::cellsToColumns(const SDR& cells) const {
+  SDR cols(getColumnDimensions());
+  cellsToColumns(cells, cols);
+  return cols;
+}
+
+
+void TemporalMemory::cellsToColumns(const SDR& cells, SDR& columns) const {
   auto correctDims = getColumnDimensions(); //nD column dimensions (eg 10x100)
   correctDims.push_back(static_cast<CellIdx>(getCellsPerColumn())); //add n+1-th dimension for cellsPerColumn (eg. 10x100x8)
 
@@ -488,17 +807,18 @@ SDR TemporalMemory::cellsToColumns(const SDR& cells) const {
 
   for(size_t i = 0; i<correctDims.size(); i++) 
 	  NTA_CHECK(correctDims[i] == cells.dimensions[i]);
+  NTA_CHECK(columns.size == numColumns_) << "columns must have the size of TM's getColumnDimensions()";
 
-  SDR cols(getColumnDimensions());
-  auto& dense = cols.getDense();
+  // The cells are sorted, so the cells of a column are next to each other.
+  auto &cols = columns.getSparse();
+  cols.clear();
   for(const auto cell : cells.getSparse()) {
     const auto col = columnForCell(cell);
-    dense[col] = static_cast<ElemDense>(1);
+    if(cols.empty() or cols.back() != col) {
+      cols.push_back(col);
+    }
   }
-  cols.setDense(dense);
-
-  NTA_ASSERT(cols.size == numColumns_); 
-  return cols;
+  columns.setSparse(cols);
 }
 
 
@@ -517,7 +837,7 @@ void TemporalMemory::getActiveCells(SDR &activeCells) const
 {
   UInt nbr_cells = static_cast<UInt>(numberOfCells());
   NTA_CHECK( activeCells.size == nbr_cells );
-  activeCells.setSparse( getActiveCells() );
+  activeCells.setSparse( activeCells_ );
 }
 
 
@@ -549,7 +869,7 @@ vector<CellIdx> TemporalMemory::getWinnerCells() const { return winnerCells_; }
 void TemporalMemory::getWinnerCells(SDR &winnerCells) const
 {
   NTA_CHECK( winnerCells.size == numberOfCells() );
-  winnerCells.setSparse( getWinnerCells() );
+  winnerCells.setSparse( winnerCells_ );
 }
 
 vector<Segment> TemporalMemory::getActiveSegments() const
@@ -642,6 +962,22 @@ SynapseIdx TemporalMemory::getMaxSynapsesPerSegment() const {
   return maxSynapsesPerSegment_;
 }
 
+UInt TemporalMemory::getNumThreads() const {
+  return connections_.getNumThreads();
+}
+
+void TemporalMemory::setNumThreads(const UInt numThreads) {
+  connections_.setNumThreads(numThreads);
+}
+
+Real TemporalMemory::getAutoCompact() const {
+  return connections_.getAutoCompact();
+}
+
+void TemporalMemory::setAutoCompact(const Real maxDestroyedFraction) {
+  connections_.setAutoCompact(maxDestroyedFraction);
+}
+
 UInt TemporalMemory::version() const { return TM_VERSION; }
 
 
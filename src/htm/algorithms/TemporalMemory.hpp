@@ -29,6 +29,8 @@
 #include <htm/utils/Random.hpp>
 #include <htm/algorithms/AnomalyLikelihood.hpp>
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
 
@@ -443,6 +445,28 @@ public:
    */
   SynapseIdx getMaxSynapsesPerSegment() const;
 
+  /**
+   * Number of threads to compute with, see Connections::setNumThreads.
+   * This is a run-time setting, it is not serialized and does not change the
+   * results.  Default 1, 0 uses all of the hardware threads.
+   *
+   * The threads are also used by activateCells, which splits the columns
+   * between them.  Each thread adapts the segments of its columns, see
+   * Connections::adaptSegmentDeferred.  The rest of the learning, which grows
+   * synapses and segments and draws random numbers, is applied afterwards in
+   * column order.
+   */
+  UInt getNumThreads() const;
+  void setNumThreads(const UInt numThreads);
+
+  /**
+   * Compact the Connections automatically, see Connections::setAutoCompact.
+   * The TM recomputes its segment lists right after every compaction.
+   * This is a run-time setting, it is not serialized.  Default 0, never.
+   */
+  Real getAutoCompact() const;
+  void setAutoCompact(const Real maxDestroyedFraction);
+
   /**
    * Save (serialize) / Load (deserialize) the current state of the spatial pooler
    * to the specified stream.
@@ -558,11 +582,15 @@ public:
        CEREAL_NVP(tmAnomaly_.mode_),
        CEREAL_NVP(tmAnomaly_.anomalyLikelihood_),
        CEREAL_NVP(connections_));
+    leastUsedCells_.valid = false; // connections_ changed without events
     
+    numActiveConnectedSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
+    numActivePotentialSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
+    activeSegments_.clear();
+    matchingSegments_.clear();
     size_t activeSize;
     ar(CEREAL_NVP(activeSize));
     if (activeSize > 0) {
-      numActiveConnectedSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
       cereal::size_type numActiveSegments;
       ar(cereal::make_size_tag(numActiveSegments));
       activeSegments_.resize(static_cast<size_t>(numActiveSegments));
@@ -577,7 +605,6 @@ public:
     size_t matchSize;
     ar(CEREAL_NVP(matchSize));
     if (matchSize > 0) {
-      numActivePotentialSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
       cereal::size_type numMatchingSegments;
       ar(cereal::make_size_tag(numMatchingSegments));
       matchingSegments_.resize(static_cast<size_t>(numMatchingSegments));
@@ -589,6 +616,12 @@ public:
         numActivePotentialSynapsesForSegment_[segment] = c.syn;
       }
     }
+    // The only non-zero entries of the buffers are the active & matching segments.
+    touchedSegments_.clear();
+    std::set_union(activeSegments_.cbegin(),   activeSegments_.cend(),
+                   matchingSegments_.cbegin(), matchingSegments_.cend(),
+                   std::back_inserter(touchedSegments_),
+                   [&](const Segment a, const Segment b) { return connections.compareSegments(a, b); });
   }
 
 
@@ -638,6 +671,12 @@ public:
    *
    */
   SDR cellsToColumns(const SDR& cells) const;
+
+  /**
+   *  Same as above, but writes the columns into the given SDR, which reuses
+   *  its buffers.  Its size must be that of TM's getColumnDimensions().
+   */
+  void cellsToColumns(const SDR& cells, SDR& columns) const;
 private:
   void punishPredictedColumn_(vector<Segment>::const_iterator columnMatchingSegmentsBegin, 
 		              vector<Segment>::const_iterator columnMatchingSegmentsEnd, 
@@ -662,8 +701,41 @@ private:
 
   CellIdx getLeastUsedCell_(const CellIdx column);
 
+  /**
+   * Implementation of activateCells, with a caller provided SDR of size
+   * numberOfCells() + externalPredictiveInputs to hold the previous active
+   * cells.  The SDR's buffers are reused, its value is overwritten.
+   */
+  void activateCells_(const SDR &activeColumns, const bool learn, SDR &prevActiveCells);
+
+  /**
+   * Multithreaded part of activateCells_, see setNumThreads.  Requires at
+   * least one active column per thread.
+   */
+  void activateCellsParallel_(const vector<UInt> &activeColumns,
+                              const SDR &prevActiveCells,
+                              const vector<CellIdx> &prevWinnerCells,
+                              const bool learn);
+
+  // Learning on a segment, shared by activatePredictedColumn_ & burstColumn_.
+  // growOnSegment_ is its second half, after adapting the segment.
+  void learnOnSegment_(const Segment segment,
+                       const SDR &prevActiveCells,
+                       const vector<CellIdx> &prevWinnerCells);
+  void growOnSegment_(const Segment segment,
+                      const vector<CellIdx> &prevWinnerCells);
+  void growNewSegment_(const CellIdx cell,
+                       const vector<CellIdx> &prevWinnerCells);
+  friend class TemporalMemoryBatch; //shares the above scratch SDR between its models
+
   void calculateAnomalyScore_(const SDR &activeColumns);
 
+  /**
+   * Sorts segmentSortKeys_ ascending.  Each key holds (cell << 32 | segment),
+   * so the result is in the order given by Connections::compareSegments.
+   */
+  void sortSegmentKeys_();
+
 protected:
   //all these could be const
   CellIdx numColumns_;
@@ -690,6 +762,26 @@ private:
   vector<Segment> matchingSegments_;
   vector<SynapseIdx> numActiveConnectedSynapsesForSegment_;
   vector<SynapseIdx> numActivePotentialSynapsesForSegment_;
+  vector<Segment>    touchedSegments_; //non-zero entries of the two above, see Connections::computeActivity
+  vector<UInt64>     segmentSortKeys_;    //scratch for activateDendrites
+  vector<UInt64>     segmentSortScratch_;
+
+  // Output of one thread of activateCellsParallel_.  The deferred work is
+  // applied by the calling thread, in column order.  The segments in
+  // [begin, end) are already adapted, their Connections::applyDeferredAdaptation
+  // is still to do.
+  struct DeferredColumn_ {
+    enum Kind { PREDICTED, BURST, PUNISH } kind;
+    UInt    column;
+    size_t  begin, end;  // range of activeSegments_ (PREDICTED) or matchingSegments_
+    size_t  winner;      // BURST: index into winnerCells, for getLeastUsedCell_
+  };
+  struct ActivateCellsChunk_ {
+    vector<CellIdx>         activeCells;
+    vector<CellIdx>         winnerCells;
+    vector<DeferredColumn_> deferred;
+  };
+  vector<ActivateCellsChunk_> activateCellsChunks_;
 
   Random rng_;
 
@@ -705,6 +797,27 @@ private:
   };
   Connections connections_;
 
+  /**
+   * The cells with the fewest segments in each column, for getLeastUsedCell_.
+   * Kept up to date through Connections events.  It subscribes itself to
+   * connections_ when first used, and is never unsubscribed, so it lives
+   * exactly as long as connections_.
+   */
+  struct LeastUsedCells_ : public ConnectionsEventHandler {
+    void rebuild(TemporalMemory &owner);
+    void rescanColumn(const UInt column);
+    CellIdx get(const UInt column) const;
+    void onCreateSegment(Segment segment) override;
+    void onDestroySegment(Segment segment) override;
+
+    const TemporalMemory *tm           = nullptr;
+    const Connections    *subscribedTo = nullptr; //a copied TM is not subscribed yet
+    bool                  valid        = false;
+    UInt                  words        = 0u;  //64 bit words per column in mask
+    vector<SegmentIdx>    minSegments;        //per column, least number of segments on a cell
+    vector<UInt64>        mask;               //per column, bit i set if cell i has minSegments
+  } leastUsedCells_;
+
 public:
   const Connections& connections = connections_; //const view of Connections for the public
 
@@ -0,0 +1,143 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of the TemporalMemoryBatch class
+ */
+
+#include <htm/algorithms/TemporalMemoryBatch.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace std;
+using namespace htm;
+
+
+TemporalMemoryBatch::TemporalMemoryBatch(
+    UInt numModels,
+    vector<CellIdx> columnDimensions,
+    CellIdx cellsPerColumn,
+    SynapseIdx activationThreshold,
+    Permanence initialPermanence,
+    Permanence connectedPermanence,
+    SynapseIdx minThreshold,
+    SynapseIdx maxNewSynapseCount,
+    Permanence permanenceIncrement,
+    Permanence permanenceDecrement,
+    Permanence predictedSegmentDecrement,
+    Int seed,
+    SegmentIdx maxSegmentsPerCell,
+    SynapseIdx maxSynapsesPerSegment,
+    bool checkInputs,
+    UInt externalPredictiveInputs,
+    TemporalMemory::ANMode anomalyMode)
+  : noExternalInputs_({ externalPredictiveInputs })
+{
+  NTA_CHECK(numModels > 0u) << "TemporalMemoryBatch needs at least one model";
+
+  models_.reserve(numModels);
+  for(UInt model = 0u; model < numModels; model++) {
+    models_.emplace_back(new TemporalMemory(
+        columnDimensions, cellsPerColumn, activationThreshold,
+        initialPermanence, connectedPermanence, minThreshold,
+        maxNewSynapseCount, permanenceIncrement, permanenceDecrement,
+        predictedSegmentDecrement,
+        seed == 0 ? 0 : static_cast<Int>(seed + model),
+        maxSegmentsPerCell, maxSynapsesPerSegment, checkInputs,
+        externalPredictiveInputs, anomalyMode));
+  }
+  setNumThreads(1u);
+  // Make the dense & sparse formats valid up front, after this the threads
+  // only ever read the shared SDR.
+  noExternalInputs_.getDense();
+}
+
+
+void TemporalMemoryBatch::setNumThreads(const UInt numThreads) {
+  threadPool_.reset();
+  if( numThreads != 1u ) {
+    threadPool_ = std::make_shared<ThreadPool>( numThreads );
+    if( threadPool_->size() == 1u ) { // numThreads == 0 on a single core machine.
+      threadPool_.reset();
+    }
+  }
+  const auto &tm = *models_[0];
+  prevActiveCells_.assign( getNumThreads(),
+      SDR({ static_cast<UInt>(tm.numberOfCells() + tm.externalPredictiveInputs) }));
+}
+
+
+void TemporalMemoryBatch::reset() {
+  for( auto &tm : models_ ) {
+    tm->reset();
+  }
+}
+
+
+void TemporalMemoryBatch::computeRange_(const size_t begin, const size_t end, const UInt thread,
+                                        const vector<SDR> &activeColumns,
+                                        const bool learn,
+                                        const vector<SDR> *externalPredictiveInputsActive,
+                                        const vector<SDR> *externalPredictiveInputsWinners)
+{
+  for(size_t model = begin; model < end; model++) {
+    TemporalMemory &tm = *models_[model];
+    const SDR &active  = externalPredictiveInputsActive  ? (*externalPredictiveInputsActive)[model]  : noExternalInputs_;
+    const SDR &winners = externalPredictiveInputsWinners ? (*externalPredictiveInputsWinners)[model] : noExternalInputs_;
+    // Same steps as TemporalMemory::compute
+    tm.activateDendrites(learn, active, winners);
+    tm.calculateAnomalyScore_(activeColumns[model]);
+    tm.activateCells_(activeColumns[model], learn, prevActiveCells_[thread]);
+  }
+}
+
+
+void TemporalMemoryBatch::compute(const vector<SDR> &activeColumns,
+                                  const bool learn,
+                                  const vector<SDR> &externalPredictiveInputsActive,
+                                  const vector<SDR> &externalPredictiveInputsWinners)
+{
+  NTA_CHECK( externalPredictiveInputsActive.size()  == models_.size() );
+  NTA_CHECK( externalPredictiveInputsWinners.size() == models_.size() );
+  NTA_CHECK( activeColumns.size() == models_.size() )
+      << "TemporalMemoryBatch needs one SDR per model, got " << activeColumns.size()
+      << " for " << models_.size() << " models";
+
+  if( not threadPool_ ) {
+    computeRange_(0u, models_.size(), 0u, activeColumns, learn,
+                  &externalPredictiveInputsActive, &externalPredictiveInputsWinners);
+    return;
+  }
+  threadPool_->parallelFor( models_.size(), [&](size_t begin, size_t end, UInt chunk) {
+    computeRange_(begin, end, chunk, activeColumns, learn,
+                  &externalPredictiveInputsActive, &externalPredictiveInputsWinners);
+  });
+}
+
+
+void TemporalMemoryBatch::compute(const vector<SDR> &activeColumns, const bool learn) {
+  NTA_CHECK( activeColumns.size() == models_.size() )
+      << "TemporalMemoryBatch needs one SDR per model, got " << activeColumns.size()
+      << " for " << models_.size() << " models";
+
+  if( not threadPool_ ) {
+    computeRange_(0u, models_.size(), 0u, activeColumns, learn, nullptr, nullptr);
+    return;
+  }
+  threadPool_->parallelFor( models_.size(), [&](size_t begin, size_t end, UInt chunk) {
+    computeRange_(begin, end, chunk, activeColumns, learn, nullptr, nullptr);
+  });
+}
@@ -0,0 +1,155 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the TemporalMemoryBatch class
+ */
+
+#ifndef NTA_TEMPORAL_MEMORY_BATCH_HPP
+#define NTA_TEMPORAL_MEMORY_BATCH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <htm/algorithms/TemporalMemory.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/types/Types.hpp>
+#include <htm/utils/ThreadPool.hpp>
+
+namespace htm {
+
+/**
+ * TemporalMemoryBatch class
+ *
+ * Steps many independent TemporalMemory models, which all have the same
+ * parameters, with a single call.  This is meant for applications which run
+ * one small model per data stream.  Compared to calling TM.compute for each
+ * model, the batch reuses the scratch SDRs of a time step between all of its
+ * models, and it can spread the models over several threads.
+ *
+ * The models never interact.  Model i is the same as a TemporalMemory
+ * constructed with the batch's parameters and seed `seed + i`, so the results
+ * do not depend on the number of threads.
+ *
+ * Example usage:
+ *
+ *     TemporalMemoryBatch batch(numStreams, {64}, 16);
+ *     batch.setNumThreads(0);
+ *     vector<SDR> columns(numStreams, SDR({64}));
+ *     while (true) {
+ *       <encode & pool each stream into columns[i]>
+ *       batch.compute(columns, learn);
+ *       <use batch[i].anomaly, batch[i].getActiveCells(), ...>
+ *     }
+ */
+class TemporalMemoryBatch
+{
+public:
+  /**
+   * @param numModels Number of models in the batch.
+   *
+   * All other parameters are the same as for the TemporalMemory constructor,
+   * they apply to every model.  If the seed is 0 then every model is randomly
+   * seeded, otherwise model i uses `seed + i`.
+   */
+  TemporalMemoryBatch(
+      UInt            numModels,
+      vector<CellIdx> columnDimensions,
+      CellIdx         cellsPerColumn              = 32,
+      SynapseIdx      activationThreshold         = 13,
+      Permanence      initialPermanence           = static_cast<Permanence>(0.21),
+      Permanence      connectedPermanence         = static_cast<Permanence>(0.50),
+      SynapseIdx      minThreshold                = 10,
+      SynapseIdx      maxNewSynapseCount          = 20,
+      Permanence      permanenceIncrement         = static_cast<Permanence>(0.10),
+      Permanence      permanenceDecrement         = static_cast<Permanence>(0.10),
+      Permanence      predictedSegmentDecrement   = static_cast<Permanence>(0.0),
+      Int             seed                        = 42,
+      SegmentIdx      maxSegmentsPerCell          = 255,
+      SynapseIdx      maxSynapsesPerSegment       = 255,
+      bool            checkInputs                 = true,
+      UInt            externalPredictiveInputs    = 0,
+      TemporalMemory::ANMode anomalyMode          = TemporalMemory::ANMode::RAW
+      );
+
+  /**
+   * @returns Number of models in the batch.
+   */
+  UInt size() const { return static_cast<UInt>(models_.size()); }
+
+  /**
+   * Access to a single model, for example to read its output or to
+   * serialize it.
+   */
+  TemporalMemory &operator[](const UInt model)
+    { NTA_ASSERT(model < size()); return *models_[model]; }
+  const TemporalMemory &operator[](const UInt model) const
+    { NTA_ASSERT(model < size()); return *models_[model]; }
+
+  /**
+   * Perform one time step of every model, see TemporalMemory::compute.
+   *
+   * @param activeColumns  One SDR of active columns per model.
+   * @param learn          Whether or not learning is enabled.
+   */
+  void compute(const std::vector<SDR> &activeColumns,
+               const bool learn = true);
+
+  /**
+   * As above, with one SDR of active and one SDR of winning external
+   * predictive inputs per model.
+   */
+  void compute(const std::vector<SDR> &activeColumns,
+               const bool learn,
+               const std::vector<SDR> &externalPredictiveInputsActive,
+               const std::vector<SDR> &externalPredictiveInputsWinners);
+
+  /**
+   * Resets the sequence state of every model, see TemporalMemory::reset.
+   */
+  void reset();
+
+  /**
+   * Number of threads which the models are split between.  Each thread steps
+   * a contiguous range of models.  This is a run-time setting.
+   *
+   * @param numThreads  1 (default) computes on the calling thread only,
+   *                    0 uses all of the hardware threads.
+   */
+  void setNumThreads(const UInt numThreads);
+  UInt getNumThreads() const
+    { return threadPool_ ? threadPool_->size() : 1u; }
+
+private:
+  void computeRange_(const size_t begin, const size_t end, const UInt thread,
+                     const std::vector<SDR> &activeColumns,
+                     const bool learn,
+                     const std::vector<SDR> *externalPredictiveInputsActive,
+                     const std::vector<SDR> *externalPredictiveInputsWinners);
+
+  std::vector<std::unique_ptr<TemporalMemory>> models_;
+
+  // Scratch shared by the models: one SDR of previous active cells per
+  // thread, and the (read only) empty external inputs.
+  std::vector<SDR> prevActiveCells_;
+  SDR              noExternalInputs_;
+
+  std::shared_ptr<ThreadPool> threadPool_;
+};
+
+} // namespace htm
+#endif // NTA_TEMPORAL_MEMORY_BATCH_HPP
@@ -23,6 +23,7 @@
 #define NTA_ENCODERS_BASE
 
 #include <htm/types/Sdr.hpp>
+#include <htm/types/SdrBatch.hpp>
 
 namespace htm {
 
@@ -62,11 +63,40 @@ public:
 
     virtual void encode(DataType input, SDR &output) = 0;
 
+    /**
+     * Encodes many inputs at once.  The output is reinitialized to the
+     * dimensions of the encoder and holds the encoding of each input, in
+     * order.  The results are the same as from calling encode for each input.
+     *
+     * @param inputs     Array of the values to encode.
+     * @param numInputs  Number of values.
+     * @param output     Batch of the encoded SDRs, see SDRBatch.
+     */
+    void encodeBatch(const DataType *inputs, const size_t numInputs, SDRBatch &output)
+        { encodeBatch_( inputs, numInputs, output ); }
+
+    void encodeBatch(const std::vector<DataType> &inputs, SDRBatch &output)
+        { encodeBatch_( inputs.data(), inputs.size(), output ); }
+
     virtual ~BaseEncoder() {}
 
 protected:
     BaseEncoder() {}
 
+    /**
+     * Subclasses may override this to write the sparse output of each input
+     * straight into the batch.  The default encodes each input into an SDR
+     * and copies it into the batch.
+     */
+    virtual void encodeBatch_(const DataType *inputs, const size_t numInputs, SDRBatch &output) {
+        output.initialize( dimensions_ );
+        SDR encoding( dimensions_ );
+        for( size_t i = 0; i < numInputs; i++ ) {
+            encode( inputs[i], encoding );
+            output.push_back( encoding );
+        }
+    }
+
     BaseEncoder(const std::vector<UInt> dimensions)
         { initialize( dimensions ); }
 
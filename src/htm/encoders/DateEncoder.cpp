@@ -220,16 +220,48 @@ void DateEncoder::encode(std::chrono::system_clock::time_point time_point, SDR &
  * encode time from struct tm 
  */
 void DateEncoder::encode(struct std::tm timeinfo, SDR &output) {
-  // -------------------------------------------------------------------------
-  // Encode each sub-field
-  std::vector<const SDR *> sdrs;
-  SDR season_output;
-  SDR dayOfWeek_output;
-  SDR weekend_output;
-  SDR customDay_output;
-  SDR holiday_output;
-  SDR timeOfDay_output;
-  
+  NTA_CHECK( output.size == size );
+  auto &sparse = output.getSparse();
+  sparse.clear();
+  encodeSparse_(timeinfo, sparse);
+  output.setSparse(sparse);
+  VERBOSE << "  Result: ==> " << output << std::endl;
+}
+
+
+void DateEncoder::encodeBatch_(const std::time_t *inputs, const size_t numInputs, SDRBatch &output) {
+  output.initialize(dimensions);
+  SDR_sparse_t sparse;
+  for (size_t i = 0; i < numInputs; i++) {
+    // Same as encode(time_t), without an SDR.
+    std::time_t input = (inputs[i] == 0) ? time(0) : inputs[i];
+    struct std::tm timeinfo = *std::localtime(&input);
+    sparse.clear();
+    encodeSparse_(timeinfo, sparse);
+    output.push_back(sparse);
+  }
+}
+
+
+/**
+ * Appends the encoding of each sub-field to the sparse output.  The sub-fields
+ * are concatenated, so each one's bits are offset by the sizes of the
+ * sub-fields before it.
+ */
+void DateEncoder::encodeSparse_(struct std::tm timeinfo, SDR_sparse_t &sparse) {
+  UInt offset = 0u;
+  const auto encodeField = [&](const char *name, const ScalarEncoder &encoder, const Real64 value) {
+    const auto begin = sparse.size();
+    encoder.encodeSparse(value, sparse, offset);
+    offset += encoder.size;
+    if (args_.verbose) {
+      VERBOSE << "  " << name << ": " << value << " ==> bits";
+      for (auto i = begin; i < sparse.size(); i++)
+        std::cerr << " " << sparse[i];
+      std::cerr << std::endl;
+    }
+  };
+
    VERBOSE << "DateEncoder for " 
            <<  std::string(asctime(&timeinfo)).substr(0, 24) 
            << ((timeinfo.tm_isdst)?" dst":"") 
@@ -238,20 +270,14 @@ void DateEncoder::encode(struct std::tm timeinfo, SDR &output) {
   if (seasonEncoder_) {
     // Number the days into the year starting at 0 for Jan 1.
     Real64 dayOfYear = static_cast<Real64>(timeinfo.tm_yday);
-    season_output = SDR(seasonEncoder_->dimensions);
-    seasonEncoder_->encode(dayOfYear, season_output);
+    encodeField("season", *seasonEncoder_, dayOfYear);
     buckets_[bucketMap_[SEASON]] = std::floor(dayOfYear/seasonEncoder_->parameters.radius);
-    VERBOSE << "  season: " << dayOfYear << " ==> " << season_output;
-    sdrs.push_back(&season_output);
   }
   if (dayOfWeekEncoder_) {
     // shift tm_wday so monday is 0.
     Real64 dayOfWeek = static_cast<Real64>((timeinfo.tm_wday + 6) % 7);
-    dayOfWeek_output = SDR(dayOfWeekEncoder_->dimensions);
-    dayOfWeekEncoder_->encode(dayOfWeek, dayOfWeek_output);
+    encodeField("dayOfWeek", *dayOfWeekEncoder_, dayOfWeek);
     buckets_[bucketMap_[DAYOFWEEK]] = dayOfWeek - std::fmod(dayOfWeek, dayOfWeekEncoder_->parameters.radius);
-    VERBOSE << "  dayOfWeek: " << dayOfWeek << " ==> " << dayOfWeek_output;
-    sdrs.push_back(&dayOfWeek_output);
   }
   if (weekendEncoder_) {
     // Weekend is defined as: friday(5) evenng(after 6pm), saturday(6), and sunday(0)
@@ -261,11 +287,8 @@ void DateEncoder::encode(struct std::tm timeinfo, SDR &output) {
     } else {
       val = 0.0;
     }
-    weekend_output = SDR(weekendEncoder_->dimensions);
-    weekendEncoder_->encode(val, weekend_output);
+    encodeField("weekend", *weekendEncoder_, val);
     buckets_[bucketMap_[WEEKEND]] = val;
-    VERBOSE << "  weekend: " << val << " ==> " << weekend_output;
-    sdrs.push_back(&weekend_output);
   }
 
   if (customDaysEncoder_) {
@@ -273,11 +296,8 @@ void DateEncoder::encode(struct std::tm timeinfo, SDR &output) {
     if (customDays_.find(timeinfo.tm_wday) != customDays_.end()) {
         customDay = 1.0;
     }
-    customDay_output = SDR(customDaysEncoder_->dimensions);
-    customDaysEncoder_->encode(customDay, customDay_output);
+    encodeField("custom Day", *customDaysEncoder_, customDay);
     buckets_[bucketMap_[CUSTOM]] = customDay;
-    VERBOSE << "  custom Day: " << customDay << " ==> " << customDay_output;
-    sdrs.push_back(&customDay_output);
   }
 
   if (holidayEncoder_) {
@@ -317,25 +337,14 @@ void DateEncoder::encode(struct std::tm timeinfo, SDR &output) {
         }
       }
     }
-    holiday_output = SDR(holidayEncoder_->dimensions);
-    holidayEncoder_->encode(val, holiday_output);
+    encodeField("holiday", *holidayEncoder_, val);
     buckets_[bucketMap_[HOLIDAY]] = std::floor(val);
-    VERBOSE << "  holiday: " << val << " ==> " << holiday_output;
-    sdrs.push_back(&holiday_output);
   }
   if (timeOfDayEncoder_) {
     Real64 timeOfDay = timeinfo.tm_hour + timeinfo.tm_min / 60.0f + timeinfo.tm_sec / (60.0 * 60.0);
-    timeOfDay_output = SDR(timeOfDayEncoder_->dimensions);
-    timeOfDayEncoder_->encode(timeOfDay, timeOfDay_output);
+    encodeField("timeOfDay", *timeOfDayEncoder_, timeOfDay);
     buckets_[bucketMap_[TIMEOFDAY]] = timeOfDay - std::fmod(timeOfDay, timeOfDayEncoder_->parameters.radius);
-    VERBOSE << "  timeOfDay: " << timeOfDay << "hrs ==> " << timeOfDay_output;
-    sdrs.push_back(&timeOfDay_output);
   }
-  if (sdrs.size() > 1)
-    output.concatenate(sdrs);
-  else
-    output = *sdrs[0];
-  VERBOSE << "  Result: ==> " << output << std::endl;
 }
 
 
@@ -162,6 +162,8 @@ public:
    * Inputs of time_point or struc tm are converted to time_t.
    *
    * Output is an array of 0's and 1's in an SDR container.
+   *
+   * See also BaseEncoder::encodeBatch, which encodes many unix times at once.
    */
   void encode(std::time_t input, SDR &output) override;                  // unix EPOCH time
   void encode(std::chrono::system_clock::time_point, SDR &output);  // python datetime
@@ -217,7 +219,12 @@ public:
   // a convenience method to generate unix EPOCH time values.
   static time_t mktime(int year, int mon, int day, int hr=0, int min=0, int sec=0);
 
+protected:
+  void encodeBatch_(const std::time_t *inputs, const size_t numInputs, SDRBatch &output) override;
+
 private:
+  void encodeSparse_(struct std::tm input, SDR_sparse_t &sparse);
+
   DateEncoderParameters args_;
 
   // fields populated by initialize()
@@ -22,7 +22,7 @@
 #include <htm/encoders/RandomDistributedScalarEncoder.hpp>
 #include <murmurhash3/MurmurHash3.hpp>
 #include <htm/utils/Random.hpp>
-#include <algorithm> // fill
+#include <algorithm> // copy
 
 using namespace std;
 using namespace htm;
@@ -88,25 +88,70 @@ void RandomDistributedScalarEncoder::initialize( const RDSE_Parameters &paramete
   }
 
   NTA_CHECK(check_parameters()) << "Failed hash collision resistance check, please increase size, sparsity, and or activeBits.";
+
+  // The cached encodings are of the previous parameters.
+  setCacheSize( cacheSize_ );
 }
 
 void RandomDistributedScalarEncoder::encode(Real64 input, SDR &output)
 {
-  // Check inputs
   NTA_CHECK( output.size == size );
-  if( isnan(input) ) {
+  UInt index;
+  if( not bucketIndex_( input, index ) ) {
     output.zero();
     return;
   }
+  SDRBatch::Row cached( nullptr, nullptr );
+  if( cacheLookup_( index, cached ) ) {
+    output.setSparse( cached.data(), static_cast<UInt>(cached.size()) );
+    return;
+  }
+  hashBits_( index, bits_ );
+  output.setBits( bits_ );
+  cacheStore_( index, output );
+}
+
+void RandomDistributedScalarEncoder::encodeBatch_(const Real64 *inputs, const size_t numInputs,
+                                                  SDRBatch &output)
+{
+  output.initialize( dimensions );
+  output.reserve( numInputs, numInputs * args_.activeBits );
+  SDR encoding( dimensions );
+  for( size_t i = 0; i < numInputs; i++ ) {
+    UInt index;
+    SDRBatch::Row cached( nullptr, nullptr );
+    if( not bucketIndex_( inputs[i], index ) ) {
+      output.push_back( cached );
+    }
+    else if( cacheLookup_( index, cached ) ) {
+      output.push_back( cached );
+    }
+    else {
+      hashBits_( index, bits_ );
+      encoding.setBits( bits_ );
+      output.push_back( encoding );
+      cacheStore_( index, encoding );
+    }
+  }
+}
+
+bool RandomDistributedScalarEncoder::bucketIndex_(const Real64 input, UInt &index) const
+{
+  // Check inputs
+  if( isnan(input) ) {
+    return false;
+  }
   else if( args_.category ) {
     NTA_CHECK( input == Real64(UInt64(input)))
       << "Input to category encoder must be an unsigned integer!";
   }
+  index = (UInt) (input / args_.resolution);
+  return true;
+}
 
-  auto &data = output.getDense();
-  fill( data.begin(), data.end(), 0u );
-
-  const UInt index = (UInt) (input / args_.resolution);
+void RandomDistributedScalarEncoder::hashBits_(const UInt index, SDR_bits_t &bits) const
+{
+  bits.assign( (size + 63u) / 64u, 0u );
   for(auto offset = 0u; offset < args_.activeBits; ++offset)
   {
     UInt hash_buffer = index + offset;
@@ -120,9 +165,50 @@ void RandomDistributedScalarEncoder::encode(Real64 input, SDR &output)
     // deviations in the sparsity or semantic similarity, depending on how
     // they're handled.
 
-    data[bucket] = 1u;
+    bits[bucket / 64u] |= UInt64(1u) << (bucket % 64u);
+  }
+}
+
+void RandomDistributedScalarEncoder::setCacheSize(const size_t numBytes)
+{
+  cacheSize_ = numBytes;
+  const size_t slotBytes = sizeof(UInt64) + sizeof(UInt) + args_.activeBits * sizeof(ElemSparse);
+  const size_t numSlots  = args_.activeBits == 0u ? 0u : numBytes / slotBytes;
+  cacheKeys_.assign( numSlots, emptySlot_ );
+  cacheSizes_.assign( numSlots, 0u );
+  cacheBits_.assign( numSlots * args_.activeBits, 0u );
+  cacheKeys_.shrink_to_fit();
+  cacheSizes_.shrink_to_fit();
+  cacheBits_.shrink_to_fit();
+  resetCacheCounters();
+}
+
+bool RandomDistributedScalarEncoder::cacheLookup_(const UInt index, SDRBatch::Row &encoding)
+{
+  if( cacheKeys_.empty() ) {
+    return false;
+  }
+  const size_t slot = index % cacheKeys_.size();
+  if( cacheKeys_[slot] != index ) {
+    cacheMisses_++;
+    return false;
+  }
+  cacheHits_++;
+  const ElemSparse *bits = cacheBits_.data() + slot * args_.activeBits;
+  encoding = SDRBatch::Row( bits, bits + cacheSizes_[slot] );
+  return true;
+}
+
+void RandomDistributedScalarEncoder::cacheStore_(const UInt index, const SDR &encoding)
+{
+  if( cacheKeys_.empty() ) {
+    return;
   }
-  output.setDense( data );
+  const size_t slot = index % cacheKeys_.size();
+  const auto &sparse = encoding.getSparse();
+  cacheKeys_[slot]  = index;
+  cacheSizes_[slot] = static_cast<UInt>(sparse.size());
+  std::copy( sparse.begin(), sparse.end(), cacheBits_.begin() + slot * args_.activeBits );
 }
 
 bool RandomDistributedScalarEncoder::check_parameters() {
@@ -120,6 +120,31 @@ public:
 
   void encode(Real64 input, SDR &output) override;
 
+  /**
+   * Cache of the encodings, for inputs which repeat.  All of the inputs in a
+   * bucket of the resolution have the same encoding, so the cache maps from
+   * the bucket index to its sorted active bits and the hashing is skipped.
+   *
+   * The cache is direct mapped: bucket i is stored in slot i modulo the number
+   * of slots, replacing any other bucket in that slot.  So nearby buckets do
+   * not evict each other.
+   *
+   * This is a run-time setting, it is not serialized and it does not change
+   * the encodings.  Changing it empties the cache and resets the counters.
+   *
+   * @param numBytes  Memory limit of the cache, 0 (default) disables it.
+   */
+  void setCacheSize(size_t numBytes);
+  size_t getCacheSize() const { return cacheSize_; }
+
+  /**
+   * Counters of the encodings which were found in the cache, and which were
+   * not and so were hashed.  Inputs which are NaN are not counted.
+   */
+  size_t getCacheHits() const   { return cacheHits_; }
+  size_t getCacheMisses() const { return cacheMisses_; }
+  void resetCacheCounters()     { cacheHits_ = 0u; cacheMisses_ = 0u; }
+
 
   ~RandomDistributedScalarEncoder() override {};
 
@@ -153,10 +178,43 @@ public:
     ar(cereal::make_nvp("category", args_.category));
     ar(cereal::make_nvp("seed", args_.seed));
     BaseEncoder<Real64>::initialize({ parameters.size });
+    setCacheSize( cacheSize_ );
   }
+protected:
+  void encodeBatch_(const Real64 *inputs, const size_t numInputs, SDRBatch &output) override;
+
 private:
   RDSE_Parameters args_;
 
+  /**
+   * Finds the bucket of the input, or returns false if the input is NaN.
+   */
+  bool bucketIndex_(Real64 input, UInt &index) const;
+
+  /**
+   * Sets the active bits of the bucket in the packed bits format, see SDR.
+   * Unlike the dense format, this needs only one bit of memory per bit of
+   * the output, and it merges & sorts the hashed bits.
+   */
+  void hashBits_(UInt index, SDR_bits_t &bits) const;
+
+  // Reused buffer of encode, it is swapped with the output's bits.
+  SDR_bits_t bits_;
+
+  // The bucket cache, see setCacheSize.  Slot s holds the encoding of bucket
+  // cacheKeys_[s]: its cacheSizes_[s] active bits start at
+  // cacheBits_[s * activeBits].
+  bool cacheLookup_(UInt index, SDRBatch::Row &encoding);
+  void cacheStore_(UInt index, const SDR &encoding);
+
+  static constexpr UInt64 emptySlot_ = ~UInt64(0u);
+  size_t cacheSize_   = 0u;
+  size_t cacheHits_   = 0u;
+  size_t cacheMisses_ = 0u;
+  std::vector<UInt64> cacheKeys_;
+  std::vector<UInt>   cacheSizes_;
+  SDR_sparse_t        cacheBits_;
+
   /**
    * Check that this RDSE is resistant to hash collisions and will consistently
    * produce good outputs.
@@ -20,7 +20,7 @@
  * Implementation of the ScalarEncoder
  */
 
-#include <algorithm> // std::min std::sort
+#include <algorithm> // std::min std::max
 #include <numeric>   // std::iota
 #include <cmath>     // std::isnan std::nextafter
 #include <htm/encoders/ScalarEncoder.hpp>
@@ -139,10 +139,29 @@ void ScalarEncoder::initialize(const ScalarEncoderParameters &parameters)
 
 void ScalarEncoder::encode(Real64 input, SDR &output)
 {
-  // Check inputs
   NTA_CHECK( output.size == size );
+  auto &sparse = output.getSparse();
+  sparse.clear();
+  encodeSparse( input, sparse );
+  output.setSparse( sparse );
+}
+
+void ScalarEncoder::encodeBatch_(const Real64 *inputs, const size_t numInputs, SDRBatch &output)
+{
+  output.initialize( dimensions );
+  output.reserve( numInputs, numInputs * parameters.activeBits );
+  SDR_sparse_t sparse;
+  for( size_t i = 0; i < numInputs; i++ ) {
+    sparse.clear();
+    encodeSparse( inputs[i], sparse );
+    output.push_back( sparse );
+  }
+}
+
+void ScalarEncoder::encodeSparse(Real64 input, SDR_sparse_t &sparse, const UInt offset) const
+{
+  // Check inputs
   if( std::isnan(input) ) {
-    output.zero();
     return;
   }
   else if( args_.clipInput ) {
@@ -171,23 +190,21 @@ void ScalarEncoder::encode(Real64 input, SDR &output)
   // this by pushing the endpoint (and everything which rounds to it) onto the
   // last bit in the SDR.
   if( not parameters.periodic ) {
-    start = std::min(start, output.size - parameters.activeBits);
+    start = std::min(start, size - parameters.activeBits);
   }
-
-  auto &sparse = output.getSparse();
-  sparse.resize( parameters.activeBits );
-  std::iota( sparse.begin(), sparse.end(), start );
-
-  if( parameters.periodic ) {
-    for( auto & bit : sparse ) {
-      if( bit >= output.size ) {
-        bit -= output.size;
-      }
-    }
-    std::sort( sparse.begin(),  sparse.end() );
+  else if( start >= size ) {
+    start -= size;
   }
 
-  output.setSparse( sparse );
+  // Periodic encodings which run past the end of the SDR wrap around to its
+  // start: those bits come first in sorted order.
+  const UInt end        = start + parameters.activeBits;
+  const UInt numWrapped = end > size ? end - size : 0u;
+  const auto begin      = sparse.size();
+  sparse.resize( begin + parameters.activeBits );
+  ElemSparse *bits = sparse.data() + begin;
+  std::iota( bits, bits + numWrapped, offset );
+  std::iota( bits + numWrapped, bits + parameters.activeBits, start + offset );
 }
 
 std::ostream & operator<<(std::ostream & out, const ScalarEncoder &self)
@@ -130,6 +130,12 @@ namespace htm {
 
     void encode(Real64 input, SDR &output) override;
 
+    /**
+     * Appends the active bits of the input to a sparse vector, each plus the
+     * offset.  The appended bits are sorted.  This is encode without an SDR,
+     * for encoders which concatenate several encodings, see DateEncoder.
+     */
+    void encodeSparse(Real64 input, SDR_sparse_t &sparse, UInt offset = 0u) const;
 
     CerealAdapter;  // see Serializable.hpp
     // FOR Cereal Serialization
@@ -170,6 +176,9 @@ namespace htm {
 
     ~ScalarEncoder() override {};
 
+  protected:
+    void encodeBatch_(const Real64 *inputs, const size_t numInputs, SDRBatch &output) override;
+
   private:
     ScalarEncoderParameters args_;
   };   // end class ScalarEncoder
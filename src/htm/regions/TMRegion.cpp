@@ -238,16 +238,17 @@ void TMRegion::compute() {
     //     to output the NTA_DEBUG statements below
     
     // The dimensions should already be set on output buffers.
-    std::vector<UInt> out_dims = out->getDimensions().asVector(); // column dimensions (eg 10x100), makes copy.
-    if (args_.orColumnOutputs)                    // if we are outputing only columns, we expect one more dimension in active cells.
+    if (args_.orColumnOutputs) { // output as columns
+      std::vector<UInt> out_dims = out->getDimensions().asVector(); // column dimensions (eg 10x100), makes copy.
       out_dims.push_back(args_.cellsPerColumn);   // add n+1-th dimension for cellsPerColumn (eg. 10x100x8)
-    SDR active(out_dims);                         // create an SDR with the dimensions of active cells.
-
-    tm_->getActiveCells(active); //active cells
-    if (args_.orColumnOutputs) // output as columns
-      out->getData().getSDR() = tm_->cellsToColumns(active);
-    else
-      out->getData().getSDR() = active;
+      if (activeCells_.dimensions != out_dims)    // reuse the SDR of active cells between steps.
+        activeCells_.initialize(out_dims);
+      tm_->getActiveCells(activeCells_); //active cells
+      tm_->cellsToColumns(activeCells_, out->getData().getSDR());
+    }
+    else {
+      tm_->getActiveCells(out->getData().getSDR()); //active cells
+    }
     NTA_DEBUG << "compute " << *out << std::endl;
   
   out = getOutput("activeCells");
@@ -267,7 +268,7 @@ void TMRegion::compute() {
   out = getOutput("predictiveCells");
     SDR predictive = tm_->getPredictiveCells();
     if (args_.orColumnOutputs)  // output as columns
-      out->getData().getSDR() = tm_->cellsToColumns(predictive);
+      tm_->cellsToColumns(predictive, out->getData().getSDR());
     else
       out->getData().getSDR() = predictive;
     NTA_DEBUG << "compute " << *out << std::endl;
@@ -188,6 +188,10 @@ private:
 
   computeCallbackFunc computeCallback_;
   std::unique_ptr<TemporalMemory> tm_;
+
+  // Active cells for the "bottomUpOut" output with orColumnOutputs.  Only a
+  // buffer which is reused between calls to compute, not serialized.
+  SDR activeCells_;
 };
 
 } // namespace htm
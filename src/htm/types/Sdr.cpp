@@ -25,15 +25,130 @@
 
 #include <numeric>
 #include <algorithm> // std::sort, std::accumulate
+#include <cstring>   // std::memcpy
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+// AVX2 kernel for converting dense to sparse, selected at run time, see getSparse.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define NTA_SDR_AVX2
+  #include <immintrin.h>
+#endif
 
 using namespace std;
 
 namespace htm {
 
+namespace {
+    const UInt wordBits = 64u;
+
+    inline size_t numWords(const UInt size)
+        { return (size + wordBits - 1u) / wordBits; }
+
+    inline UInt popCount(const UInt64 word) {
+    #if defined(__GNUC__) || defined(__clang__)
+        return static_cast<UInt>( __builtin_popcountll( word ) );
+    #elif defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<UInt>( __popcnt64( word ) );
+    #else
+        UInt64 x = word - ((word >> 1) & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return static_cast<UInt>( (x * 0x0101010101010101ull) >> 56 );
+    #endif
+    }
+
+    // Index of the lowest set bit, the word must not be zero.
+    inline UInt countTrailingZeros(const UInt64 word) {
+    #if defined(__GNUC__) || defined(__clang__)
+        return static_cast<UInt>( __builtin_ctzll( word ) );
+    #elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64( &index, word );
+        return static_cast<UInt>( index );
+    #else
+        return popCount( (word & (~word + 1u)) - 1u );
+    #endif
+    }
+
+    // Number of elements which both sorted lists contain.
+    UInt sparseOverlap(const SDR_sparse_t &a, const SDR_sparse_t &b) {
+        UInt ovlp = 0u;
+        auto i = a.cbegin();
+        auto j = b.cbegin();
+        while( i != a.cend() and j != b.cend() ) {
+            const auto x = *i;
+            const auto y = *j;
+            ovlp += x == y;
+            i    += x <= y;
+            j    += y <= x;
+        }
+        return ovlp;
+    }
+
+    /*
+     * Kernels for converting dense to sparse: append the index of every
+     * non-zero byte of dense[0, size) to sparse.  The scalar kernel skips 8
+     * zero bytes at a time.  The AVX2 kernel compares 32 bytes at a time and
+     * walks the mask of the non-zero bytes, it is picked at run time when the
+     * CPU supports it.  Both kernels give exactly the same results.
+     */
+    using DenseToSparseKernel = void (*)(const ElemDense *dense, UInt size, SDR_sparse_t &sparse);
+
+    void denseToSparseScalar(const ElemDense *dense, const UInt size, SDR_sparse_t &sparse) {
+        UInt idx = 0u;
+        for( ; idx + 8u <= size; idx += 8u ) {
+            UInt64 word;
+            std::memcpy( &word, dense + idx, sizeof(word) );
+            if( word == 0u )
+                continue;
+            for( UInt i = idx; i < idx + 8u; i++ )
+                if( dense[i] != 0 )
+                    sparse.push_back( static_cast<ElemSparse>(i) );
+        }
+        for( ; idx < size; idx++ )
+            if( dense[idx] != 0 )
+                sparse.push_back( static_cast<ElemSparse>(idx) );
+    }
+
+#if defined(NTA_SDR_AVX2)
+    __attribute__((target("avx2")))
+    void denseToSparseAVX2(const ElemDense *dense, const UInt size, SDR_sparse_t &sparse) {
+        static_assert(sizeof(ElemDense) == 1u, "denseToSparseAVX2 needs byte dense data.");
+        const __m256i zero = _mm256_setzero_si256();
+        UInt idx = 0u;
+        for( ; idx + 32u <= size; idx += 32u ) {
+            const __m256i bytes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(dense + idx) );
+            UInt32 mask = ~static_cast<UInt32>(
+                _mm256_movemask_epi8( _mm256_cmpeq_epi8( bytes, zero )));
+            while( mask != 0u ) {
+                sparse.push_back( static_cast<ElemSparse>(idx + __builtin_ctz( mask )) );
+                mask &= mask - 1u; // Clear the lowest set bit.
+            }
+        }
+        for( ; idx < size; idx++ )
+            if( dense[idx] != 0 )
+                sparse.push_back( static_cast<ElemSparse>(idx) );
+    }
+#endif
+
+    DenseToSparseKernel selectDenseToSparseKernel() {
+#if defined(NTA_SDR_AVX2)
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx2") ) {
+            return denseToSparseAVX2;
+        }
+#endif
+        return denseToSparseScalar;
+    }
+} // end anonymous namespace
+
     void SparseDistributedRepresentation::clear() const {
         dense_valid       = false;
         sparse_valid      = false;
         coordinates_valid = false;
+        bits_valid        = false;
     }
 
     void SparseDistributedRepresentation::do_callbacks() const {
@@ -97,6 +212,17 @@ namespace htm {
         do_callbacks();
     }
 
+    void SparseDistributedRepresentation::setBitsInplace() const {
+        // Check data is valid.
+        NTA_ASSERT( bits_.size() == numWords( size ) );
+        NTA_ASSERT( size % wordBits == 0u or (bits_.back() >> (size % wordBits)) == 0u )
+            << "Bits after the end of the SDR must be zero!";
+        // Set the valid flags.
+        clear();
+        bits_valid = true;
+        do_callbacks();
+    }
+
     void SparseDistributedRepresentation::deconstruct() {
         clear();
         size_ = 0;
@@ -134,6 +260,8 @@ namespace htm {
         // Initialize the index tuple.
         coordinates_.assign( dimensions.size(), {} );
         coordinates_valid = true;
+        // Initialize the packed bits, when they're needed.
+        bits_valid = false;
     }
 
     SparseDistributedRepresentation::SparseDistributedRepresentation(
@@ -141,14 +269,19 @@ namespace htm {
         : SparseDistributedRepresentation( value.dimensions )
         { setSDR( value ); }
 
+    SparseDistributedRepresentation::SparseDistributedRepresentation(
+                                SparseDistributedRepresentation &&value )
+        : SparseDistributedRepresentation( value.dimensions )
+        { swap( value ); }
+
     SparseDistributedRepresentation::~SparseDistributedRepresentation()
         { deconstruct(); }
 
 
     void SparseDistributedRepresentation::reshape(const vector<UInt> &dimensions) const {
         // Make sure we have the data in a format which does not care about the
-        // dimensions, IE: dense or sparse but not coordinates
-        if( not dense_valid and not sparse_valid )
+        // dimensions, IE: dense, sparse or bits but not coordinates
+        if( not dense_valid and not sparse_valid and not bits_valid )
             getSparse();
         coordinates_valid = false;
         coordinates_.assign( dimensions.size(), {} );
@@ -219,12 +352,21 @@ namespace htm {
                     sparse_.push_back(flat);
                 }
             }
+            else if( bits_valid ) {
+                // Convert from bits to flatSparse, one word at a time.
+                for(size_t w = 0u; w < bits_.size(); w++) {
+                    UInt64 word = bits_[w];
+                    while( word != 0u ) {
+                        sparse_.push_back( static_cast<ElemSparse>(
+                            w * wordBits + countTrailingZeros( word )) );
+                        word &= word - 1u; // Clear the lowest set bit.
+                    }
+                }
+            }
             else if( dense_valid ) {
                 // Convert from dense to flatSparse.
-                const auto &dense = getDense();
-                for(UInt idx = 0; idx < size; idx++)
-                    if( dense[idx] != 0 )
-                        sparse_.push_back( idx );
+                static const DenseToSparseKernel kernel = selectDenseToSparseKernel();
+                kernel( getDense().data(), size, sparse_ );
             }
             else
                 NTA_THROW << "SDR has no data!";
@@ -242,11 +384,13 @@ namespace htm {
     SDR_coordinate_t& SparseDistributedRepresentation::getCoordinates() const {
       if( !coordinates_valid ) {
         // Clear out any old data.
+        const auto &sparse = getSparse();
         for( auto& vec : coordinates_ ) {
           vec.clear();
+          vec.reserve( sparse.size() );
         }
         // Convert from sparse to coordinates.
-        for( auto idx : getSparse() ) {
+        for( auto idx : sparse ) {
           for(UInt dim = (UInt)(dimensions.size() - 1); dim > 0; --dim) {
             const auto dim_sz = dimensions[dim];
             coordinates_[dim].push_back( idx % dim_sz );
@@ -260,6 +404,24 @@ namespace htm {
     }
 
 
+    void SparseDistributedRepresentation::setBits( SDR_bits_t &value ) {
+        bits_.swap( value );
+        setBitsInplace();
+    }
+
+    SDR_bits_t& SparseDistributedRepresentation::getBits() const {
+        if( !bits_valid ) {
+            // Convert from flatSparse to bits.
+            bits_.assign( numWords( size ), 0u );
+            for(const auto idx : getSparse()) {
+                bits_[idx / wordBits] |= UInt64(1u) << (idx % wordBits);
+            }
+            bits_valid = true;
+        }
+        return bits_;
+    }
+
+
     void SparseDistributedRepresentation::setSDR( const SparseDistributedRepresentation &value ) {
         reshape( value.dimensions );
         // Cast the data to CONST, which forces the SDR to copy the vector
@@ -278,16 +440,64 @@ namespace htm {
         return *this;
     }
 
+    SparseDistributedRepresentation& SparseDistributedRepresentation::operator=(SparseDistributedRepresentation&& value) {
+        if( dimensions.empty() ) {
+            initialize( value.dimensions );
+        }
+        reshape( value.dimensions );
+        swap( value );
+        return *this;
+    }
+
+
+    void SparseDistributedRepresentation::swap( SparseDistributedRepresentation &other ) {
+        NTA_CHECK( dimensions == other.dimensions )
+            << "SDR::swap needs SDRs with the same dimensions!";
+        dense_.swap( other.dense_ );
+        sparse_.swap( other.sparse_ );
+        coordinates_.swap( other.coordinates_ );
+        bits_.swap( other.bits_ );
+        std::swap( dense_valid,       other.dense_valid );
+        std::swap( sparse_valid,      other.sparse_valid );
+        std::swap( coordinates_valid, other.coordinates_valid );
+        std::swap( bits_valid,        other.bits_valid );
+        do_callbacks();
+        other.do_callbacks();
+    }
+
 
     UInt SparseDistributedRepresentation::getOverlap(const SparseDistributedRepresentation &sdr) const {
         NTA_ASSERT( dimensions == sdr.dimensions );
 
         UInt ovlp = 0u;
-        const auto a = this->getDense();
-        const auto b = sdr.getDense();
-        for( UInt i = 0u; i < size; i++ )
-            ovlp += a[i] && b[i];
-        return ovlp;
+        if( bits_valid and sdr.bits_valid ) {
+            for(size_t w = 0u; w < bits_.size(); w++)
+                ovlp += popCount( bits_[w] & sdr.bits_[w] );
+            return ovlp;
+        }
+        if( sparse_valid and sdr.sparse_valid ) {
+            return sparseOverlap( sparse_, sdr.sparse_ );
+        }
+        if( dense_valid and sdr.dense_valid ) {
+            for( UInt i = 0u; i < size; i++ )
+                ovlp += dense_[i] && sdr.dense_[i];
+            return ovlp;
+        }
+        // Look up the true bits of one SDR in the other, or else convert both
+        // of them to sparse.
+        const SDR &sparse = sparse_valid ? *this : sdr;
+        const SDR &other  = sparse_valid ? sdr : *this;
+        if( sparse.sparse_valid and other.bits_valid ) {
+            for( const auto idx : sparse.sparse_ )
+                ovlp += static_cast<UInt>( (other.bits_[idx / wordBits] >> (idx % wordBits)) & 1u );
+            return ovlp;
+        }
+        if( sparse.sparse_valid and other.dense_valid ) {
+            for( const auto idx : sparse.sparse_ )
+                ovlp += other.dense_[idx] != 0;
+            return ovlp;
+        }
+        return sparseOverlap( getSparse(), sdr.getSparse() );
     }
 
 
@@ -374,22 +584,22 @@ namespace htm {
             }
         }
         if( inplace ) {
-            getDense(); // Make sure that the dense data is valid.
+            getBits(); // Make sure that the bits are valid.
         }
         if( not inplace ) {
             // Copy one of the SDRs over to the output SDR.
-            const auto &denseIn = inputs.back()->getDense();
-            dense_.assign( denseIn.begin(), denseIn.end() );
+            const auto &bitsIn = inputs.back()->getBits();
+            bits_.assign( bitsIn.begin(), bitsIn.end() );
             inputs.pop_back();
             // inplace = true; // Now it's an inplace operation.
         }
         for(const auto &sdr_ptr : inputs) {
-            const auto &data = sdr_ptr->getDense();
-            for(auto z = 0u; z < data.size(); ++z) {
-                dense_[z] = dense_[z] && data[z];
+            const auto &data = sdr_ptr->getBits();
+            for(size_t w = 0u; w < data.size(); ++w) {
+                bits_[w] &= data[w];
             }
         }
-        SDR::setDenseInplace();
+        SDR::setBitsInplace();
     }
 
 
@@ -412,22 +622,22 @@ namespace htm {
             }
         }
         if( inplace ) {
-            getDense(); // Make sure that the dense data is valid.
+            getBits(); // Make sure that the bits are valid.
         }
         if( not inplace ) {
             // Copy one of the SDRs over to the output SDR.
-            const auto &denseIn = inputs.back()->getDense();
-            dense_.assign( denseIn.begin(), denseIn.end() );
+            const auto &bitsIn = inputs.back()->getBits();
+            bits_.assign( bitsIn.begin(), bitsIn.end() );
             inputs.pop_back();
             // inplace = true; // Now it's an inplace operation.
         }
         for(const auto &sdr_ptr : inputs) {
-            const auto &data = sdr_ptr->getDense();
-            for(auto z = 0u; z < data.size(); ++z) {
-                dense_[z] = dense_[z] || data[z];
+            const auto &data = sdr_ptr->getBits();
+            for(size_t w = 0u; w < data.size(); ++w) {
+                bits_[w] |= data[w];
             }
         }
-        SDR::setDenseInplace();
+        SDR::setBitsInplace();
     }
 
 
@@ -456,34 +666,39 @@ namespace htm {
             << "Axis of concatenation dimensions do not match, inputs sum to "
             << concat_axis_size << ", output expects " << dimensions[axis] << "!";
 
-        // Setup for copying the data as rows & strides.
-        vector<ElemDense*> buffers;
-        vector<UInt>       row_lengths;
+        // Setup for copying the true bits as rows & strides.
+        vector<const ElemSparse*> next;
+        vector<const ElemSparse*> ends;
+        vector<UInt>              row_lengths;
+        UInt out_row = 0u;
         for( const auto &sdr : inputs ) {
-            buffers.push_back( sdr->getDense().data() );
+            const auto &sparse = sdr->getSparse();
+            next.push_back( sparse.data() );
+            ends.push_back( sparse.data() + sparse.size() );
             UInt row = 1u;
             for(UInt d = axis; d < dimensions.size(); ++d)
                 row *= sdr->dimensions[d];
             row_lengths.push_back( row );
+            out_row += row;
         }
 
-        // Get the output buffer.
-        dense_.resize( size );
-              auto dense_data  = dense_.data();
-        const auto data_end    = dense_data + size;
-        const auto n_inputs    = inputs.size();
-        while( dense_data < data_end ) {
-            // Copy one row from each input SDR.
+        // Copy the true bits of one row from each input SDR at a time, this
+        // keeps the output sorted.
+        sparse_.clear();
+        const auto n_rows   = size / out_row;
+        const auto n_inputs = inputs.size();
+        for( UInt r = 0u; r < n_rows; ++r ) {
+            UInt offset = r * out_row;
             for( UInt i = 0u; i < n_inputs; ++i ) {
-                const auto &buf = buffers[i];
-                const auto &row = row_lengths[i];
-                std::copy( buf, buf + row, dense_data );
-                // Increment the pointers.
-                buffers[i] += row;
-                dense_data += row;
+                const auto &row      = row_lengths[i];
+                const UInt row_begin = r * row;
+                for( ; next[i] != ends[i] and *next[i] < row_begin + row; ++next[i] ) {
+                    sparse_.push_back( offset + *next[i] - row_begin );
+                }
+                offset += row;
             }
         }
-        SDR::setDenseInplace();
+        SDR::setSparseInplace();
     }
 
     bool SparseDistributedRepresentation::operator==(const SparseDistributedRepresentation &sdr) const {
@@ -494,11 +709,10 @@ namespace htm {
             if( dimensions[i] != sdr.dimensions[i] )
                 return false;
         }
-        // Check data
-        return std::equal(
-            getDense().begin(),
-            getDense().end(), 
-            sdr.getDense().begin());
+        // Check data, as bits if both have them.
+        if( bits_valid and sdr.bits_valid )
+            return bits_ == sdr.bits_;
+        return getSparse() == sdr.getSparse();
     }
 
 
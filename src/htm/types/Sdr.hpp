@@ -39,6 +39,7 @@ using ElemSparse       = UInt32; //must match with connections::CellIdx
 using SDR_dense_t      = std::vector<ElemDense>;
 using SDR_sparse_t     = std::vector<ElemSparse>;
 using SDR_coordinate_t = std::vector<std::vector<UInt>>;
+using SDR_bits_t       = std::vector<UInt64>;
 using SDR_callback_t   = std::function<void()>;
 
 /**
@@ -51,7 +52,7 @@ using SDR_callback_t   = std::function<void()>;
  * represent the state of a group of neurons or their associated processes. 
  *
  * This class automatically converts between the commonly used SDR data formats:
- * which are dense, sparse, and coordinates.  Converted values are cached by
+ * which are dense, sparse, coordinates, and packed bits.  Converted values are cached by
  * this class, so getting a value in one format many times incurs no extra
  * performance cost.  Assigning to the SDR via a setter method will clear these
  * cached values and cause them to be recomputed as needed.
@@ -71,6 +72,12 @@ using SDR_callback_t   = std::function<void()>;
  *    useful because it contains the location of each true bit inside of the
  *    SDR's dimensional space.
  *
+ *    Bits Format: A packed bitset of all of the bits in the SDR, 64 bits per
+ *    word.  Bit i is bit (i % 64) of word (i / 64), and the unused bits of
+ *    the last word are zero.  This format is 8 times smaller than the dense
+ *    format, and it allows for counting the overlap and doing the set
+ *    operations a whole word at a time.
+ *
  * Array Memory Layout: This class uses C-order throughout, meaning that when
  * iterating through the SDR, the last/right-most index changes fastest.
  *
@@ -136,6 +143,7 @@ protected:
     mutable SDR_dense_t      dense_;
     mutable SDR_sparse_t     sparse_;
     mutable SDR_coordinate_t coordinates_;
+    mutable SDR_bits_t       bits_;
 
     /**
      * These flags remember which data formats are up-to-date and which formats
@@ -144,6 +152,7 @@ protected:
     mutable bool dense_valid;
     mutable bool sparse_valid;
     mutable bool coordinates_valid;
+    mutable bool bits_valid;
 
 private:
     /**
@@ -193,6 +202,13 @@ protected:
      */
     virtual void setCoordinatesInplace() const;
 
+    /**
+     * Update the SDR to reflect the value currently inside of the bits
+     * vector.  Use this method after modifying the bits vector inplace, in
+     * order to propagate any changes to the other formats.
+     */
+    virtual void setBitsInplace() const;
+
     /**
      * Destroy this SDR.  Makes SDR unusable, should error or clearly fail if
      * used.  Also sends notification to all watchers via destroyCallbacks.
@@ -226,6 +242,14 @@ public:
      */
     SparseDistributedRepresentation( const SparseDistributedRepresentation &value );
 
+    /**
+     * Initialize this SDR with the value of the given SDR, without copying
+     * any data.  The given SDR is left with a value of all zeros.
+     *
+     * @param value An SDR to take the value of.
+     */
+    SparseDistributedRepresentation( SparseDistributedRepresentation &&value );
+
     virtual ~SparseDistributedRepresentation();
 
     /**
@@ -406,6 +430,27 @@ public:
      */
     virtual SDR_coordinate_t& getCoordinates() const;
 
+    /**
+     * Swap a packed bitset into the SDR, replacing the current value.  This
+     * method is fast since it copies no data.  This method modifies its
+     * argument!
+     *
+     * @param value A vector<UInt64> of (size + 63) / 64 words, see the Bits
+     * Format above.
+     * @throws The bits after the end of the SDR must be zero.
+     */
+    void setBits( SDR_bits_t &value );
+
+    /**
+     * Gets the current value of the SDR as a packed bitset.  The result of
+     * this method call is saved inside of this SDR until the SDRs value
+     * changes.  After modifying the bits you MUST call sdr.setBits() in order
+     * to notify the SDR that its bits have changed.
+     *
+     * @returns A reference to the words of the bitset, see the Bits Format.
+     */
+    virtual SDR_bits_t& getBits() const;
+
     /**
      * Deep Copy the given SDR to this SDR.  This overwrites the current value of
      * this SDR.  This SDR and the given SDR will have no shared data and they
@@ -417,6 +462,28 @@ public:
 
     SparseDistributedRepresentation& operator=(const SparseDistributedRepresentation& value);
 
+    /**
+     * Take the value of the given SDR, without copying any data.  Like the
+     * copy assignment this reshapes this SDR to the dimensions of the given
+     * SDR, which is left with this SDR's previous value.
+     */
+    SparseDistributedRepresentation& operator=(SparseDistributedRepresentation&& value);
+
+    /**
+     * Exchange the values of two SDRs, without copying any data.  Both SDRs
+     * must have the same dimensions.  The callbacks of both SDRs are called.
+     *
+     * The data vectors of the SDRs keep their capacity across updates, so
+     * swapping values with a scratch SDR avoids allocating memory:
+     *
+     *     SDR scratch( output.dimensions );
+     *     for( ... ) {
+     *         compute( scratch );
+     *         output.swap( scratch );
+     *     }
+     */
+    void swap( SparseDistributedRepresentation &other );
+
     /**
      * Calculates the number of true / non-zero values in the SDR.
      *
@@ -443,6 +510,10 @@ public:
      *
      * @returns Integer, the number of true values which both SDRs have in
      * common.
+     *
+     * This uses the formats which both SDRs already have: it counts the bits
+     * of the packed bitsets, or merges the sparse indices, or looks up the
+     * sparse indices of one SDR in the other.  It does not copy any data.
      */
     UInt getOverlap(const SparseDistributedRepresentation &sdr) const;
 
@@ -497,7 +568,8 @@ public:
      *             contain as many SDRs as needed.
      *
      * @returns In both cases the output is stored in this SDR.  This method
-     * modifies this SDR and discards its current value!
+     * modifies this SDR and discards its current value!  It is computed
+     * using the packed bitsets.
      *
      * Example Usage:
      *     SDR A({ 10 });
@@ -522,7 +594,8 @@ public:
      *             contain as many SDRs as needed.
      *
      * @returns In both cases the output is stored in this SDR.  This method
-     * modifies this SDR and discards its current value!
+     * modifies this SDR and discards its current value!  It is computed
+     * using the packed bitsets.
      *
      * Example Usage:
      *     SDR A({ 10 });
@@ -550,7 +623,8 @@ public:
      * result has the same dimensions as this SDR.  The default axis is 0.
      *
      * @returns In both overloads the output is stored in this SDR.  This method
-     * modifies this SDR and discards its current value!
+     * modifies this SDR and discards its current value!  It only visits the
+     * true bits of the inputs.
      *
      * Example Usage:
      *      SDR A({ 10 });
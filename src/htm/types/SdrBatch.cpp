@@ -0,0 +1,129 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of the SDRBatch class
+ */
+
+#include <algorithm> // is_sorted, adjacent_find, copy_n
+
+#include <htm/types/SdrBatch.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace std;
+
+namespace htm {
+
+    SDRBatch::SDRBatch()
+        : offsets_( 1u, 0u ) {}
+
+    SDRBatch::SDRBatch( const vector<UInt> &dimensions )
+        { initialize( dimensions ); }
+
+    void SDRBatch::initialize( const vector<UInt> &dimensions ) {
+        NTA_CHECK( not dimensions.empty() ) << "SDRBatch has no dimensions!";
+        UInt size = 1u;
+        for( const auto dim : dimensions ) {
+            size *= dim;
+        }
+        NTA_CHECK( size > 0u ) << "SDRBatch: all dimensions must be > 0";
+        dimensions_ = dimensions;
+        sdrSize_    = size;
+        clear();
+    }
+
+    void SDRBatch::clear() {
+        offsets_.assign( 1u, 0u );
+        indices_.clear();
+    }
+
+    void SDRBatch::reserve( const size_t numSDRs, const size_t numActive ) {
+        offsets_.reserve( numSDRs + 1u );
+        indices_.reserve( numActive );
+    }
+
+    void SDRBatch::push_back( const SDR &sdr ) {
+        NTA_CHECK( sdr.size == sdrSize_ )
+            << "SDRBatch of size " << sdrSize_ << " can not hold an SDR of size " << sdr.size;
+        const auto &sparse = sdr.getSparse();
+        indices_.insert( indices_.end(), sparse.begin(), sparse.end() );
+        offsets_.push_back( indices_.size() );
+    }
+
+    void SDRBatch::push_back( const SDR_sparse_t &sparse )
+        { push_back_( sparse.data(), sparse.data() + sparse.size() ); }
+
+    void SDRBatch::push_back( const Row &sparse )
+        { push_back_( sparse.begin(), sparse.end() ); }
+
+    void SDRBatch::push_back_( const ElemSparse *begin, const ElemSparse *end ) {
+        NTA_CHECK( sdrSize_ > 0u ) << "SDRBatch is not initialized!";
+        // Check data is valid, like SDR::setSparseInplace.
+        #ifdef NTA_ASSERTIONS_ON
+            NTA_ASSERT( is_sorted( begin, end ) )
+                << "Sparse data must be sorted!";
+            NTA_ASSERT( adjacent_find( begin, end ) == end )
+                << "Sparse data must not contain duplicates!";
+            if( begin != end ) {
+                NTA_ASSERT( end[-1] < sdrSize_ )
+                    << "Index out of bounds of the SDRBatch!";
+            }
+        #endif
+        // A row of this batch, as in b.push_back( b[i] ), would be invalidated
+        // by the insert when it reallocates.
+        const ElemSparse *data = indices_.data();
+        if( begin != end and begin >= data and begin < data + indices_.size() ) {
+            const SDR_sparse_t row( begin, end );
+            indices_.insert( indices_.end(), row.begin(), row.end() );
+        }
+        else {
+            indices_.insert( indices_.end(), begin, end );
+        }
+        offsets_.push_back( indices_.size() );
+    }
+
+    void SDRBatch::append( const SDRBatch &batch ) {
+        NTA_CHECK( batch.dimensions_ == dimensions_ )
+            << "SDRBatch::append: dimensions do not match!";
+        // The batch may be this one: take its sizes before growing, and copy
+        // by index.
+        const size_t numSDRs   = batch.size();
+        const size_t numActive = batch.indices_.size();
+        const UInt64 base      = indices_.size();
+        indices_.resize( base + numActive );
+        copy_n( batch.indices_.begin(), numActive, indices_.begin() + base );
+        offsets_.reserve( offsets_.size() + numSDRs );
+        for( size_t i = 1u; i <= numSDRs; i++ ) {
+            offsets_.push_back( base + batch.offsets_[i] );
+        }
+    }
+
+    void SDRBatch::getSDR( const size_t i, SDR &out ) const {
+        NTA_CHECK( i < size() ) << "SDRBatch index " << i << " out of range " << size();
+        NTA_CHECK( out.size == sdrSize_ )
+            << "SDRBatch of size " << sdrSize_ << " can not copy into an SDR of size " << out.size;
+        const auto row = (*this)[i];
+        out.setSparse( row.data(), static_cast<UInt>(row.size()) );
+    }
+
+    bool SDRBatch::operator==( const SDRBatch &batch ) const {
+        return dimensions_ == batch.dimensions_ and
+               offsets_    == batch.offsets_    and
+               indices_    == batch.indices_;
+    }
+
+} // end namespace htm
@@ -0,0 +1,213 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the SDRBatch class
+ */
+
+#ifndef SDR_BATCH_HPP
+#define SDR_BATCH_HPP
+
+#include <vector>
+
+#include <htm/types/Sdr.hpp>
+#include <htm/types/Serializable.hpp>
+#include <htm/types/Types.hpp>
+
+namespace htm {
+
+/**
+ * SDRBatch class
+ *
+ * ### Description
+ * A sequence of SDRs which all have the same dimensions, stored together as a
+ * compressed sparse row matrix: the sparse indices of all of the SDRs one
+ * after the other, and the offset of each SDR into them.  Unlike a
+ * std::vector<SDR> there is no object per SDR, no dense buffer and no
+ * callbacks.  Adding an SDR appends to the two vectors, and clear() keeps
+ * their capacity, so a batch can be refilled without allocating.
+ *
+ * The SDRs of the batch are read through views of their sparse indices,
+ * which point into the batch and copy nothing.  A view is valid until the
+ * batch is next modified.  Use getSDR to copy an SDR of the batch into an
+ * SDR object, for the methods which need one.
+ *
+ * Example Usage:
+ *     SDRBatch batch({ 10, 10 });
+ *     batch.push_back( sdr );
+ *     batch.push_back( SDR_sparse_t{ 1, 4, 42 } );
+ *     batch.size()      ->  2
+ *     batch[1].size()   ->  3
+ *     batch[1][2]       ->  42
+ *     SDR out({ 10, 10 });
+ *     batch.getSDR( 1, out );
+ *     out.getSparse()   ->  { 1, 4, 42 }
+ */
+class SDRBatch : public Serializable
+{
+public:
+    /**
+     * Read only view of the sparse indices of one SDR of a batch.
+     */
+    class Row {
+    public:
+        Row(const ElemSparse *begin, const ElemSparse *end)
+            : begin_(begin), end_(end) {}
+
+        const ElemSparse *begin() const { return begin_; }
+        const ElemSparse *end() const   { return end_; }
+        const ElemSparse *data() const  { return begin_; }
+        size_t size() const             { return static_cast<size_t>(end_ - begin_); }
+        bool   empty() const            { return begin_ == end_; }
+        ElemSparse operator[](const size_t i) const { return begin_[i]; }
+
+    private:
+        const ElemSparse *begin_;
+        const ElemSparse *end_;
+    };
+
+    /**
+     * Use this constructor only in conjuction with initialize() or load().
+     */
+    SDRBatch();
+
+    /**
+     * Create an empty batch of SDRs.
+     *
+     * @param dimensions  The dimensions of every SDR in the batch.  The
+     * product of the dimensions must be greater than zero.
+     */
+    explicit SDRBatch( const std::vector<UInt> &dimensions );
+
+    /**
+     * Set the dimensions and remove all of the SDRs from the batch.
+     */
+    void initialize( const std::vector<UInt> &dimensions );
+
+    /**
+     * @returns The dimensions of every SDR in the batch.
+     */
+    const std::vector<UInt> &getDimensions() const { return dimensions_; }
+
+    /**
+     * @returns The number of bits in each SDR of the batch, the product of the
+     * dimensions.
+     */
+    UInt getSDRSize() const { return sdrSize_; }
+
+    /**
+     * @returns The number of SDRs in the batch.
+     */
+    size_t size() const { return offsets_.size() - 1u; }
+    bool   empty() const { return size() == 0u; }
+
+    /**
+     * @returns The total number of true bits of all of the SDRs in the batch.
+     */
+    size_t getSum() const { return indices_.size(); }
+
+    /**
+     * Remove all of the SDRs from the batch, keeping the dimensions and the
+     * allocated memory.
+     */
+    void clear();
+
+    /**
+     * Allocate memory for a number of SDRs with a total number of true bits.
+     */
+    void reserve( size_t numSDRs, size_t numActive );
+
+    /**
+     * Append a copy of an SDR to the batch.
+     *
+     * @param sdr  SDR with the same size as the SDRs of the batch.  Its shape
+     * may differ, the batch keeps its own dimensions.
+     */
+    void push_back( const SDR &sdr );
+
+    /**
+     * Append an SDR given as sparse indices into the flattened SDR space.
+     *
+     * @throws Sparse data must be sorted and contain no duplicates.
+     */
+    void push_back( const SDR_sparse_t &sparse );
+    void push_back( const Row &sparse );
+
+    /**
+     * Append all of the SDRs of another batch with the same dimensions.
+     */
+    void append( const SDRBatch &batch );
+
+    /**
+     * @returns A view of the sparse indices of the i'th SDR of the batch.
+     */
+    Row operator[]( const size_t i ) const {
+        NTA_ASSERT( i < size() ) << "SDRBatch index " << i << " out of range " << size();
+        const ElemSparse *data = indices_.data();
+        return Row( data + offsets_[i], data + offsets_[i + 1u] );
+    }
+
+    /**
+     * Copy the i'th SDR of the batch into an SDR.
+     *
+     * @param out  SDR with the same size as the SDRs of the batch.  Its shape
+     * is not changed.
+     */
+    void getSDR( size_t i, SDR &out ) const;
+
+    /**
+     * Serialization routines.  See Serializable.hpp
+     */
+    CerealAdapter;
+
+    template<class Archive>
+    void save_ar(Archive & ar) const
+    {
+        ar(cereal::make_nvp("dimensions", dimensions_),
+           cereal::make_nvp("offsets",    offsets_),
+           cereal::make_nvp("indices",    indices_));
+    }
+
+    template<class Archive>
+    void load_ar(Archive & ar)
+    {
+        std::vector<UInt64> offsets;
+        SDR_sparse_t indices;
+        ar( dimensions_, offsets, indices );
+        initialize( dimensions_ );
+        offsets_.swap( offsets );
+        indices_.swap( indices );
+    }
+
+    bool operator==( const SDRBatch &batch ) const;
+    bool operator!=( const SDRBatch &batch ) const
+        { return not ((*this) == batch); }
+
+private:
+    void push_back_( const ElemSparse *begin, const ElemSparse *end );
+
+    std::vector<UInt> dimensions_;
+    UInt sdrSize_ = 0u;
+
+    // The sparse indices of the i'th SDR are
+    // indices_[ offsets_[i] ... offsets_[i + 1] ).
+    std::vector<UInt64> offsets_;
+    SDR_sparse_t        indices_;
+};
+
+} // end namespace htm
+#endif // end ifndef SDR_BATCH_HPP
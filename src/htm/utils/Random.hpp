@@ -140,6 +140,14 @@ public:
   }
 
 
+  /**
+   * Advance the generator as if n random numbers had been drawn.
+   */
+  void discard(const UInt64 n) {
+    gen.discard(n);
+    steps_ += n;
+  }
+
   // randomly shuffle the elements
   template <class RandomAccessIterator>
   void shuffle(RandomAccessIterator first, RandomAccessIterator last) {
@@ -0,0 +1,115 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of the ThreadPool class
+ */
+
+#include <algorithm> // max
+
+#include <htm/utils/ThreadPool.hpp>
+
+using namespace std;
+using namespace htm;
+
+
+ThreadPool::ThreadPool(UInt numThreads)
+  : numThreads_( numThreads > 0u ? numThreads
+                                 : std::max<UInt>(1u, std::thread::hardware_concurrency()) )
+{
+  workers_.reserve( numThreads_ - 1u );
+  for(UInt chunk = 1u; chunk < numThreads_; chunk++) {
+    workers_.emplace_back( &ThreadPool::workerLoop_, this, chunk );
+  }
+}
+
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock( mutex_ );
+    stop_ = true;
+  }
+  startWork_.notify_all();
+  for( auto &worker : workers_ ) {
+    worker.join();
+  }
+}
+
+
+void ThreadPool::runChunk_(const UInt chunk) {
+  const size_t begin = chunkBegin( n_, numThreads_, chunk );
+  const size_t end   = chunkBegin( n_, numThreads_, chunk + 1u );
+  if( begin == end ) return;
+  try {
+    (*task_)( begin, end, chunk );
+  }
+  catch(...) {
+    lock_guard<mutex> lock( mutex_ );
+    if( not error_ ) error_ = current_exception();
+  }
+}
+
+
+void ThreadPool::workerLoop_(const UInt chunk) {
+  UInt64 seen = 0u;
+  while( true ) {
+    {
+      unique_lock<mutex> lock( mutex_ );
+      startWork_.wait( lock, [&]() { return stop_ or generation_ != seen; } );
+      if( stop_ ) return;
+      seen = generation_;
+    }
+    runChunk_( chunk );
+    {
+      lock_guard<mutex> lock( mutex_ );
+      pending_--;
+      if( pending_ == 0u ) workDone_.notify_one();
+    }
+  }
+}
+
+
+void ThreadPool::parallelFor(const size_t n,
+                             const function<void(size_t, size_t, UInt)> &task) {
+  if( n == 0u ) return;
+  if( numThreads_ == 1u ) { // Nothing to split, skip the synchronization.
+    task( 0u, n, 0u );
+    return;
+  }
+
+  lock_guard<mutex> submit( submitMutex_ );
+  {
+    lock_guard<mutex> lock( mutex_ );
+    task_    = &task;
+    n_       = n;
+    pending_ = numThreads_ - 1u;
+    error_   = nullptr;
+    generation_++;
+  }
+  startWork_.notify_all();
+
+  runChunk_( 0u );
+
+  exception_ptr error;
+  {
+    unique_lock<mutex> lock( mutex_ );
+    workDone_.wait( lock, [&]() { return pending_ == 0u; } );
+    task_ = nullptr;
+    swap( error, error_ );
+  }
+  if( error ) rethrow_exception( error );
+}
@@ -0,0 +1,117 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the ThreadPool class
+ */
+
+#ifndef HTM_UTIL_THREAD_POOL_HPP
+#define HTM_UTIL_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <htm/types/Types.hpp>
+
+namespace htm {
+
+/**
+ * ThreadPool class
+ *
+ * A minimal fork-join pool used by the algorithms to split loops over their
+ * data between several threads.  The worker threads are started once and then
+ * sleep between calls to parallelFor.
+ *
+ * Work is always partitioned the same way: [0, n) is cut into size()
+ * contiguous chunks, chunk i being [n*i/size(), n*(i+1)/size()).  The caller
+ * is responsible for making the combination of the chunks' results
+ * deterministic, typically by giving each chunk its own output buffer and
+ * reducing them in chunk order.
+ *
+ * Example usage:
+ *
+ *    ThreadPool pool( 4 );
+ *    vector<UInt> partialSums( pool.size(), 0u );
+ *    pool.parallelFor( data.size(), [&](size_t begin, size_t end, UInt chunk) {
+ *      for(size_t i = begin; i < end; i++)
+ *        partialSums[chunk] += data[i];
+ *    });
+ */
+class ThreadPool {
+public:
+  /**
+   * @param numThreads Total number of threads to compute with, including the
+   * thread which calls parallelFor.  If 0 then this uses the number of
+   * hardware threads.
+   */
+  explicit ThreadPool(UInt numThreads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @returns The number of threads, which is also the number of chunks each
+   * parallelFor is split into.
+   */
+  UInt size() const { return numThreads_; }
+
+  /**
+   * Call `task(begin, end, chunk)` for every chunk of the range [0, n) and
+   * wait for all of them to finish.  Chunk 0 runs on the calling thread.
+   * Empty chunks are skipped.  If a task throws, the first exception is
+   * rethrown here after all chunks are done.
+   *
+   * Calls from several threads into the same pool are serialized.
+   */
+  void parallelFor(const size_t n,
+                   const std::function<void(size_t begin, size_t end, UInt chunk)> &task);
+
+  /**
+   * @returns The range of the given chunk, see parallelFor.
+   */
+  static inline size_t chunkBegin(const size_t n, const UInt numChunks, const UInt chunk)
+    { return n * chunk / numChunks; }
+
+private:
+  void workerLoop_(const UInt chunk);
+  void runChunk_(const UInt chunk);
+
+  const UInt numThreads_;
+  std::vector<std::thread> workers_;
+
+  std::mutex              submitMutex_; // one parallelFor at a time
+  std::mutex              mutex_;
+  std::condition_variable startWork_;
+  std::condition_variable workDone_;
+
+  // The current job, guarded by mutex_.
+  const std::function<void(size_t, size_t, UInt)> *task_ = nullptr;
+  size_t             n_          = 0u;
+  UInt64             generation_ = 0u;
+  UInt               pending_    = 0u;
+  bool               stop_       = false;
+  std::exception_ptr error_;
+};
+
+} // end namespace htm
+#endif // end HTM_UTIL_THREAD_POOL_HPP
@@ -133,11 +133,7 @@ Neighborhood::Neighborhood(const UInt centerIndex,
                            const bool wrap,
                            const bool skipCenter)
     : centerPosition_(coordinatesFromIndex(centerIndex, dimensions)),
-      dimensions_(dimensions), radius_(radius), wrap_(wrap), skipCenter_(skipCenter), center_(centerIndex) {
-        if(wrap == false) {
-          NTA_WARN << "Neighborhood uses wrap=false which runs considerably slower with local inhibition!";
-        }
-      }
+      dimensions_(dimensions), radius_(radius), wrap_(wrap), skipCenter_(skipCenter), center_(centerIndex) {}
 
 Neighborhood::Iterator::Iterator(const Neighborhood &neighborhood, bool end)
     : neighborhood_(neighborhood),
@@ -149,6 +145,9 @@ Neighborhood::Iterator::Iterator(const Neighborhood &neighborhood, bool end)
             offset_[i] = std::max(offset_[i], -(Int)neighborhood_.centerPosition_[i]);
           }
         }
+        if(!finished_ and neighborhood_.skipCenter_ and index_() == neighborhood_.center_) {
+          advance_();
+        }
 }
 
 bool Neighborhood::Iterator::operator!=(const Iterator &other) const {
@@ -156,6 +155,10 @@ bool Neighborhood::Iterator::operator!=(const Iterator &other) const {
 }
 
 UInt Neighborhood::Iterator::operator*() {
+  return index_();
+}
+
+UInt Neighborhood::Iterator::index_() const {
   UInt index = 0;
   
   NTA_ASSERT(neighborhood_.dimensions_.size() == offset_.size() and offset_.size() == neighborhood_.centerPosition_.size()); 
@@ -180,16 +183,15 @@ UInt Neighborhood::Iterator::operator*() {
     index += coordinate;
   }
 
-  if(neighborhood_.skipCenter_ and index == neighborhood_.center_) { 
-    advance_();
-    return this->operator*();
-  }
-
   return index;
 }
 
 const Neighborhood::Iterator &Neighborhood::Iterator::operator++() {
   advance_();
+  // The center is visited at most once, skip over it.
+  if(!finished_ and neighborhood_.skipCenter_ and index_() == neighborhood_.center_) {
+    advance_();
+  }
   return *this;
 }
 
@@ -235,7 +237,7 @@ unordered_map<CellIdx, vector<CellIdx>> Neighborhood::updateAllNeighbors(
 		const UInt radius,
                 const vector<UInt> dimensions,
                 const bool wrapAround,
-                const bool skip_center) { //TODO  move the cache logic to Neighbor class
+                const bool skip_center) {
 
   std::unordered_map<CellIdx, vector<CellIdx>> neighborMap;
   UInt numColumns = 1;
@@ -244,12 +246,12 @@ unordered_map<CellIdx, vector<CellIdx>> Neighborhood::updateAllNeighbors(
   }
   neighborMap.reserve(numColumns);
 
-
+  const NeighborhoodStencil stencil(radius, dimensions, wrapAround);
   for(UInt column=0; column < numColumns; column++) {
     vector<CellIdx> neighbors; //of the current column
-    for(const auto neighbor: Neighborhood(column, radius, dimensions, wrapAround, skip_center)) {
+    stencil.forEach(column, [&neighbors](const UInt neighbor) {
       neighbors.push_back(neighbor);
-    }
+    }, skip_center);
     std::sort(neighbors.begin(), neighbors.end()); //sort for better cache locality
     neighbors.shrink_to_fit();
 
@@ -261,3 +263,354 @@ unordered_map<CellIdx, vector<CellIdx>> Neighborhood::updateAllNeighbors(
 
 Neighborhood::Iterator Neighborhood::begin() const { return {*this, false}; }
 Neighborhood::Iterator Neighborhood::end() const { return {*this, true}; }
+
+
+// ============================================================================
+// NEIGHBORHOOD STENCIL
+// ============================================================================
+
+NeighborhoodStencil::NeighborhoodStencil(const UInt radius,
+                                         const vector<UInt> &dimensions,
+                                         const bool wrap)
+    : dimensions_(dimensions), radius_(radius), wrap_(wrap),
+      strides_(dimensions.size()) {
+  NTA_CHECK( not dimensions_.empty() );
+  UInt stride = 1u;
+  bool wholeBox = true; // Does the whole box fit into the grid?
+  for( size_t i = dimensions_.size(); i-- > 0u; ) {
+    NTA_CHECK( dimensions_[i] > 0u );
+    strides_[i] = stride;
+    stride *= dimensions_[i];
+    wholeBox = wholeBox and 2ull * radius_ + 1ull <= dimensions_[i];
+  }
+  if( not wholeBox ) return;
+
+  // Offsets of the box, in the same order as Neighborhood::Iterator.
+  offsets_.push_back( 0 );
+  for( size_t i = 0u; i < dimensions_.size(); i++ ) {
+    vector<Int64> next;
+    next.reserve( offsets_.size() * (2u * radius_ + 1u) );
+    for( const auto offset : offsets_ ) {
+      for( Int64 delta = -static_cast<Int64>(radius_); delta <= static_cast<Int64>(radius_); delta++ ) {
+        next.push_back( offset + delta * static_cast<Int64>(strides_[i]) );
+      }
+    }
+    offsets_.swap( next );
+  }
+}
+
+
+bool NeighborhoodStencil::isInterior_(const UInt centerIndex) const {
+  if( offsets_.empty() ) return false;
+  for( size_t i = 0u; i < dimensions_.size(); i++ ) {
+    const UInt x = (centerIndex / strides_[i]) % dimensions_[i];
+    if( x < radius_ or static_cast<UInt64>(x) + radius_ >= dimensions_[i] ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// ============================================================================
+// NEIGHBORHOOD COUNTER
+// ============================================================================
+
+namespace {
+
+// The neighborhood of coordinate x within a dimension, as the two ranges
+// [ranges[0], ranges[1]) and [ranges[2], ranges[3]).  The second range is
+// empty unless the neighborhood wraps around.  These are the same points as
+// visited by Neighborhood::Iterator.
+void neighborhoodRanges_(const UInt x, const UInt dimension, const UInt radius,
+                         const bool wrap, UInt *ranges) {
+  ranges[2] = 0u;
+  ranges[3] = 0u;
+  if( not wrap ) {
+    ranges[0] = x > radius ? x - radius : 0u;
+    ranges[1] = std::min<UInt>(dimension, x + radius + 1u);
+  }
+  else if( 2u * radius + 1u >= dimension ) {
+    ranges[0] = 0u;
+    ranges[1] = dimension;
+  }
+  else if( x < radius ) {
+    ranges[0] = dimension + x - radius;
+    ranges[1] = dimension;
+    ranges[3] = x + radius + 1u;
+  }
+  else if( x + radius >= dimension ) {
+    ranges[0] = x - radius;
+    ranges[1] = dimension;
+    ranges[3] = x + radius + 1u - dimension;
+  }
+  else {
+    ranges[0] = x - radius;
+    ranges[1] = x + radius + 1u;
+  }
+}
+
+// Number of nodes which a Fenwick tree visits per dimension, at most.
+UInt treeDepth_(UInt dimension) {
+  UInt depth = 0u;
+  for( ; dimension > 0u; dimension >>= 1 ) {
+    depth++;
+  }
+  return depth;
+}
+
+// Calls f(first, stride, length) for every line of the grid which runs along
+// dimension dim.  The points of the line are first + k * stride, for k in
+// [0, length).
+template<typename F>
+void forEachLine_(const vector<UInt> &dimensions, const size_t dim, F f) {
+  size_t stride = 1u;
+  for( size_t d = dim + 1u; d < dimensions.size(); d++ ) {
+    stride *= dimensions[d];
+  }
+  const size_t length = dimensions[dim];
+  const size_t size   = stride * length;
+  size_t total = size;
+  for( size_t d = 0u; d < dim; d++ ) {
+    total *= dimensions[d];
+  }
+  for( size_t outer = 0u; outer < total; outer += size ) {
+    for( size_t inner = 0u; inner < stride; inner++ ) {
+      f(outer + inner, stride, length);
+    }
+  }
+}
+
+} // end anonymous namespace
+
+
+NeighborhoodCounter::NeighborhoodCounter(const vector<UInt> &dimensions,
+                                         const UInt radius,
+                                         const bool wrap)
+    : dimensions_(dimensions), radius_(radius), wrap_(wrap),
+      coordinates_(dimensions.size()), ranges_(4u * dimensions.size()),
+      rangesCenter_(std::numeric_limits<UInt>::max()) {
+  NTA_CHECK( not dimensions_.empty() );
+  // Compare the cost of scanning a neighborhood with the cost of querying the
+  // tree, which visits up to two nodes per level for every dimension.
+  Real64 numPoints = 1.0;
+  Real64 volume    = 1.0;
+  Real64 treeCost  = 1.0;
+  for( const auto dim : dimensions_ ) {
+    NTA_CHECK( dim > 0u );
+    numPoints *= dim;
+    volume    *= std::min<Real64>(dim, 2.0 * radius_ + 1.0);
+    treeCost  *= 2.0 * treeDepth_(dim);
+  }
+  NTA_CHECK( numPoints <= std::numeric_limits<UInt>::max() );
+  useTree_ = volume > 4.0 * treeCost;
+  if( useTree_ ) {
+    tree_.assign( static_cast<size_t>(numPoints), 0u );
+  }
+  else {
+    marked_.assign( static_cast<size_t>(numPoints), 0 );
+  }
+}
+
+
+void NeighborhoodCounter::clear() {
+  std::fill( tree_.begin(),   tree_.end(),   0u );
+  std::fill( marked_.begin(), marked_.end(), 0 );
+}
+
+
+void NeighborhoodCounter::add(const UInt index) {
+  if( not useTree_ ) {
+    NTA_ASSERT( index < marked_.size() );
+    NTA_ASSERT( marked_[index] == 0 ) << "Point " << index << " is already marked.";
+    marked_[index] = 1;
+    return;
+  }
+  NTA_ASSERT( index < tree_.size() );
+  UInt shifted = index;
+  for( size_t i = dimensions_.size(); i-- > 0u; ) {
+    coordinates_[i] = shifted % dimensions_[i];
+    shifted /= dimensions_[i];
+  }
+  addTree_(0u, 0u);
+}
+
+
+void NeighborhoodCounter::addTree_(const size_t dim, const UInt base) {
+  const UInt dimension = dimensions_[dim];
+  const bool last = dim + 1u == dimensions_.size();
+  for( UInt i = coordinates_[dim] + 1u; i <= dimension; i += i & (0u - i) ) {
+    const UInt node = base * dimension + i - 1u;
+    if( last ) {
+      tree_[node]++;
+    } else {
+      addTree_(dim + 1u, node);
+    }
+  }
+}
+
+
+void NeighborhoodCounter::setRanges_(const UInt centerIndex) const {
+  if( centerIndex == rangesCenter_ ) return;
+  rangesCenter_ = centerIndex;
+  UInt shifted = centerIndex;
+  for( size_t i = dimensions_.size(); i-- > 0u; ) {
+    neighborhoodRanges_(shifted % dimensions_[i], dimensions_[i], radius_, wrap_,
+                        &ranges_[4u * i]);
+    shifted /= dimensions_[i];
+  }
+  NTA_ASSERT( shifted == 0u ) << "Point " << centerIndex << " is outside of the grid.";
+}
+
+
+UInt NeighborhoodCounter::size(const UInt centerIndex) const {
+  setRanges_(centerIndex);
+  UInt size = 1u;
+  for( size_t i = 0u; i < ranges_.size(); i += 4u ) {
+    size *= (ranges_[i + 1u] - ranges_[i]) + (ranges_[i + 3u] - ranges_[i + 2u]);
+  }
+  return size;
+}
+
+
+UInt NeighborhoodCounter::count(const UInt centerIndex, const UInt limit) const {
+  setRanges_(centerIndex);
+  return useTree_ ? countTree_(0u, 0u) : countScan_(0u, 0u, limit);
+}
+
+
+UInt NeighborhoodCounter::countTree_(const size_t dim, const UInt base) const {
+  const UInt *ranges = &ranges_[4u * dim];
+  UInt total = prefixTree_(dim, base, ranges[1]) - prefixTree_(dim, base, ranges[0]);
+  if( ranges[3] > ranges[2] ) {
+    total += prefixTree_(dim, base, ranges[3]) - prefixTree_(dim, base, ranges[2]);
+  }
+  return total;
+}
+
+
+UInt NeighborhoodCounter::prefixTree_(const size_t dim, const UInt base, UInt end) const {
+  const UInt dimension = dimensions_[dim];
+  const bool last = dim + 1u == dimensions_.size();
+  UInt total = 0u;
+  for( ; end > 0u; end -= end & (0u - end) ) {
+    const UInt node = base * dimension + end - 1u;
+    total += last ? tree_[node] : countTree_(dim + 1u, node);
+  }
+  return total;
+}
+
+
+UInt NeighborhoodCounter::countScan_(const size_t dim, const UInt base, const UInt limit) const {
+  const UInt *ranges = &ranges_[4u * dim];
+  const UInt dimension = dimensions_[dim];
+  const bool last = dim + 1u == dimensions_.size();
+  UInt total = 0u;
+  for( UInt r = 0u; r < 4u; r += 2u ) {
+    const UInt first = base * dimension;
+    for( UInt x = ranges[r]; x < ranges[r + 1u]; x++ ) {
+      if( last ) {
+        if( marked_[first + x] and ++total >= limit ) return total;
+      }
+      else {
+        total += countScan_(dim + 1u, first + x, limit - total);
+        if( total >= limit ) return total;
+      }
+    }
+  }
+  return total;
+}
+
+
+// ============================================================================
+// NEIGHBORHOOD MAXIMUM & MEAN
+// ============================================================================
+
+namespace htm {
+
+void neighborhoodMax(const vector<Real> &values,
+                     const vector<UInt> &dimensions,
+                     const UInt radius,
+                     const bool wrap,
+                     vector<Real> &result) {
+  NTA_ASSERT( &values != &result );
+  result.assign( values.begin(), values.end() );
+  vector<Real> line;
+  vector<Int>  window; // Monotonic queue of positions in the line.
+  const Int r = static_cast<Int>(radius);
+
+  for( size_t dim = 0u; dim < dimensions.size(); dim++ ) {
+    forEachLine_(dimensions, dim, [&](const size_t first, const size_t stride, const size_t length) {
+      line.resize( length );
+      for( size_t k = 0u; k < length; k++ ) {
+        line[k] = result[first + k * stride];
+      }
+      if( wrap ? 2u * radius + 1u >= length : radius + 1u >= length ) {
+        const Real lineMax = *std::max_element( line.begin(), line.end() );
+        for( size_t k = 0u; k < length; k++ ) {
+          result[first + k * stride] = lineMax;
+        }
+        return;
+      }
+      // Slide a window of 2 * radius + 1 positions along the line, positions
+      // outside of the line either wrap around or are skipped.
+      const Int len = static_cast<Int>(length);
+      const auto at = [&](const Int j) {
+        return line[ j < 0 ? j + len : (j >= len ? j - len : j) ];
+      };
+      window.resize( length + 2u * radius );
+      size_t head = 0u;
+      size_t tail = 0u;
+      for( Int j = -r; j < len + r; j++ ) {
+        if( wrap or (j >= 0 and j < len) ) {
+          const Real value = at(j);
+          while( tail > head and at(window[tail - 1u]) <= value ) {
+            tail--;
+          }
+          window[tail++] = j;
+        }
+        const Int k = j - r;
+        if( k >= 0 ) {
+          while( window[head] < k - r ) {
+            head++;
+          }
+          result[first + static_cast<size_t>(k) * stride] = at(window[head]);
+        }
+      }
+    });
+  }
+}
+
+
+void neighborhoodMean(const vector<Real> &values,
+                      const vector<UInt> &dimensions,
+                      const UInt radius,
+                      const bool wrap,
+                      vector<Real> &result) {
+  vector<Real64> sums( values.begin(), values.end() );
+  vector<Real64> counts( values.size(), 1.0 );
+  vector<Real64> prefix;
+  UInt ranges[4];
+
+  for( size_t dim = 0u; dim < dimensions.size(); dim++ ) {
+    forEachLine_(dimensions, dim, [&](const size_t first, const size_t stride, const size_t length) {
+      prefix.resize( length + 1u );
+      prefix[0] = 0.0;
+      for( size_t k = 0u; k < length; k++ ) {
+        prefix[k + 1u] = prefix[k] + sums[first + k * stride];
+      }
+      for( size_t k = 0u; k < length; k++ ) {
+        neighborhoodRanges_(static_cast<UInt>(k), static_cast<UInt>(length), radius, wrap, ranges);
+        const size_t point = first + k * stride;
+        sums[point]    = (prefix[ranges[1]] - prefix[ranges[0]]) + (prefix[ranges[3]] - prefix[ranges[2]]);
+        counts[point] *= (ranges[1] - ranges[0]) + (ranges[3] - ranges[2]);
+      }
+    });
+  }
+  result.resize( values.size() );
+  for( size_t i = 0u; i < values.size(); i++ ) {
+    result[i] = static_cast<Real>(sums[i] / counts[i]);
+  }
+}
+
+} // end namespace htm
@@ -23,7 +23,9 @@
 #define NTA_TOPOLOGY_HPP
 
 #include <vector>
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <unordered_map>
 
 #include <htm/types/Types.hpp>
@@ -174,7 +176,8 @@ UInt indexFromCoordinates(const std::vector<UInt> &coordinates,
  * occur on the stack, but this would put a burden on callers to handle
  * different dimensions counts. Or it would require using polymorphism,
  * using pointers/references and putting the Neighborhood on the heap,
- * which defeats the purpose of avoiding the vector allocations.
+ * which defeats the purpose of avoiding the vector allocations.  To visit
+ * the neighborhoods of many points of the same grid, use NeighborhoodStencil.
  *
  * @param centerIndex
  * The center of this neighborhood. The coordinates are expressed as a
@@ -217,6 +220,7 @@ public:
 
   private:
     void advance_();
+    UInt index_() const;
 
     const Neighborhood &neighborhood_;
     std::vector<Int> offset_;
@@ -242,6 +246,186 @@ private:
 };
 
 
+/**
+ * Visits the points within the neighborhoods of a grid without allocating
+ * memory.  These are the same neighborhoods, in the same order, as those of
+ * the Neighborhood class.
+ *
+ * The stencil holds the index offsets of a whole (2 * radius + 1)^N box.  The
+ * neighborhood of an interior point is the center plus these offsets.  Points
+ * whose neighborhood is truncated by, or wraps around, an edge of the grid are
+ * visited one dimension at a time instead.  Make one stencil and reuse it for
+ * every point of the grid.
+ *
+ * Usage:
+ *   NeighborhoodStencil stencil(10, {100, 100}, true);
+ *   stencil.forEach(42, [&](UInt neighbor) {
+ *     // Do something with the neighbor, note the center is included.
+ *   });
+ */
+class NeighborhoodStencil {
+public:
+  NeighborhoodStencil(const UInt radius,
+                      const std::vector<UInt> &dimensions,
+                      const bool wrap = false);
+
+  /**
+   * Calls visit(UInt point) for every point within the neighborhood of
+   * centerIndex.
+   *
+   * @param skipCenter (default false) skips centerIndex itself.
+   */
+  template<typename Visitor>
+  void forEach(const UInt centerIndex, Visitor visit, const bool skipCenter = false) const {
+    if( isInterior_(centerIndex) ) {
+      for( const auto offset : offsets_ ) {
+        if( skipCenter and offset == 0 ) continue;
+        visit( static_cast<UInt>(static_cast<Int64>(centerIndex) + offset) );
+      }
+    }
+    else {
+      forEachBorder_(0u, 0u, centerIndex, visit, skipCenter);
+    }
+  }
+
+  UInt getRadius() const { return radius_; }
+  const std::vector<UInt> &getDimensions() const { return dimensions_; }
+  bool getWrap() const { return wrap_; }
+
+private:
+  bool isInterior_(const UInt centerIndex) const;
+
+  template<typename Visitor>
+  void forEachBorder_(const size_t dim, const UInt base, const UInt centerIndex,
+                      Visitor &visit, const bool skipCenter) const {
+    const UInt dimension = dimensions_[dim];
+    const UInt x = (centerIndex / strides_[dim]) % dimension;
+    // Range of coordinates which the Neighborhood class visits, in order.
+    UInt coordinate, count;
+    if( wrap_ ) {
+      coordinate = (x + dimension - radius_ % dimension) % dimension;
+      count = static_cast<UInt>(std::min<UInt64>(2ull * radius_ + 1ull, dimension));
+    }
+    else {
+      coordinate = x > radius_ ? x - radius_ : 0u;
+      count = static_cast<UInt>(std::min<UInt64>(static_cast<UInt64>(x) + radius_, dimension - 1u)) - coordinate + 1u;
+    }
+    const bool last = dim + 1u == dimensions_.size();
+    for( UInt i = 0u; i < count; i++ ) {
+      const UInt point = base * dimension + coordinate;
+      if( not last ) {
+        forEachBorder_(dim + 1u, point, centerIndex, visit, skipCenter);
+      }
+      else if( not (skipCenter and point == centerIndex) ) {
+        visit( point );
+      }
+      if( ++coordinate == dimension ) {
+        coordinate = 0u;
+      }
+    }
+  }
+
+  const std::vector<UInt> dimensions_;
+  const UInt radius_;
+  const bool wrap_;
+  std::vector<UInt>  strides_; // Index distance between neighbors, per dimension.
+  std::vector<Int64> offsets_; // Empty if no point has a whole box.
+};
+
+/**
+ * Counts the marked points within the neighborhoods of a grid.  These are the
+ * same neighborhoods as those of the Neighborhood class, including the center.
+ *
+ * Marking a point and counting the marked points of a neighborhood are both
+ * fast for any radius: small neighborhoods are counted by scanning them, and
+ * large neighborhoods by querying a Fenwick tree (binary indexed tree) of the
+ * grid, which takes O(log(dimension)) steps per dimension.
+ *
+ * Usage:
+ *   NeighborhoodCounter counter({100, 100}, 10, true);
+ *   counter.add(42);
+ *   counter.count(43); // == 1
+ *   counter.size(43);  // == 21 * 21
+ *
+ * Counting reuses scratch space which belongs to the counter, so a counter
+ * must not be shared between threads.
+ */
+class NeighborhoodCounter {
+public:
+  NeighborhoodCounter(const std::vector<UInt> &dimensions,
+                      const UInt radius,
+                      const bool wrap);
+
+  /**
+   * Mark a point.  Every point may be marked at most once.
+   */
+  void add(const UInt index);
+
+  /**
+   * Unmark all points.
+   */
+  void clear();
+
+  /**
+   * @returns the number of marked points in the neighborhood of centerIndex.
+   * Counting may stop early once there are at least `limit` of them, in which
+   * case the result is some number >= limit.
+   */
+  UInt count(const UInt centerIndex,
+             const UInt limit = std::numeric_limits<UInt>::max()) const;
+
+  /**
+   * @returns the number of points in the neighborhood of centerIndex.
+   */
+  UInt size(const UInt centerIndex) const;
+
+private:
+  void setRanges_(const UInt centerIndex) const;
+  void addTree_(const size_t dim, const UInt base);
+  UInt countTree_(const size_t dim, const UInt base) const;
+  UInt prefixTree_(const size_t dim, const UInt base, UInt end) const;
+  UInt countScan_(const size_t dim, const UInt base, const UInt limit) const;
+
+  const std::vector<UInt> dimensions_;
+  const UInt radius_;
+  const bool wrap_;
+  bool useTree_;
+  std::vector<UInt> tree_;   // Fenwick tree of the marks, if useTree_.
+  std::vector<Byte> marked_; // Dense marks, if not useTree_.
+  // Scratch: coordinates of a point, and the neighborhood of a point as two
+  // ranges [begin, end) of coordinates per dimension.
+  mutable std::vector<UInt> coordinates_;
+  mutable std::vector<UInt> ranges_;
+  mutable UInt rangesCenter_; // The point which ranges_ belong to.
+};
+
+
+/**
+ * Computes the maximum value within the neighborhood of every point of a
+ * grid.  These are the same neighborhoods as those of the Neighborhood class,
+ * including the center.  This takes O(values.size() * dimensions.size()) time
+ * for any radius, because a neighborhood is a box which can be reduced one
+ * dimension at a time.
+ *
+ * @param values One value per point of the grid.
+ * @param result Output, resized to values.size().  Must not alias values.
+ */
+void neighborhoodMax(const std::vector<Real> &values,
+                     const std::vector<UInt> &dimensions,
+                     const UInt radius,
+                     const bool wrap,
+                     std::vector<Real> &result);
+
+/**
+ * As neighborhoodMax, but computes the mean value within the neighborhood of
+ * every point.  The sums are accumulated in double precision.
+ */
+void neighborhoodMean(const std::vector<Real> &values,
+                      const std::vector<UInt> &dimensions,
+                      const UInt radius,
+                      const bool wrap,
+                      std::vector<Real> &result);
+
 } // end namespace htm
 
 #endif // NTA_TOPOLOGY_HPP
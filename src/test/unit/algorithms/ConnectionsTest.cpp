@@ -22,6 +22,8 @@
 #include "gtest/gtest.h"
 #include <fstream>
 #include <iostream>
+#include <numeric>
+#include <unordered_map>
 #include <htm/algorithms/Connections.hpp>
 
 using namespace std;
@@ -481,6 +483,50 @@ TEST(ConnectionsTest, testRaisePermanencesToThresholdOutOfBounds) {
     << "raisePermanence fails when lower number of available synapses than requested by threshold";
 }
 
+/**
+ * raisePermanencesToThreshold & synapseCompetition find the N'th greatest
+ * permanence for small and large N, on both sides of the connected
+ * threshold, and do not reorder the synapses of the segment.
+ */
+TEST(ConnectionsTest, testNthGreatestPermanence) {
+  vector<UInt> hundredths(100u);
+  std::iota(hundredths.begin(), hundredths.end(), 0u);
+  for(const bool packed : {false, true}) {
+    Random rng(packed ? 21 : 22);
+    for(UInt trial = 0; trial < 100u; trial++) {
+      Connections con(100u, 0.5f);
+      con.setPackedSynapses(packed);
+      const Segment seg = con.createSegment(0u);
+      const UInt numSynapses = 1u + rng.getUInt32(40u);
+      vector<Permanence> permanences;
+      for(const auto h : rng.sample(hundredths, numSynapses)) { // Distinct permanences
+        con.createSynapse(seg, static_cast<CellIdx>(permanences.size()), static_cast<Permanence>(h) / 100.0f);
+        permanences.push_back(static_cast<Permanence>(h) / 100.0f);
+      }
+      vector<Permanence> sorted(permanences);
+      std::sort(sorted.begin(), sorted.end(), std::greater<Permanence>());
+      const auto synapses = con.synapsesForSegment(seg);
+      const UInt n = 1u + rng.getUInt32(numSynapses);
+
+      if( trial % 2 == 0 ) {
+        const Permanence delta = n > con.dataForSegment(seg).numConnected
+                               ? con.getConnectedThreshold() - sorted[n - 1u] : 0.0f;
+        con.raisePermanencesToThreshold(seg, n);
+        ASSERT_GE(con.dataForSegment(seg).numConnected, n);
+        for(UInt i = 0; i < numSynapses; i++) {
+          const Permanence expected = std::min(permanences[i] + delta, maxPermanence);
+          ASSERT_EQ(expected, con.dataForSynapse(synapses[i]).permanence);
+        }
+      }
+      else {
+        con.synapseCompetition(seg, n, n);
+        ASSERT_EQ(n, con.dataForSegment(seg).numConnected);
+      }
+      ASSERT_EQ(synapses, con.synapsesForSegment(seg));
+    }
+  }
+}
+
 TEST(ConnectionsTest, testSynapseCompetition) {
 
   struct testCase {
@@ -802,6 +848,48 @@ TEST(ConnectionsTest, testSaveLoad) {
   ASSERT_EQ(c1, c2);
 }
 
+/**
+ * Equality only depends on the current synapses, not on which presynaptic
+ * cells had synapses before.
+ */
+TEST(ConnectionsTest, testEqualsAfterDestroySynapse) {
+  Connections a(100), b(100);
+  const Segment segA = a.createSegment(0);
+  const Segment segB = b.createSegment(0);
+  a.createSynapse(segA, 5, 0.6f);
+
+  // b once held a synapse to a higher presynaptic cell, its slot is reused.
+  b.destroySynapse( b.createSynapse(segB, 90, 0.6f) );
+  b.createSynapse(segB, 5, 0.6f);
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(b, a);
+
+  Connections c;
+  stringstream ss;
+  b.save(ss);
+  c.load(ss);
+  ASSERT_EQ(a, c);
+  ASSERT_EQ(b, c);
+}
+
+/**
+ * Active presynaptic cells which never had a synapse are ignored.
+ */
+TEST(ConnectionsTest, testComputeActivityBeyondPresynapticCells) {
+  Connections c(1000);
+  const Segment seg = c.createSegment(0);
+  c.createSynapse(seg, 3, 0.6f);
+  c.createSynapse(seg, 4, 0.1f);
+
+  vector<SynapseIdx> potential( c.segmentFlatListLength(), 0 );
+  const auto connected = c.computeActivity( potential, {3u, 4u, 500u, 999u} );
+  ASSERT_EQ( vector<SynapseIdx>({1u}), connected );
+  ASSERT_EQ( vector<SynapseIdx>({2u}), potential );
+
+  ASSERT_EQ( vector<SynapseIdx>({0u}), c.computeActivity({999u}) );
+  ASSERT_TRUE( c.synapsesForPresynapticCell(999u).empty() );
+}
+
 TEST(ConnectionsTest, testCreateSegmentOverflow) {
     const auto LIMIT = std::numeric_limits<Segment>::max();
     if(LIMIT <= 256) { //connections::Segment is too large (likely uint32), so this test would run, but memory 
@@ -871,3 +959,603 @@ TEST(ConnectionsTest, testTimeseries) {
     ASSERT_TRUE( (synData.permanence == 0.0f) or (synData.permanence == 1.0f) );
   }
 }
+
+/**
+ * The packed (CSR) synapse store must give the same results as the default
+ * storage, also after many synapses were created, pruned and the slabs were
+ * relocated & compacted.
+ */
+TEST(ConnectionsTest, testPackedSynapses) {
+  Connections plain(100, 0.5f);
+  Connections packed(100, 0.5f);
+  packed.setPackedSynapses(true);
+  ASSERT_FALSE( plain.packedSynapses() );
+  ASSERT_TRUE( packed.packedSynapses() );
+
+  Random rng1(42), rng2(42), inputRng(1);
+  SDR input({ 100u });
+  vector<CellIdx> candidates(100u);
+  std::iota(candidates.begin(), candidates.end(), 0u);
+  for(UInt cell = 0; cell < 20u; cell++) {
+    plain.createSegment(cell);
+    packed.createSegment(cell);
+  }
+  for(int iter = 0; iter < 200; iter++) {
+    input.randomize(0.1f, inputRng);
+    const Segment seg = iter % 20u;
+    plain.growSynapses( seg, candidates, 0.21f, rng1, 5u, 40u);
+    packed.growSynapses(seg, candidates, 0.21f, rng2, 5u, 40u);
+    plain.adaptSegment( seg, input, 0.1f, 0.1f, true);
+    packed.adaptSegment(seg, input, 0.1f, 0.1f, true);
+    plain.raisePermanencesToThreshold( (seg + 1) % 20u, 3u);
+    packed.raisePermanencesToThreshold((seg + 1) % 20u, 3u);
+    plain.synapseCompetition( (seg + 2) % 20u, 2u, 6u);
+    packed.synapseCompetition((seg + 2) % 20u, 2u, 6u);
+  }
+
+  ASSERT_EQ( plain.numSynapses(), packed.numSynapses() );
+  for(Segment seg = 0; seg < 20u; seg++) {
+    ASSERT_EQ( plain.presynapticCellsForSegment(seg), packed.presynapticCellsForSegment(seg) );
+    map<CellIdx, Permanence> a, b;
+    for(const auto syn : plain.synapsesForSegment(seg))
+      a[plain.dataForSynapse(syn).presynapticCell] = plain.dataForSynapse(syn).permanence;
+    for(const auto syn : packed.synapsesForSegment(seg))
+      b[packed.dataForSynapse(syn).presynapticCell] = packed.dataForSynapse(syn).permanence;
+    ASSERT_EQ( a, b ) << "segment " << seg;
+    ASSERT_EQ( plain.dataForSegment(seg).numConnected, packed.dataForSegment(seg).numConnected );
+  }
+
+  // The setting is not serialized, the slabs are built on demand.
+  Connections loaded;
+  stringstream ss;
+  packed.save(ss);
+  loaded.load(ss);
+  ASSERT_FALSE( loaded.packedSynapses() );
+  ASSERT_EQ( packed, loaded );
+  loaded.setPackedSynapses(true);
+  packed.adaptSegment(3u, input, 0.1f, 0.1f, true);
+  loaded.adaptSegment(3u, input, 0.1f, 0.1f, true);
+  ASSERT_EQ( packed, loaded );
+
+  // The slabs are rebuilt after loading into a packed Connections.
+  Connections packedLoaded;
+  packedLoaded.setPackedSynapses(true);
+  stringstream ss2;
+  plain.save(ss2);
+  packedLoaded.load(ss2);
+  ASSERT_TRUE( packedLoaded.packedSynapses() );
+  ASSERT_EQ( plain, packedLoaded );
+  plain.adaptSegment(3u, input, 0.1f, 0.1f, true);
+  packedLoaded.adaptSegment(3u, input, 0.1f, 0.1f, true);
+  ASSERT_EQ( plain, packedLoaded );
+  packedLoaded.setPackedSynapses(false);
+  ASSERT_EQ( plain, packedLoaded );
+}
+
+/**
+ * The archive layout of Connections before the packed synapse store and the
+ * vector presynaptic maps were added.
+ */
+struct BaselineConnections : public Serializable {
+  struct identity { constexpr size_t operator()( const CellIdx t ) const noexcept { return t; }; };
+  Permanence               connectedThreshold_;
+  UInt32                   iteration_;
+  vector<CellData>         cells_;
+  vector<SegmentData>      segments_;
+  vector<SynapseData>      synapses_;
+  vector<Synapse>          destroyedSynapses_;
+  vector<Segment>          destroyedSegments_;
+  std::unordered_map<CellIdx, vector<Synapse>, identity> potentialSynapsesForPresynapticCell_;
+  std::unordered_map<CellIdx, vector<Synapse>, identity> connectedSynapsesForPresynapticCell_;
+  std::unordered_map<CellIdx, vector<Segment>, identity> potentialSegmentsForPresynapticCell_;
+  std::unordered_map<CellIdx, vector<Segment>, identity> connectedSegmentsForPresynapticCell_;
+  bool                     timeseries_;
+  vector<Permanence>       previousUpdates_;
+  vector<Permanence>       currentUpdates_;
+  Synapse                  prunedSyns_;
+  Segment                  prunedSegs_;
+
+  CerealAdapter;
+  template<class Archive>
+  void save_ar(Archive & ar) const {
+    ar(CEREAL_NVP(connectedThreshold_));
+    ar(CEREAL_NVP(iteration_));
+    ar(CEREAL_NVP(cells_));
+    ar(CEREAL_NVP(segments_));
+    ar(CEREAL_NVP(synapses_));
+    ar(CEREAL_NVP(destroyedSynapses_));
+    ar(CEREAL_NVP(destroyedSegments_));
+    ar(CEREAL_NVP(potentialSynapsesForPresynapticCell_));
+    ar(CEREAL_NVP(connectedSynapsesForPresynapticCell_));
+    ar(CEREAL_NVP(potentialSegmentsForPresynapticCell_));
+    ar(CEREAL_NVP(connectedSegmentsForPresynapticCell_));
+    ar(CEREAL_NVP(timeseries_));
+    ar(CEREAL_NVP(previousUpdates_));
+    ar(CEREAL_NVP(currentUpdates_));
+    ar(CEREAL_NVP(prunedSyns_));
+    ar(CEREAL_NVP(prunedSegs_));
+  }
+  template<class Archive>
+  void load_ar(Archive & ar) {
+    ar(CEREAL_NVP(connectedThreshold_));
+    ar(CEREAL_NVP(iteration_));
+    ar(CEREAL_NVP(cells_));
+    ar(CEREAL_NVP(segments_));
+    ar(CEREAL_NVP(synapses_));
+    ar(CEREAL_NVP(destroyedSynapses_));
+    ar(CEREAL_NVP(destroyedSegments_));
+    ar(CEREAL_NVP(potentialSynapsesForPresynapticCell_));
+    ar(CEREAL_NVP(connectedSynapsesForPresynapticCell_));
+    ar(CEREAL_NVP(potentialSegmentsForPresynapticCell_));
+    ar(CEREAL_NVP(connectedSegmentsForPresynapticCell_));
+    ar(CEREAL_NVP(timeseries_));
+    ar(CEREAL_NVP(previousUpdates_));
+    ar(CEREAL_NVP(currentUpdates_));
+    ar(CEREAL_NVP(prunedSyns_));
+    ar(CEREAL_NVP(prunedSegs_));
+  }
+};
+
+/**
+ * Connections archives load into the baseline layout and back, in every
+ * format, whether or not the synapses are packed.
+ */
+TEST(ConnectionsTest, testSaveLoadBaselineLayout) {
+  for( const auto fmt : { SerializableFormat::BINARY, SerializableFormat::PORTABLE,
+                          SerializableFormat::JSON,   SerializableFormat::XML } ) {
+    for( const bool packed : { false, true } ) {
+      Connections c1(1024);
+      c1.setPackedSynapses(packed);
+      setupSampleConnections(c1);
+      const auto segment = c1.createSegment(10);
+      c1.destroySynapse( c1.createSynapse(segment, 1000, 0.5f) ); // leaves an empty list behind
+      computeSampleActivity(c1);
+
+      BaselineConnections baseline;
+      {
+        stringstream ss;
+        c1.save(ss, fmt);
+        baseline.load(ss, fmt);
+      }
+      ASSERT_EQ( c1.numCells(), baseline.cells_.size() );
+      ASSERT_EQ( c1.segmentFlatListLength(), baseline.segments_.size() );
+      ASSERT_EQ( c1.numSynapses() + baseline.destroyedSynapses_.size(), baseline.synapses_.size() );
+      ASSERT_EQ( 0u, baseline.potentialSynapsesForPresynapticCell_.count(1000) );
+      for( const auto &entry : baseline.potentialSynapsesForPresynapticCell_ ) {
+        ASSERT_FALSE( entry.second.empty() );
+        for( const auto syn : entry.second ) {
+          ASSERT_EQ( entry.first, c1.dataForSynapse(syn).presynapticCell );
+          ASSERT_LT( c1.dataForSynapse(syn).permanence, c1.getConnectedThreshold() );
+        }
+      }
+      for( const auto &entry : baseline.connectedSynapsesForPresynapticCell_ ) {
+        for( const auto syn : entry.second ) {
+          ASSERT_EQ( entry.first, c1.dataForSynapse(syn).presynapticCell );
+          ASSERT_GE( c1.dataForSynapse(syn).permanence, c1.getConnectedThreshold() );
+        }
+      }
+
+      Connections c2;
+      {
+        stringstream ss;
+        baseline.save(ss, fmt);
+        c2.load(ss, fmt);
+      }
+      ASSERT_FALSE( c2.packedSynapses() );
+      ASSERT_EQ( c1, c2 );
+    }
+  }
+}
+
+/**
+ * computeActivity gives the same results with multiple threads.
+ */
+TEST(ConnectionsTest, testComputeActivityThreads) {
+  Connections serial(1000u), threaded(1000u);
+  threaded.setNumThreads(4u);
+  ASSERT_EQ( threaded.getNumThreads(), 4u );
+  Random rng(7);
+  SDR presyn({ 1000u });
+  for(UInt cell = 0; cell < 1000u; cell++) {
+    presyn.randomize(0.05f, rng);
+    for(auto c : { &serial, &threaded }) {
+      const Segment seg = c->createSegment(cell);
+      for(const auto pre : presyn.getSparse())
+        c->createSynapse(seg, pre, (pre % 10u) / 10.0f);
+    }
+  }
+  for(int i = 0; i < 10; i++) {
+    presyn.randomize(0.02f, rng);
+    vector<SynapseIdx> potentialSerial(  serial.segmentFlatListLength() );
+    vector<SynapseIdx> potentialThreaded(threaded.segmentFlatListLength() );
+    const auto connectedSerial   = serial.computeActivity(  potentialSerial,   presyn.getSparse());
+    const auto connectedThreaded = threaded.computeActivity(potentialThreaded, presyn.getSparse());
+    ASSERT_EQ( connectedSerial, connectedThreaded );
+    ASSERT_EQ( potentialSerial, potentialThreaded );
+  }
+
+  // With reused buffers only the touched segments are summed and zeroed, in
+  // the same order as serially.
+  vector<SynapseIdx> connectedSerial, potentialSerial, connectedThreaded, potentialThreaded;
+  vector<Segment> touchedSerial, touchedThreaded;
+  for(int i = 0; i < 10; i++) {
+    presyn.randomize(0.02f, rng);
+    serial.computeActivity(  connectedSerial,   potentialSerial,   touchedSerial,   presyn.getSparse());
+    threaded.computeActivity(connectedThreaded, potentialThreaded, touchedThreaded, presyn.getSparse());
+    ASSERT_EQ( connectedSerial,   connectedThreaded );
+    ASSERT_EQ( potentialSerial,   potentialThreaded );
+    ASSERT_EQ( touchedSerial,     touchedThreaded );
+  }
+  threaded.setNumThreads(1u);
+  ASSERT_EQ( threaded.getNumThreads(), 1u );
+}
+
+/**
+ * computeActivity into reused buffers gives the same results as computing
+ * into fresh vectors, also when segments are created between the calls.
+ */
+TEST(ConnectionsTest, testComputeActivityReuseBuffers) {
+  for(const UInt numThreads : {1u, 3u}) {
+    Connections c(100u);
+    c.setNumThreads(numThreads);
+    Random rng(3);
+    SDR presyn({ 100u });
+    vector<SynapseIdx> connected, potential;
+    vector<Segment> touched;
+    for(int i = 0; i < 20; i++) {
+      // Grow the model.
+      presyn.randomize(0.1f, rng);
+      const Segment seg = c.createSegment(rng.getUInt32(100u));
+      for(const auto pre : presyn.getSparse())
+        c.createSynapse(seg, pre, rng.getReal64() > 0.5 ? 0.6f : 0.4f);
+
+      presyn.randomize(0.1f, rng);
+      c.computeActivity(connected, potential, touched, presyn.getSparse());
+
+      vector<SynapseIdx> expectedPotential(c.segmentFlatListLength());
+      const auto expectedConnected = c.computeActivity(expectedPotential, presyn.getSparse());
+      ASSERT_EQ( connected, expectedConnected );
+      ASSERT_EQ( potential, expectedPotential );
+
+      vector<Segment> expectedTouched;
+      for(Segment s = 0; s < expectedPotential.size(); s++)
+        if( expectedPotential[s] > 0 ) expectedTouched.push_back(s);
+      std::sort(touched.begin(), touched.end());
+      ASSERT_EQ( touched, expectedTouched );
+    }
+  }
+}
+
+class CompactEventHandler : public ConnectionsEventHandler {
+public:
+  CompactEventHandler(vector<Segment> &segmentRemap, vector<Synapse> &synapseRemap)
+      : segmentRemap(segmentRemap), synapseRemap(synapseRemap) {}
+
+  void onCompact(const vector<Segment> &segments, const vector<Synapse> &synapses) override {
+    segmentRemap = segments;
+    synapseRemap = synapses;
+  }
+
+  vector<Segment> &segmentRemap;
+  vector<Synapse> &synapseRemap;
+};
+
+// The synapses of every segment of every cell, as (presynaptic cell, permanence).
+vector<vector<map<CellIdx, Permanence>>> synapsesPerCell(const Connections &c) {
+  vector<vector<map<CellIdx, Permanence>>> result(c.numCells());
+  for(CellIdx cell = 0; cell < c.numCells(); cell++) {
+    for(const auto seg : c.segmentsForCell(cell)) {
+      map<CellIdx, Permanence> synapses;
+      for(const auto syn : c.synapsesForSegment(seg)) {
+        EXPECT_EQ( seg, c.segmentForSynapse(syn) );
+        synapses[c.dataForSynapse(syn).presynapticCell] = c.dataForSynapse(syn).permanence;
+      }
+      result[cell].push_back(synapses);
+    }
+  }
+  return result;
+}
+
+/**
+ * compact removes the destroyed segments and synapses, keeps everything else
+ * and tells the subscribers how the indices changed.
+ */
+TEST(ConnectionsTest, testCompact) {
+  for(const bool packed : {false, true}) {
+    Connections c(100u, 0.5f, false, packed);
+    Random rng(5);
+    SDR presyn({ 100u });
+    for(int i = 0; i < 60; i++) {
+      presyn.randomize(0.1f, rng);
+      const Segment seg = c.createSegment(rng.getUInt32(100u));
+      for(const auto pre : presyn.getSparse())
+        c.createSynapse(seg, pre, rng.getReal64() > 0.5 ? 0.6f : 0.4f);
+    }
+    for(int i = 0; i < 20; i++) {
+      const Segment seg = rng.getUInt32(c.segmentFlatListLength());
+      if( c.dataForSegment(seg).synapses.empty() ) continue; // already destroyed
+      if( i % 2 ) {
+        c.destroySynapse(c.synapsesForSegment(seg).front());
+      }
+      else {
+        c.destroySegment(seg);
+      }
+    }
+    const auto oldLength   = c.segmentFlatListLength();
+    const auto numSegments = c.numSegments();
+    const auto numSynapses = c.numSynapses();
+    ASSERT_LT( numSegments, oldLength );
+    const auto before = synapsesPerCell(c);
+    presyn.randomize(0.3f, rng);
+    vector<SynapseIdx> potentialBefore(oldLength);
+    const auto connectedBefore = c.computeActivity(potentialBefore, presyn.getSparse());
+
+    vector<Segment> segmentRemap;
+    vector<Synapse> synapseRemap;
+    c.subscribe(new CompactEventHandler(segmentRemap, synapseRemap));
+    c.compact();
+
+    ASSERT_EQ( c.segmentFlatListLength(), numSegments );
+    ASSERT_EQ( c.numSegments(), numSegments );
+    ASSERT_EQ( c.numSynapses(), numSynapses );
+    ASSERT_EQ( before, synapsesPerCell(c) );
+
+    vector<SynapseIdx> potential(c.segmentFlatListLength());
+    const auto connected = c.computeActivity(potential, presyn.getSparse());
+    ASSERT_EQ( segmentRemap.size(), oldLength );
+    for(Segment seg = 0; seg < oldLength; seg++) {
+      const Segment newSeg = segmentRemap[seg];
+      if( newSeg == std::numeric_limits<Segment>::max() ) continue;
+      ASSERT_LT( newSeg, numSegments );
+      ASSERT_EQ( connectedBefore[seg], connected[newSeg] );
+      ASSERT_EQ( potentialBefore[seg], potential[newSeg] );
+    }
+    size_t liveSynapses = 0;
+    for(const auto syn : synapseRemap) {
+      if( syn != std::numeric_limits<Synapse>::max() ) liveSynapses++;
+    }
+    ASSERT_EQ( liveSynapses, numSynapses );
+
+    // Learning works as usual on the compacted Connections.
+    const Segment seg = c.createSegment(7u);
+    c.createSynapse(seg, 3u, 0.45f);
+    c.adaptSegment(seg, presyn, 0.1f, 0.1f);
+    ASSERT_EQ( c.numSegments(), numSegments + 1u );
+  }
+}
+
+TEST(ConnectionsTest, testAutoCompact) {
+  Connections c(100u);
+  EXPECT_ANY_THROW( c.setAutoCompact(-0.1f) );
+  EXPECT_ANY_THROW( c.setAutoCompact(1.1f) );
+  c.setAutoCompact(0.25f);
+  ASSERT_EQ( c.getAutoCompact(), 0.25f );
+
+  for(CellIdx cell = 0; cell < 8u; cell++) {
+    const Segment seg = c.createSegment(cell);
+    c.createSynapse(seg, cell + 10u, 0.6f);
+  }
+  vector<SynapseIdx> connected, potential;
+  vector<Segment> touched;
+  const vector<CellIdx> active = {10u, 11u, 12u, 13u, 14u, 15u, 16u, 17u};
+  c.computeActivity(connected, potential, touched, active);
+  ASSERT_EQ( touched.size(), 8u );
+
+  // 2 of 8 destroyed is not more than the fraction.
+  c.destroySegment(0u);
+  c.destroySegment(1u);
+  c.computeActivity(connected, potential, touched, active);
+  ASSERT_EQ( c.segmentFlatListLength(), 8u );
+  ASSERT_EQ( touched.size(), 6u );
+
+  c.destroySegment(2u);
+  c.computeActivity(connected, potential, touched, active);
+  ASSERT_EQ( c.segmentFlatListLength(), 5u );
+  ASSERT_EQ( connected, vector<SynapseIdx>(5u, 1u) );
+  ASSERT_EQ( potential, vector<SynapseIdx>(5u, 1u) );
+  ASSERT_EQ( touched.size(), 5u );
+}
+
+/**
+ * adaptSegment on long segments, with synapses to the last cells of the input
+ * and permanences at both ends of the range.
+ */
+TEST(ConnectionsTest, testAdaptSegmentBulk) {
+  for(const bool packed : {false, true}) {
+    for(const UInt numCells : {3u, 37u, 1000u}) {
+      Connections c(numCells, 0.5f, false, packed);
+      Random rng(numCells);
+      const Segment seg = c.createSegment(0u);
+      vector<CellIdx> cells(numCells);
+      std::iota(cells.begin(), cells.end(), 0u);
+      rng.shuffle(cells.begin(), cells.end());
+      map<CellIdx, Permanence> expected;
+      for(const auto cell : cells) {
+        const Permanence perm = static_cast<Permanence>(rng.getUInt32(21u)) / 20.0f;
+        c.createSynapse(seg, cell, perm);
+        expected[cell] = perm;
+      }
+      SDR input({ numCells });
+      input.randomize(0.5f, rng);
+      c.adaptSegment(seg, input, 0.08f, 0.03f);
+
+      for(auto &pre : expected) {
+        pre.second += input.getDense()[pre.first] ? 0.08f : -0.03f;
+        pre.second = std::max(std::min(pre.second, maxPermanence), minPermanence);
+      }
+      map<CellIdx, Permanence> actual;
+      size_t numConnected = 0;
+      for(const auto syn : c.synapsesForSegment(seg)) {
+        actual[c.dataForSynapse(syn).presynapticCell] = c.dataForSynapse(syn).permanence;
+        if( c.dataForSynapse(syn).permanence >= 0.5f ) numConnected++;
+      }
+      ASSERT_EQ( expected, actual );
+      ASSERT_EQ( numConnected, c.dataForSegment(seg).numConnected );
+    }
+  }
+}
+
+/**
+ * createSynapses is the same as calling createSynapse for each cell, with
+ * and without the fast path for new segments & sorted, unique cells.
+ */
+TEST(ConnectionsTest, testCreateSynapses) {
+  for(const bool packed : {false, true}) {
+    Connections bulk(100u, 0.5f, false, packed);
+    Connections single(100u, 0.5f, false, packed);
+    Random rng(packed ? 5 : 6);
+    for(UInt i = 0; i < 20u; i++) {
+      const CellIdx cell = rng.getUInt32(10u);
+      const Segment segBulk   = bulk.createSegment(cell);
+      const Segment segSingle = single.createSegment(cell);
+      ASSERT_EQ(segSingle, segBulk);
+
+      vector<CellIdx> presyns = rng.sample<CellIdx>(vector<CellIdx>{10, 11, 12, 20, 33, 34, 50, 70, 98, 99}, 1u + rng.getUInt32(10u));
+      if( i % 3 == 0 ) {
+        std::sort(presyns.begin(), presyns.end()); // Fast path
+      } else if( i % 3 == 1 ) {
+        presyns.push_back(presyns[0]); // Duplicate
+      }
+      vector<Permanence> permanences;
+      for(size_t p = 0; p < presyns.size(); p++) {
+        permanences.push_back(static_cast<Permanence>(rng.getReal64()));
+      }
+      for(UInt round = 0; round < (i % 4 == 3 ? 2u : 1u); round++) { // Existing synapses
+        bulk.createSynapses(segBulk, presyns, permanences);
+        for(size_t p = 0; p < presyns.size(); p++) {
+          single.createSynapse(segSingle, presyns[p], permanences[p]);
+        }
+      }
+      ASSERT_EQ(single.synapsesForSegment(segSingle), bulk.synapsesForSegment(segBulk));
+    }
+    ASSERT_EQ(single, bulk);
+
+    SDR input({100u});
+    input.randomize(0.3f, rng);
+    ASSERT_EQ(single.computeActivity(input.getSparse(), false), bulk.computeActivity(input.getSparse(), false));
+  }
+  Connections c(10u, 0.5f);
+  EXPECT_ANY_THROW(c.createSynapses(c.createSegment(0u), {1u, 2u}, {0.5f}));
+}
+
+TEST(ConnectionsTest, testComputeActivityBatch) {
+  Random rng(8);
+  Connections connections(20u, 0.5f);
+  for(UInt i = 0; i < 40u; i++) {
+    const Segment segment = connections.createSegment(rng.getUInt32(20u));
+    for(UInt j = 0; j < 10u; j++) {
+      connections.createSynapse(segment, rng.getUInt32(60u), static_cast<Permanence>(rng.getReal64()));
+    }
+  }
+
+  vector<SDR> inputs(5u, SDR({70u})); // Some inputs have no synapses.
+  for(auto &input : inputs) {
+    input.randomize(0.2f, rng);
+  }
+  vector<vector<SynapseIdx>> counts;
+  connections.computeActivityBatch(counts, inputs.data(), inputs.size());
+  ASSERT_EQ(inputs.size(), counts.size());
+  for(size_t i = 0; i < inputs.size(); i++) {
+    ASSERT_EQ(connections.computeActivity(inputs[i].getSparse(), false), counts[i]);
+  }
+}
+
+/**
+ * adaptSegments & bumpSegments on many threads are the same as the single
+ * segment methods, including the order of the presynaptic maps.
+ */
+TEST(ConnectionsTest, testAdaptSegments) {
+  for(const bool packed : {false, true}) {
+    Random rng(packed ? 11 : 12);
+    Connections single(50u, 0.5f);
+    single.setPackedSynapses(packed);
+    for(UInt i = 0; i < 30u; i++) {
+      const Segment segment = single.createSegment(i);
+      for(UInt j = 0; j < 15u; j++) {
+        single.createSynapse(segment, rng.getUInt32(80u), static_cast<Permanence>(rng.getReal64()));
+      }
+    }
+    Connections threaded = single;
+    threaded.setNumThreads(3u);
+
+    SDR input({80u});
+    for(UInt step = 0; step < 10u; step++) {
+      input.randomize(0.2f, rng);
+      vector<Segment> segments;
+      for(Segment seg = 0; seg < 30u; seg++) {
+        if( rng.getReal64() < 0.5 ) segments.push_back(seg);
+      }
+      const Permanence delta = step % 2 == 0 ? 0.07f : -0.05f;
+      for(const auto segment : segments) {
+        single.adaptSegment(segment, input, 0.1f, 0.04f);
+        single.raisePermanencesToThreshold(segment, 8u);
+      }
+      for(const auto segment : segments) {
+        single.bumpSegment(segment, delta);
+      }
+      threaded.adaptSegments(segments, input, 0.1f, 0.04f, 8u);
+      threaded.bumpSegments(segments, delta);
+      ASSERT_EQ(single, threaded) << "step " << step;
+    }
+  }
+}
+
+/**
+ * Segments adapted on the threads of the owner and applied in order are the
+ * same as adaptSegment, with pruning and with other changes in between.
+ */
+TEST(ConnectionsTest, testAdaptSegmentDeferred) {
+  for(const bool packed : {false, true}) {
+    Random rng(packed ? 13 : 14);
+    Connections single(50u, 0.5f);
+    single.setPackedSynapses(packed);
+    for(UInt i = 0; i < 30u; i++) {
+      const Segment segment = single.createSegment(i);
+      for(UInt j = 0; j < 15u; j++) {
+        single.createSynapse(segment, rng.getUInt32(80u), static_cast<Permanence>(rng.getReal64()));
+      }
+    }
+    Connections threaded = single;
+    threaded.setNumThreads(3u);
+    ThreadPool &pool = *threaded.getThreadPool();
+
+    SDR input({80u});
+    vector<CellIdx> candidates(50u);
+    std::iota(candidates.begin(), candidates.end(), 0u);
+    for(UInt step = 0; step < 10u; step++) {
+      input.randomize(0.2f, rng);
+      vector<Segment> segments;
+      for(CellIdx cell = 0; cell < 30u; cell++) {
+        for(const auto segment : single.segmentsForCell(cell)) {
+          if( rng.getReal64() < 0.5 ) segments.push_back(segment);
+        }
+      }
+      Random growSingle(step);
+      for(const auto segment : segments) {
+        single.adaptSegment(segment, input, 0.1f, 0.2f, true, 5u);
+        if( single.numSynapses(segment) > 0u ) {
+          single.growSynapses(segment, candidates, 0.21f, growSingle, 2u, 20u);
+        }
+      }
+
+      Random growThreaded(step);
+      vector<UInt> chunkOf(segments.size());
+      input.getDense();
+      threaded.prepareDeferredAdaptations();
+      pool.parallelFor(segments.size(), [&](size_t begin, size_t end, UInt chunk) {
+        for(size_t i = begin; i < end; i++) {
+          threaded.adaptSegmentDeferred(segments[i], input, 0.1f, 0.2f, true, 5u, chunk);
+          chunkOf[i] = chunk;
+        }
+      });
+      for(size_t i = 0; i < segments.size(); i++) {
+        threaded.applyDeferredAdaptation(chunkOf[i]);
+        if( threaded.numSynapses(segments[i]) > 0u ) {
+          threaded.growSynapses(segments[i], candidates, 0.21f, growThreaded, 2u, 20u);
+        }
+      }
+      ASSERT_EQ(single, threaded) << "step " << step;
+    }
+    ASSERT_LT(single.numSegments(), 30u); // some segments were pruned
+  }
+}
@@ -0,0 +1,144 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for FrozenSpatialPooler
+ */
+
+#include "gtest/gtest.h"
+#include <htm/algorithms/FrozenSpatialPooler.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace htm;
+
+// Trains an SP on random inputs.
+static void train(SpatialPooler &sp, Random &rng, UInt numSteps) {
+  SDR input(sp.getInputDimensions());
+  SDR active(sp.getColumnDimensions());
+  for(UInt i = 0; i < numSteps; i++) {
+    input.randomize(0.1f, rng);
+    sp.compute(input, true, active);
+  }
+}
+
+/**
+ * The frozen model computes the same as the SP without learning, for global
+ * & local inhibition, with & without boosting and a stimulus threshold.
+ */
+TEST(FrozenSpatialPoolerTest, testSameAsSpatialPooler) {
+  Random rng(42);
+  for(int trial = 0; trial < 8; trial++) {
+    const bool global = trial % 2 == 0;
+    SpatialPooler sp(
+      /*inputDimensions*/ {10, 10},
+      /*columnDimensions*/ {20, 20},
+      /*potentialRadius*/ 4,
+      /*potentialPct*/ 0.5f,
+      /*globalInhibition*/ global,
+      /*localAreaDensity*/ global ? 0.04f : 0.1f,
+      /*numActiveColumnsPerInhArea */ 0,
+      /*stimulusThreshold*/ (trial / 2) % 2 == 0 ? 0 : 2,
+      /*synPermInactiveDec*/ 0.01f,
+      /*synPermActiveInc*/ 0.05f,
+      /*synPermConnected*/ 0.2f,
+      /*minPctOverlapDutyCycles*/ 0.001f,
+      /*dutyCyclePeriod*/ 50,
+      /*boostStrength*/ trial / 4 == 0 ? 0.0f : 3.0f,
+      /*seed*/ trial + 1,
+      /*spVerbosity*/ 0,
+      /*wrapAround*/ trial % 3 != 0);
+    train(sp, rng, 60u);
+
+    FrozenSpatialPooler frozen(sp);
+    ASSERT_EQ(sp.getColumnDimensions(), frozen.getColumnDimensions());
+    UInt numConnected = 0u;
+    vector<UInt> connectedCounts(sp.getNumColumns());
+    sp.getConnectedCounts(connectedCounts.data());
+    for(const auto count : connectedCounts) numConnected += count;
+    ASSERT_EQ(numConnected, frozen.numConnectedSynapses());
+
+    SDR input(sp.getInputDimensions());
+    SDR expected(sp.getColumnDimensions());
+    SDR active(sp.getColumnDimensions());
+    for(int i = 0; i < 20; i++) {
+      input.randomize(i % 5 == 0 ? 0.02f : 0.1f, rng);
+      const auto expectedOverlaps = sp.compute(input, false, expected);
+      const auto &overlaps = frozen.compute(input, active);
+      ASSERT_EQ(expectedOverlaps, overlaps) << "trial " << trial;
+      ASSERT_EQ(expected, active) << "trial " << trial;
+    }
+  }
+}
+
+
+TEST(FrozenSpatialPoolerTest, testBatch) {
+  Random rng(7);
+  SpatialPooler sp({100}, {400}, 16, 0.5f, true, 0.05f);
+  train(sp, rng, 30u);
+  FrozenSpatialPooler frozen(sp);
+
+  vector<SDR> inputs(25u, SDR({100}));
+  for(auto &input : inputs) {
+    input.randomize(0.1f, rng);
+  }
+  vector<SDR> expected(inputs.size(), SDR({400}));
+  for(size_t i = 0; i < inputs.size(); i++) {
+    frozen.compute(inputs[i], expected[i]);
+  }
+
+  for(const UInt numThreads : {1u, 3u}) {
+    frozen.setNumThreads(numThreads);
+    ASSERT_EQ(numThreads, frozen.getNumThreads());
+    vector<SDR> actives(inputs.size(), SDR({400}));
+    frozen.compute(inputs, actives);
+    for(size_t i = 0; i < inputs.size(); i++) {
+      ASSERT_EQ(expected[i], actives[i]) << "input " << i;
+    }
+  }
+
+  vector<SDR> tooFew(inputs.size() - 1u, SDR({400}));
+  EXPECT_ANY_THROW(frozen.compute(inputs, tooFew));
+}
+
+
+TEST(FrozenSpatialPoolerTest, testSerialization) {
+  Random rng(3);
+  SpatialPooler sp({20, 20}, {15, 15}, 5, 0.5f, false, 0.1f);
+  sp.setBoostStrength(2.0f);
+  train(sp, rng, 30u);
+  FrozenSpatialPooler frozen(sp);
+
+  stringstream ss;
+  frozen.save(ss);
+  FrozenSpatialPooler loaded;
+  loaded.load(ss);
+  ASSERT_EQ(frozen, loaded);
+
+  SDR input({20, 20});
+  SDR active1({15, 15}), active2({15, 15});
+  for(int i = 0; i < 10; i++) {
+    input.randomize(0.1f, rng);
+    frozen.compute(input, active1);
+    loaded.compute(input, active2);
+    ASSERT_EQ(active1, active2);
+  }
+}
+
+} // namespace testing
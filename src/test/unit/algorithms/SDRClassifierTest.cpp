@@ -196,6 +196,40 @@ TEST(SDRClassifierTest, MultipleCategories) {
 }
 
 
+TEST(SDRClassifierTest, Batch) {
+  // Learning & inferring a batch is the same as one pattern at a time.
+  Classifier c1(0.1f), c2(0.1f), c3(0.1f);
+  SDRBatch patterns({ 20 });
+  patterns.push_back(SDR_sparse_t({ 1u, 3u, 5u }));
+  patterns.push_back(SDR_sparse_t({ 2u, 4u, 19u }));
+  patterns.push_back(SDR_sparse_t({ 0u, 3u }));
+  const vector<UInt> categories{ 0u, 4u, 2u };
+  const vector<vector<UInt>> categoryLists{ { 0u }, { 4u }, { 2u } };
+
+  SDR pattern({ 20 });
+  for (auto i = 0u; i < 10u; i++) {
+    for (size_t p = 0u; p < patterns.size(); p++) {
+      patterns.getSDR(p, pattern);
+      c1.learn(pattern, categories[p]);
+    }
+    c2.learn(patterns, categories);
+    c3.learn(patterns, categoryLists);
+  }
+  ASSERT_EQ(c1, c2);
+  ASSERT_EQ(c1, c3);
+
+  const auto pdfs = c2.infer(patterns);
+  ASSERT_EQ(pdfs.size(), patterns.size());
+  for (size_t p = 0u; p < patterns.size(); p++) {
+    patterns.getSDR(p, pattern);
+    ASSERT_EQ(pdfs[p], c1.infer(pattern));
+    ASSERT_EQ(argmax(pdfs[p]), categories[p]);
+  }
+
+  ASSERT_ANY_THROW(c2.learn(patterns, vector<UInt>{ 1u }));
+}
+
+
 TEST(SDRClassifierTest, SaveLoad) {
   vector<UInt> steps{ 1u };
   Predictor c1(steps, 0.1f);
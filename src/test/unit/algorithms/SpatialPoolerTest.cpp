@@ -996,8 +996,10 @@ TEST(SpatialPoolerTest, testUpdateBoostFactors) {
   {
   Real32 initActiveDutyCycles3[] = {0.1f, 0.3f, 0.02f, 0.04f, 0.7f, 0.12f};
   Real initBoostFactors3[] = {0, 0, 0, 0, 0, 0};
-  const vector<Real32> trueBoostFactors3 = {1.28586f, 0.795669f, 1.40094f,
-	                                    1.62534f, 0.367879f, 1.16682f};
+  // The neighborhood of every column is the whole of the 6 columns, so the
+  // target density is the mean duty cycle 0.21333
+  const vector<Real32> trueBoostFactors3 = {1.254412f, 0.840857f, 1.472066f,
+	                                    1.414345f, 0.377822f, 1.205225f};
   vector<Real32> resultBoostFactors3(6, 0);
   sp.setWrapAround(true);
   sp.setGlobalInhibition(false);
@@ -1195,6 +1197,143 @@ TEST(SpatialPoolerTest, testInhibitColumnsGlobal) {
 }
 
 
+/**
+ * The selection of inhibitColumnsGlobal_ is the same as sorting all of the
+ * columns by (overlap, index), for integer and real overlaps, with and
+ * without candidates.
+ */
+TEST(SpatialPoolerTest, testInhibitColumnsGlobalSelection) {
+  const UInt numColumns = 200u;
+  SpatialPooler sp({100u}, {numColumns});
+  sp.setGlobalInhibition(true);
+  Random rng(17);
+  for(int trial = 0; trial < 200; trial++) {
+    const bool integral = trial % 2;
+    const Real density  = 0.02f + 0.01f * (trial % 10);
+    const Real fraction = 0.05f * (trial % 8); // of columns with overlap
+    sp.setStimulusThreshold(trial % 3 == 0 ? 0u : 2u);
+
+    vector<Real> overlaps(numColumns, 0.0f);
+    vector<CellIdx> candidates;
+    for(CellIdx column = 0; column < numColumns; column++) {
+      if( rng.getReal64() >= fraction ) continue;
+      const UInt overlap = 1u + rng.getUInt32(integral ? 5u : 1000u);
+      overlaps[column] = integral ? static_cast<Real>(overlap) : overlap / 7.0f;
+      candidates.push_back(column);
+    }
+    rng.shuffle(candidates.begin(), candidates.end());
+
+    // Expected: sort everything, take the top, drop sub-threshold columns.
+    vector<CellIdx> expected(numColumns);
+    std::iota(expected.begin(), expected.end(), 0u);
+    std::sort(expected.begin(), expected.end(), [&](CellIdx a, CellIdx b) {
+      return overlaps[a] == overlaps[b] ? a > b : overlaps[a] > overlaps[b]; });
+    expected.resize(static_cast<UInt>(density * numColumns));
+    while( !expected.empty() && overlaps[expected.back()] < sp.getStimulusThreshold() )
+      expected.pop_back();
+
+    ASSERT_EQ(expected, sp.inhibitColumnsGlobal_(overlaps, density)) << "trial " << trial;
+    ASSERT_EQ(expected, sp.inhibitColumnsGlobal_(overlaps, density, &candidates)) << "trial " << trial;
+  }
+}
+
+
+/**
+ * Local inhibition selects the same columns as scanning every neighborhood:
+ * a column wins if fewer than the desired number of its neighbors have a
+ * bigger overlap, or an equal overlap and were already selected.
+ */
+TEST(SpatialPoolerTest, testInhibitColumnsLocalSelection) {
+  Random rng(23);
+  const vector<vector<UInt>> topologies = {{60}, {7}, {12, 9}, {5, 17}, {4, 3, 6}};
+  for(int trial = 0; trial < 120; trial++) {
+    const auto &dims = topologies[trial % topologies.size()];
+    const bool wrap  = (trial / topologies.size()) % 2;
+    const UInt radius = 1u + rng.getUInt32(8u);
+    const bool integral = trial % 3 != 0;
+    const Real density  = 0.25f + 0.05f * rng.getUInt32(8u);
+
+    SpatialPooler sp(vector<UInt>(dims.size(), 4u), dims, 16u, 0.5f, false, 0.5f);
+    sp.setWrapAround(wrap);
+    sp.setInhibitionRadius(radius);
+    sp.setStimulusThreshold(trial % 4 == 0 ? 0u : 1u);
+    const UInt numColumns = sp.getNumColumns();
+
+    vector<Real> overlaps(numColumns);
+    for(auto &overlap : overlaps) {
+      overlap = integral ? static_cast<Real>(rng.getUInt32(4u)) : rng.getUInt32(50u) / 7.0f;
+    }
+
+    vector<CellIdx> expected;
+    vector<bool> used(numColumns, false);
+    for(UInt column = 0; column < numColumns; column++) {
+      if( overlaps[column] < sp.getStimulusThreshold() ) continue;
+      UInt numNeighbors = 0u;
+      UInt bigger = 0u;
+      for(const auto neighbor : Neighborhood(column, radius, dims, wrap, /*skipCenter*/ true)) {
+        numNeighbors++;
+        if( overlaps[neighbor] > overlaps[column] ||
+           (overlaps[neighbor] == overlaps[column] && used[neighbor]) )
+          bigger++;
+      }
+      if( bigger < static_cast<UInt>(0.5f + density * (numNeighbors + 1)) ) {
+        expected.push_back(column);
+        used[column] = true;
+      }
+    }
+    ASSERT_EQ(expected, sp.inhibitColumnsLocal_(overlaps, density)) << "trial " << trial;
+
+    vector<CellIdx> candidates;
+    for(UInt column = 0; column < numColumns; column++) {
+      if( overlaps[column] > 0.0f ) candidates.push_back(column);
+    }
+    ASSERT_EQ(expected, sp.inhibitColumnsLocal_(overlaps, density, &candidates)) << "trial " << trial;
+  }
+}
+
+
+/**
+ * boostOverlaps_ finds the same candidates as checking every column, for
+ * any number of columns (not only multiples of the SIMD width).
+ */
+TEST(SpatialPoolerTest, testBoostOverlapsCandidates) {
+  Random rng(17);
+  for(int trial = 0; trial < 40; trial++) {
+    const UInt numColumns = 1u + rng.getUInt32(100u);
+    SpatialPooler sp({numColumns}, {numColumns}, 4u, 0.5f, true, 0.5f);
+    sp.setStimulusThreshold(rng.getUInt32(3u));
+    sp.setBoostStrength(trial % 4 == 0 ? 0.0f : 1.0f);
+    vector<Real> factors(numColumns);
+    for(auto &factor : factors) {
+      factor = static_cast<Real>(rng.getReal64() * 2.0);
+    }
+    sp.setBoostFactors(factors.data());
+
+    vector<SynapseIdx> overlaps(numColumns);
+    for(auto &overlap : overlaps) {
+      overlap = static_cast<SynapseIdx>(rng.getUInt32(5u));
+    }
+    vector<Real> boosted;
+    vector<CellIdx> candidates;
+    sp.boostOverlaps_(overlaps, boosted, &candidates);
+
+    vector<CellIdx> expected;
+    for(UInt column = 0; column < numColumns; column++) {
+      const Real factor = sp.getBoostStrength() > 0.0f ? factors[column] : 1.0f;
+      ASSERT_EQ(overlaps[column] * factor, boosted[column]) << "trial " << trial;
+      if( boosted[column] > 0.0f and boosted[column] >= sp.getStimulusThreshold() ) {
+        expected.push_back(column);
+      }
+    }
+    ASSERT_EQ(expected, candidates) << "trial " << trial;
+
+    vector<Real> boostedOnly;
+    sp.boostOverlaps_(overlaps, boostedOnly);
+    ASSERT_EQ(boosted, boostedOnly);
+  }
+}
+
+
 TEST(SpatialPoolerTest, testValidateGlobalInhibitionParameters) {
   // With 10 columns the minimum sparsity for global inhibition is 10%
   // Setting sparsity to 2% should throw an exception
@@ -1923,6 +2062,77 @@ TEST(SpatialPoolerTest, testSerialization2) {
 }
 
 
+TEST(SpatialPoolerTest, testLazyDutyCycles) {
+  SpatialPooler dense({100}, {50}), lazy({100}, {50});
+  for(auto sp : {&dense, &lazy}) {
+    sp->setGlobalInhibition(true);
+    sp->setBoostStrength(2.0f);
+    sp->setDutyCyclePeriod(10u); // folds the scale into the duty cycles often
+  }
+  lazy.setLazyDutyCycles(true);
+  ASSERT_TRUE(lazy.getLazyDutyCycles());
+
+  Random rng(3);
+  SDR overlapping({50}), active({50});
+  for(UInt step = 1; step <= 1000; step++) {
+    overlapping.randomize(0.3f, rng);
+    active.randomize(0.05f, rng);
+    for(auto sp : {&dense, &lazy}) {
+      sp->setIterationNum(step);
+      sp->updateDutyCycles_(overlapping.getSparse(), active.getSparse());
+      sp->updateBoostFactors_();
+    }
+  }
+
+  vector<Real> expected(50), actual(50);
+  dense.getOverlapDutyCycles(expected.data());
+  lazy.getOverlapDutyCycles(actual.data());
+  for(UInt i = 0; i < 50; i++) EXPECT_NEAR(expected[i], actual[i], 1.0e-5f);
+  dense.getActiveDutyCycles(expected.data());
+  lazy.getActiveDutyCycles(actual.data());
+  for(UInt i = 0; i < 50; i++) EXPECT_NEAR(expected[i], actual[i], 1.0e-5f);
+  dense.getBoostFactors(expected.data());
+  lazy.getBoostFactors(actual.data());
+  for(UInt i = 0; i < 50; i++) EXPECT_NEAR(expected[i], actual[i], 1.0e-4f);
+
+  // The true values are saved, and are kept when turning lazy off.
+  stringstream ss;
+  lazy.save(ss);
+  SpatialPooler loaded;
+  loaded.load(ss);
+  ASSERT_FALSE(loaded.getLazyDutyCycles());
+  EXPECT_EQ(lazy, loaded);
+  lazy.setLazyDutyCycles(false);
+  EXPECT_EQ(lazy, loaded);
+}
+
+
+TEST(SpatialPoolerTest, testLazyWeakColumns) {
+  // The weak columns tracked from step to step are the ones found from
+  // scratch.  Setting the minimum duty cycles makes the next step of `scratch`
+  // look at every column.
+  for(const bool global : {true, false}) {
+    SpatialPooler tracked({15, 15}, {30, 30}, 5, 0.5f, global, 0.05f, 0, 3, 0.02f, 0.05f, 0.3f, 0.1f, 20, 2.0f);
+    SpatialPooler scratch({15, 15}, {30, 30}, 5, 0.5f, global, 0.05f, 0, 3, 0.02f, 0.05f, 0.3f, 0.1f, 20, 2.0f);
+    tracked.setLazyDutyCycles(true);
+    scratch.setLazyDutyCycles(true);
+    SDR input({15, 15});
+    SDR out1({30, 30}), out2({30, 30});
+    vector<Real> minOverlapDutyCycles(scratch.getNumColumns());
+    Random rng(7);
+    for(UInt i = 0; i < 300u; i++) {
+      input.randomize(0.1f, rng);
+      tracked.compute(input, true, out1);
+      scratch.compute(input, true, out2);
+      ASSERT_EQ(out1, out2) << "step " << i;
+      scratch.getMinOverlapDutyCycles(minOverlapDutyCycles.data());
+      scratch.setMinOverlapDutyCycles(minOverlapDutyCycles.data());
+    }
+    EXPECT_EQ(tracked, scratch);
+  }
+}
+
+
 TEST(SpatialPoolerTest, testSaveLoad_ar) {
   const char *filename = "SpatialPoolerSerializationAR.tmp";
   SpatialPooler sp1, sp2;
@@ -2060,6 +2270,160 @@ TEST(SpatialPoolerTest, testConstructorVsInitialize) {
 }
 
 
+TEST(SpatialPoolerTest, testColumnRandomStreams) {
+  // The potential pools & permanences do not depend on the number of threads
+  // used to initialize them.
+  SpatialPooler sp1, sp3;
+  sp1.setColumnRandomStreams(true);
+  sp3.setColumnRandomStreams(true);
+  sp3.setNumThreads(3u);
+  ASSERT_TRUE(sp3.getColumnRandomStreams());
+  for(auto sp : {&sp1, &sp3}) {
+    sp->initialize(
+      /*inputDimensions*/ {40, 50},
+      /*columnDimensions*/ {50, 50},
+      /*potentialRadius*/ 7,
+      /*potentialPct*/ 0.5f,
+      /*globalInhibition*/ true,
+      /*localAreaDensity*/ 0.05f,
+      /*numActiveColumnsPerInhArea */ 0,
+      /*stimulusThreshold*/ 0,
+      /*synPermInactiveDec*/ 0.008f,
+      /*synPermActiveInc*/ 0.05f,
+      /*synPermConnected*/ 0.1f,
+      /*minPctOverlapDutyCycles*/ 0.001f,
+      /*dutyCyclePeriod*/ 1000,
+      /*boostStrength*/ 0.0f,
+      /*seed*/ 7,
+      /*spVerbosity*/ 0,
+      /*wrapAround*/ true);
+  }
+  EXPECT_EQ(sp1, sp3);
+
+  const auto &connections = sp1.getConnections();
+  for(UInt column = 0; column < sp1.getNumColumns(); column++) {
+    ASSERT_EQ(113u, connections.numSynapses(column)); // Half of 15x15, rounded
+    ASSERT_GE(connections.dataForSegment(column).numConnected, sp1.getStimulusThreshold());
+  }
+
+  SDR input({40, 50});
+  SDR out1({50, 50}), out3({50, 50});
+  Random rng(3);
+  for(UInt i = 0; i < 10u; i++) {
+    input.randomize(0.1f, rng);
+    sp1.compute(input, true, out1);
+    sp3.compute(input, true, out3);
+    ASSERT_EQ(out1, out3);
+  }
+}
+
+
+TEST(SpatialPoolerTest, testLearnThreads) {
+  // Learning on many threads gives the same SP as on one thread.  The
+  // stimulus threshold and the duty cycles make raisePermanencesToThreshold
+  // and bumpUpWeakColumns_ do some work.
+  SpatialPooler sp1({15, 15}, {30, 30}, 5, 0.5f, false, 0.05f, 0, 3, 0.02f, 0.05f, 0.3f, 0.1f, 20, 2.0f);
+  SpatialPooler sp3({15, 15}, {30, 30}, 5, 0.5f, false, 0.05f, 0, 3, 0.02f, 0.05f, 0.3f, 0.1f, 20, 2.0f);
+  sp3.setNumThreads(3u);
+  SDR input({15, 15});
+  SDR out1({30, 30}), out3({30, 30});
+  Random rng(5);
+  for(UInt i = 0; i < 60u; i++) {
+    input.randomize(0.1f, rng);
+    sp1.compute(input, true, out1);
+    sp3.compute(input, true, out3);
+    ASSERT_EQ(out1, out3) << "step " << i;
+  }
+  EXPECT_EQ(sp1, sp3);
+}
+
+
+TEST(SpatialPoolerTest, testComputeBatch) {
+  Random rng(11);
+  for(const bool global : {true, false}) {
+    SpatialPooler sp1({12, 12}, {20, 20}, 4, 0.5f, global, 0.1f, 0, 1, 0.01f, 0.05f, 0.2f, 0.001f, 50, 2.0f);
+    SpatialPooler sp2({12, 12}, {20, 20}, 4, 0.5f, global, 0.1f, 0, 1, 0.01f, 0.05f, 0.2f, 0.001f, 50, 2.0f);
+
+    // With learning the batch is the same as computing each input in turn.
+    vector<SDR> inputs(40u, SDR({12, 12}));
+    for(auto &input : inputs) {
+      input.randomize(0.1f, rng);
+    }
+    vector<SDR> actives(inputs.size(), SDR({20, 20}));
+    SDR active({20, 20});
+    for(const auto &input : inputs) {
+      sp1.compute(input, true, active);
+    }
+    sp2.compute(inputs, true, actives);
+    ASSERT_EQ(active, actives.back());
+    ASSERT_EQ(sp1, sp2);
+
+    // Without learning, for any number of threads, also with lazily computed
+    // boost factors.
+    sp2.setLazyDutyCycles(true);
+    for(auto &input : inputs) {
+      input.randomize(0.1f, rng);
+    }
+    for(auto sp : {&sp1, &sp2}) {
+      vector<SDR> expected(inputs.size(), SDR({20, 20}));
+      for(size_t i = 0; i < inputs.size(); i++) {
+        sp->compute(inputs[i], false, expected[i]);
+      }
+      for(const UInt numThreads : {1u, 3u}) {
+        sp->setNumThreads(numThreads);
+        sp->compute(inputs, false, actives);
+        for(size_t i = 0; i < inputs.size(); i++) {
+          ASSERT_EQ(expected[i], actives[i]) << "input " << i;
+        }
+      }
+    }
+    EXPECT_EQ(inputs.size() * 4u, sp1.getIterationNum());
+  }
+}
+
+
+TEST(SpatialPoolerTest, testComputeSDRBatch) {
+  Random rng(13);
+  SpatialPooler sp1({12, 12}, {20, 20}, 4, 0.5f, true, 0.1f, 0, 1, 0.01f, 0.05f, 0.2f, 0.001f, 50, 2.0f);
+  SpatialPooler sp2({12, 12}, {20, 20}, 4, 0.5f, true, 0.1f, 0, 1, 0.01f, 0.05f, 0.2f, 0.001f, 50, 2.0f);
+  SDRBatch inputs({144});
+  vector<SDR> inputSDRs(30u, SDR({12, 12}));
+  for(auto &input : inputSDRs) {
+    input.randomize(0.1f, rng);
+    inputs.push_back(input);
+  }
+
+  // With learning, same as the batch of SDR objects.
+  vector<SDR> expected(inputs.size(), SDR({20, 20}));
+  SDRBatch actives;
+  sp1.compute(inputSDRs, true, expected);
+  sp2.compute(inputs, true, actives);
+  ASSERT_EQ(sp1, sp2);
+  ASSERT_EQ(sp1.getColumnDimensions(), actives.getDimensions());
+  ASSERT_EQ(inputs.size(), actives.size());
+  SDR active({20, 20});
+  for(size_t i = 0; i < inputs.size(); i++) {
+    actives.getSDR(i, active);
+    ASSERT_EQ(expected[i], active) << "input " << i;
+  }
+
+  // Without learning, the chunks of the threads are appended in order.
+  sp1.compute(inputSDRs, false, expected);
+  for(const UInt numThreads : {1u, 3u}) {
+    sp2.setNumThreads(numThreads);
+    sp2.compute(inputs, false, actives);
+    ASSERT_EQ(inputs.size(), actives.size());
+    for(size_t i = 0; i < inputs.size(); i++) {
+      actives.getSDR(i, active);
+      ASSERT_EQ(expected[i], active) << "input " << i << ", threads " << numThreads;
+    }
+  }
+
+  SDRBatch wrongSize({100});
+  EXPECT_ANY_THROW(sp2.compute(wrongSize, false, actives));
+}
+
+
 TEST(SpatialPoolerTest, ExactOutput) { 
   // Silver is an SDR that is loaded by direct initalization from a vector.
   SDR silver_sdr({ 200 });
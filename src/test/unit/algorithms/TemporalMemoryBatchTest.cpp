@@ -0,0 +1,105 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for TemporalMemoryBatch
+ */
+
+#include "gtest/gtest.h"
+#include <htm/algorithms/TemporalMemoryBatch.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace htm;
+
+// Random sequences of active columns, one per model and time step.
+static vector<vector<SDR>> makeInputs(UInt numModels, UInt numSteps) {
+  Random rng(99);
+  vector<vector<SDR>> inputs(numSteps, vector<SDR>(numModels, SDR({50})));
+  for(auto &step : inputs) {
+    for(auto &sdr : step) {
+      sdr.randomize(0.1f, rng);
+    }
+  }
+  return inputs;
+}
+
+/**
+ * Every model of the batch computes the same as a stand-alone TM with the
+ * corresponding seed.
+ */
+TEST(TemporalMemoryBatchTest, testSameAsTemporalMemory) {
+  const UInt numModels = 5u;
+  const auto inputs = makeInputs(numModels, 30u);
+
+  TemporalMemoryBatch batch(numModels, {50}, 4, 3, 0.21f, 0.5f, 2, 5);
+  vector<TemporalMemory*> tms;
+  for(UInt i = 0; i < numModels; i++) {
+    tms.push_back(new TemporalMemory({50}, 4, 3, 0.21f, 0.5f, 2, 5,
+                                     0.10f, 0.10f, 0.0f, 42 + i));
+  }
+
+  for(const auto &step : inputs) {
+    batch.compute(step, true);
+    for(UInt i = 0; i < numModels; i++) {
+      tms[i]->compute(step[i], true);
+    }
+  }
+  for(UInt i = 0; i < numModels; i++) {
+    EXPECT_EQ(*tms[i], batch[i]);
+    EXPECT_EQ(tms[i]->getActiveCells(), batch[i].getActiveCells());
+    EXPECT_EQ(tms[i]->anomaly, batch[i].anomaly);
+    delete tms[i];
+  }
+}
+
+TEST(TemporalMemoryBatchTest, testThreads) {
+  const UInt numModels = 7u;
+  const auto inputs = makeInputs(numModels, 30u);
+
+  TemporalMemoryBatch batch1(numModels, {50}, 4, 3, 0.21f, 0.5f, 2, 5);
+  TemporalMemoryBatch batch3(numModels, {50}, 4, 3, 0.21f, 0.5f, 2, 5);
+  batch3.setNumThreads(3u);
+  ASSERT_EQ(3u, batch3.getNumThreads());
+
+  for(const auto &step : inputs) {
+    batch1.compute(step, true);
+    batch3.compute(step, true);
+  }
+  batch1.reset();
+  batch3.reset();
+  for(const auto &step : inputs) {
+    batch1.compute(step, false);
+    batch3.compute(step, false);
+    for(UInt i = 0; i < numModels; i++) {
+      ASSERT_EQ(batch1[i].getActiveCells(), batch3[i].getActiveCells());
+    }
+  }
+  for(UInt i = 0; i < numModels; i++) {
+    EXPECT_EQ(batch1[i], batch3[i]);
+  }
+}
+
+TEST(TemporalMemoryBatchTest, testWrongNumberOfInputs) {
+  TemporalMemoryBatch batch(3u, {50});
+  vector<SDR> inputs(2u, SDR({50}));
+  EXPECT_ANY_THROW(batch.compute(inputs, true));
+}
+
+} // namespace testing
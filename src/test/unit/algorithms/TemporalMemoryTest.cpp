@@ -1365,6 +1365,15 @@ TEST(TemporalMemoryTest, testCellsToColumns)
   auto res = tm.cellsToColumns(v1);
   ASSERT_EQ(res.getSparse(), expected);
 
+  SDR columns(tm.getColumnDimensions()); // the overload writes into the columns
+  tm.cellsToColumns(v1, columns);
+  ASSERT_EQ(columns.getSparse(), expected);
+  v1.setSparse(SDR_sparse_t{0,1,2,8});
+  tm.cellsToColumns(v1, columns);
+  ASSERT_EQ(columns.getSparse(), (SDR_sparse_t{0u, 2u}));
+  SDR wrongColumns({4});
+  EXPECT_ANY_THROW(tm.cellsToColumns(v1, wrongColumns));
+
   v1.setSparse(SDR_sparse_t{}); // empty sparse array
   res = tm.cellsToColumns(v1);
   EXPECT_TRUE(res.getSparse().empty());
@@ -1662,6 +1671,202 @@ TEST(TemporalMemoryTest, testIncorrectDefaultConstructor) {
   EXPECT_NO_THROW(tmOk.compute(data2, true));
 }
 
+/**
+ * activateDendrites only looks at the segments which received input, and
+ * orders them by cell.  Use enough segments to exercise the radix sort.
+ */
+TEST(TemporalMemoryTest, testManyActiveSegmentsSorted) {
+  TemporalMemory tm(
+      /*columnDimensions*/ {256},
+      /*cellsPerColumn*/ 8,
+      /*activationThreshold*/ 3,
+      /*initialPermanence*/ 0.21f,
+      /*connectedPermanence*/ 0.50f,
+      /*minThreshold*/ 2,
+      /*maxNewSynapseCount*/ 3,
+      /*permanenceIncrement*/ 0.10f,
+      /*permanenceDecrement*/ 0.10f,
+      /*predictedSegmentDecrement*/ 0.0f,
+      /*seed*/ 42);
+
+  // Segments are created on cells in random order, with 0 to 7 synapses
+  // onto the cells of column 0.
+  Random rng(7);
+  vector<Segment> allSegments;
+  for(UInt i = 0; i < 3000u; i++) {
+    const Segment segment = tm.createSegment(8u + rng.getUInt32(tm.numberOfCells() - 8u));
+    const UInt numSynapses = rng.getUInt32(8u);
+    for(CellIdx presyn = 0; presyn < numSynapses; presyn++) {
+      tm.createSynapse(segment, presyn, rng.getReal64() < 0.5 ? 0.3f : 0.6f);
+    }
+    allSegments.push_back(segment);
+  }
+  // A column which bursts, activating all its cells.
+  SDR column0({256});
+  column0.setSparse(SDR_sparse_t{0});
+  tm.compute(column0, false);
+  tm.activateDendrites(false);
+
+  vector<Segment> expectedActive, expectedMatching;
+  for(const Segment segment : allSegments) {
+    UInt connected = 0u, potential = 0u;
+    for(const Synapse synapse : tm.connections.synapsesForSegment(segment)) {
+      potential++;
+      if(tm.connections.dataForSynapse(synapse).permanence >= 0.5f) connected++;
+    }
+    if(connected >= 3u) expectedActive.push_back(segment);
+    if(potential >= 2u) expectedMatching.push_back(segment);
+  }
+  const auto compare = [&](const Segment a, const Segment b) { return tm.connections.compareSegments(a, b); };
+  std::sort(expectedActive.begin(),   expectedActive.end(),   compare);
+  std::sort(expectedMatching.begin(), expectedMatching.end(), compare);
+
+  ASSERT_GT(expectedActive.size(), 256u);
+  EXPECT_EQ(expectedActive,   tm.getActiveSegments());
+  EXPECT_EQ(expectedMatching, tm.getMatchingSegments());
+}
+
+/**
+ * A threshold of zero is valid: every segment passes it, also the segments
+ * without any active synapse.
+ */
+TEST(TemporalMemoryTest, testZeroThresholds) {
+  TemporalMemory tm(
+      /*columnDimensions*/ {32},
+      /*cellsPerColumn*/ 4,
+      /*activationThreshold*/ 1,
+      /*initialPermanence*/ 0.21f,
+      /*connectedPermanence*/ 0.50f,
+      /*minThreshold*/ 0,
+      /*maxNewSynapseCount*/ 3,
+      /*permanenceIncrement*/ 0.10f,
+      /*permanenceDecrement*/ 0.10f,
+      /*predictedSegmentDecrement*/ 0.0f,
+      /*seed*/ 42);
+
+  const Segment touched = tm.createSegment(4);
+  tm.createSynapse(touched, 0, 0.6f);
+  const Segment untouched = tm.createSegment(8);
+  tm.createSynapse(untouched, 100, 0.6f);
+  const Segment empty = tm.createSegment(12);
+
+  // A column which bursts, activating the cells 0 to 3.
+  SDR column0({32});
+  column0.setSparse(SDR_sparse_t{0});
+  tm.compute(column0, false);
+  tm.activateDendrites(false);
+  EXPECT_EQ(vector<Segment>({touched}), tm.getActiveSegments());
+  EXPECT_EQ(vector<Segment>({touched, untouched, empty}), tm.getMatchingSegments());
+
+  tm.setActivationThreshold(0);
+  tm.compute(column0, false);
+  tm.activateDendrites(false);
+  EXPECT_EQ(vector<Segment>({touched, untouched, empty}), tm.getActiveSegments());
+  EXPECT_EQ(vector<Segment>({touched, untouched, empty}), tm.getMatchingSegments());
+  EXPECT_EQ(vector<CellIdx>({4, 8, 12}), tm.getPredictiveCells().getSparse());
+}
+
+/**
+ * The multithreaded activateCells gives the same results, both when learning
+ * and for inference only.
+ */
+TEST(TemporalMemoryTest, testNumThreads) {
+  TemporalMemory tm1({100}, 4, 3, 0.21f, 0.5f, 2, 4,
+                     0.10f, 0.10f, /*predictedSegmentDecrement*/ 0.02f, 42);
+  TemporalMemory tm3({100}, 4, 3, 0.21f, 0.5f, 2, 4,
+                     0.10f, 0.10f, /*predictedSegmentDecrement*/ 0.02f, 42);
+  tm3.setNumThreads(3u);
+  ASSERT_EQ(3u, tm3.getNumThreads());
+
+  // A repeating sequence, so that columns get predicted.
+  Random rng(5);
+  vector<SDR> sequence(10, SDR({100}));
+  for(auto &sdr : sequence) sdr.randomize(0.05f, rng);
+
+  for(UInt epoch = 0; epoch < 20u; epoch++) {
+    for(const auto &columns : sequence) {
+      tm1.compute(columns, true);
+      tm3.compute(columns, true);
+      ASSERT_EQ(tm1.getActiveCells(), tm3.getActiveCells());
+      ASSERT_EQ(tm1.getWinnerCells(), tm3.getWinnerCells());
+    }
+  }
+  ASSERT_EQ(tm1, tm3);
+  ASSERT_LT(tm1.anomaly, 0.5f); // the sequence was learned, columns got predicted
+
+  for(auto &sdr : sequence) sdr.addNoise(0.4f, rng);
+  for(const auto &columns : sequence) {
+    tm1.compute(columns, false);
+    tm3.compute(columns, false);
+    ASSERT_EQ(tm1.getActiveCells(), tm3.getActiveCells());
+    ASSERT_EQ(tm1.getWinnerCells(), tm3.getWinnerCells());
+  }
+  EXPECT_EQ(tm1, tm3);
+}
+
+/**
+ * A bursting column picks the lowest cell among those with the fewest
+ * segments, also after segments are created and destroyed.
+ */
+TEST(TemporalMemoryTest, testLeastUsedCellFollowsSegments) {
+  TemporalMemory tm({4}, /*cellsPerColumn*/ 8);
+  SDR column1({4});
+  column1.setSparse(SDR_sparse_t{1});
+  const auto winner = [&]() {
+    tm.reset();
+    tm.compute(column1, false);
+    return tm.getWinnerCells().at(0);
+  };
+  EXPECT_EQ(8u, winner());
+
+  // Segments without synapses never match, the column always bursts.
+  tm.createSegment(8);
+  tm.createSegment(9);
+  EXPECT_EQ(10u, winner());
+  for(CellIdx cell = 10; cell < 16; cell++) tm.createSegment(cell);
+  EXPECT_EQ(8u, winner()); // all cells have 1 segment
+  const Segment s11 = tm.createSegment(11);
+  tm.createSegment(8);
+  EXPECT_EQ(9u, winner());
+  tm.destroySegment(s11);
+  EXPECT_EQ(9u, winner());
+  tm.destroySegment(tm.connections.segmentsForCell(13).at(0));
+  EXPECT_EQ(13u, winner());
+}
+
+/**
+ * With auto compaction the TM keeps working on the renumbered segments.
+ */
+TEST(TemporalMemoryTest, testAutoCompact) {
+  // Few segments per cell and a predicted segment decrement, so that many
+  // segments get destroyed.
+  TemporalMemory plain(    {50}, 4, 3, 0.21f, 0.5f, 2, 4, 0.1f, 0.1f, 0.05f, 42, 2);
+  TemporalMemory compacted({50}, 4, 3, 0.21f, 0.5f, 2, 4, 0.1f, 0.1f, 0.05f, 42, 2);
+  EXPECT_ANY_THROW(compacted.setAutoCompact(2.0f));
+  compacted.setAutoCompact(0.05f);
+  ASSERT_EQ(0.05f, compacted.getAutoCompact());
+
+  Random rng(11);
+  SDR columns({50});
+  for(int step = 0; step < 300; step++) {
+    columns.randomize(0.1f, rng);
+    plain.compute(columns, true);
+    compacted.compute(columns, true);
+    compacted.activateDendrites(true); // compacts, for the next step
+    const auto &c = compacted.connections;
+    for(const auto seg : compacted.getActiveSegments()) {
+      ASSERT_LT(seg, c.segmentFlatListLength());
+      ASSERT_FALSE(c.dataForSegment(seg).synapses.empty());
+    }
+    for(const auto seg : compacted.getMatchingSegments()) {
+      ASSERT_LT(seg, c.segmentFlatListLength());
+      ASSERT_FALSE(c.dataForSegment(seg).synapses.empty());
+    }
+  }
+  ASSERT_LT(compacted.connections.segmentFlatListLength(),
+            plain.connections.segmentFlatListLength());
+}
+
 // Uncomment these tests individually to save/load from a file.
 // This is useful for ad-hoc testing of backwards-compatibility.
 
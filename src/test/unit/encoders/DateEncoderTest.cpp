@@ -249,6 +249,37 @@ TEST(DateEncoderTest, combined) {
 }
 
 
+TEST(DateEncoderTest, encodeBatch) {
+  DateEncoderParameters p;
+  p.verbose = verbose;
+  p.season_width = 5;
+  p.dayOfWeek_width = 2;
+  p.weekend_width = 2;
+  p.holiday_width = 2;
+  p.holiday_dates = {{2020, 1, 1}, {7, 4}};
+  p.timeOfDay_width = 4;
+  p.timeOfDay_radius = 4;
+  DateEncoder encoder(p);
+
+  const std::vector<time_t> inputs{
+      DateEncoder::mktime(2020, 1, 1, 0, 0),
+      DateEncoder::mktime(2019, 12, 11, 14, 45),
+      DateEncoder::mktime(2019, 7, 4, 0, 0),
+      DateEncoder::mktime(1988, 5, 27, 20, 0)};
+  SDRBatch batch;
+  encoder.encodeBatch(inputs, batch);
+  ASSERT_EQ(batch.getDimensions(), encoder.dimensions);
+  ASSERT_EQ(batch.size(), inputs.size());
+  SDR expected(encoder.dimensions);
+  SDR actual(encoder.dimensions);
+  for (size_t i = 0; i < inputs.size(); i++) {
+    encoder.encode(inputs[i], expected);
+    batch.getSDR(i, actual);
+    EXPECT_EQ(expected, actual) << "input " << i;
+  }
+}
+
+
 TEST(DateEncoderTest, Serialization) {
   DateEncoderParameters p;
   p.verbose = verbose;
@@ -57,3 +57,74 @@ TEST(RDSE, testSerialize) {
 
   ASSERT_EQ( A, B );
 }
+
+TEST(RDSE, testEncodeBatch) {
+  RDSE_Parameters P;
+  P.size       = 1000;
+  P.activeBits = 20;
+  P.resolution = 0.5f;
+  P.seed       = 7;
+  RDSE R( P );
+
+  const std::vector<Real64> inputs{ 0.0, 0.3, 10.0, 123.4, std::nan(""), 0.3, 1e6 };
+  SDRBatch batch;
+  R.encodeBatch( inputs, batch );
+  ASSERT_EQ( batch.getDimensions(), R.dimensions );
+  ASSERT_EQ( batch.size(), inputs.size() );
+  SDR expected( R.dimensions );
+  SDR actual( R.dimensions );
+  for( size_t i = 0; i < inputs.size(); i++ ) {
+    R.encode( inputs[i], expected );
+    batch.getSDR( i, actual );
+    EXPECT_EQ( expected, actual ) << "input " << inputs[i];
+    // Hash collisions can only remove bits.
+    EXPECT_LE( actual.getSum(), P.activeBits );
+  }
+  ASSERT_TRUE( batch[4].empty() ); // NaN
+  ASSERT_GT( batch[0].size(), 15u );
+}
+
+TEST(RDSE, testCache) {
+  RDSE_Parameters P;
+  P.size       = 1000;
+  P.activeBits = 20;
+  P.resolution = 1.0f;
+  P.seed       = 11;
+  RDSE R1( P );
+  RDSE R2( P );
+  ASSERT_EQ( R2.getCacheSize(), 0u );
+  // Room for 4 buckets.
+  const size_t slotBytes = 8u + 4u + P.activeBits * 4u;
+  R2.setCacheSize( 4u * slotBytes + 1u );
+  ASSERT_EQ( R2.getCacheSize(), 4u * slotBytes + 1u );
+
+  // The cache does not change the encodings.
+  const std::vector<Real64> inputs{ 1.0, 1.5, 2.0, 1.2, std::nan(""), 5.0, 1.9, 2.3, 9.0, 5.1 };
+  SDR A( R1.dimensions );
+  SDR B( R2.dimensions );
+  for( const auto input : inputs ) {
+    R1.encode( input, A );
+    R2.encode( input, B );
+    ASSERT_EQ( A, B ) << "input " << input;
+  }
+  // Buckets 1, 5 and 9 share a slot and replace each other.
+  EXPECT_EQ( R2.getCacheHits(),   3u ); // 1.5, 1.2, 2.3
+  EXPECT_EQ( R2.getCacheMisses(), 6u ); // 1.0, 2.0, 5.0, 1.9, 9.0, 5.1
+  EXPECT_EQ( R1.getCacheHits() + R1.getCacheMisses(), 0u );
+
+  // The batch uses the same cache.
+  SDRBatch expected, batch;
+  R1.encodeBatch( inputs, expected );
+  R2.encodeBatch( inputs, batch );
+  ASSERT_EQ( expected, batch );
+  EXPECT_EQ( R2.getCacheHits(), 3u + 4u ); // 1.5, 2.0, 1.2, 2.3
+
+  R2.resetCacheCounters();
+  EXPECT_EQ( R2.getCacheHits() + R2.getCacheMisses(), 0u );
+
+  // Too small for one bucket disables the cache.
+  R2.setCacheSize( slotBytes - 1u );
+  R2.encode( 1.0, B );
+  R2.encode( 1.0, B );
+  EXPECT_EQ( R2.getCacheHits() + R2.getCacheMisses(), 0u );
+}
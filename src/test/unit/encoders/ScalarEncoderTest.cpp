@@ -180,6 +180,40 @@ TEST(ScalarEncoder, PeriodicRoundNearestMultipleOfResolution) {
   doScalarValueCases(encoder, cases);
 }
 
+TEST(ScalarEncoder, EncodeBatch) {
+  for( const bool periodic : {false, true} ) {
+    ScalarEncoderParameters p;
+    p.minimum    = -2.0;
+    p.maximum    = 8.0;
+    p.size       = 25;
+    p.activeBits = 4;
+    p.periodic   = periodic;
+    ScalarEncoder e( p );
+
+    const std::vector<Real64> inputs{ -2.0, 8.0, 0.1, 7.9, 3.3, std::nan(""), 5.0, 5.0 };
+    SDRBatch batch;
+    e.encodeBatch( inputs, batch );
+    ASSERT_EQ( batch.getDimensions(), e.dimensions );
+    ASSERT_EQ( batch.size(), inputs.size() );
+    SDR expected( e.dimensions );
+    SDR actual( e.dimensions );
+    for( size_t i = 0; i < inputs.size(); i++ ) {
+      e.encode( inputs[i], expected );
+      batch.getSDR( i, actual );
+      EXPECT_EQ( expected, actual ) << "input " << inputs[i] << ", periodic " << periodic;
+    }
+    ASSERT_TRUE( batch[5].empty() ); // NaN
+
+    // Refilling the batch replaces its contents.
+    e.encodeBatch( inputs.data(), 2u, batch );
+    ASSERT_EQ( batch.size(), 2u );
+
+    const std::vector<Real64> outOfRange{ 1.0, 9.0 };
+    EXPECT_ANY_THROW( e.encodeBatch( outOfRange, batch ) );
+  }
+}
+
+
 TEST(ScalarEncoder, Serialization) {
   std::vector<ScalarEncoder*> inputs;
   ScalarEncoderParameters p;
@@ -157,6 +157,26 @@ namespace testing {
     ASSERT_EQ(output4.getSparse(), outputZ.getSparse());
   }
 
+  // Test batch encoding, which uses the default of BaseEncoder
+  TEST(SimHashDocumentEncoder, testEncodeBatch) {
+    SimHashDocumentEncoderParameters params;
+    params.size = 400u;
+    params.activeBits = 20u;
+    SimHashDocumentEncoder encoder(params);
+
+    const std::vector<std::vector<std::string>> docs({ testDoc1, testDoc2, {} });
+    SDRBatch batch;
+    encoder.encodeBatch(docs, batch);
+    ASSERT_EQ(batch.size(), docs.size());
+    SDR expected({ params.size });
+    SDR actual({ params.size });
+    for (size_t i = 0; i < docs.size(); i++) {
+      encoder.encode(docs[i], expected);
+      batch.getSDR(i, actual);
+      ASSERT_EQ(expected, actual);
+    }
+  }
+
   // Test excludes param
   TEST(SimHashDocumentEncoder, testExcludes) {
     std::vector<std::string> fullList = {
@@ -0,0 +1,173 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+#include <gtest/gtest.h>
+#include <htm/types/SdrBatch.hpp>
+#include <sstream>
+#include <vector>
+
+namespace testing {
+
+using namespace std;
+using namespace htm;
+
+TEST(SdrBatchTest, TestConstructor) {
+    SDRBatch batch({ 3, 4 });
+    ASSERT_EQ( batch.getDimensions(), vector<UInt>({ 3, 4 }) );
+    ASSERT_EQ( batch.getSDRSize(), 12u );
+    ASSERT_EQ( batch.size(), 0u );
+    ASSERT_TRUE( batch.empty() );
+    ASSERT_EQ( batch.getSum(), 0u );
+    ASSERT_ANY_THROW( SDRBatch({ 3, 0 }) );
+    ASSERT_ANY_THROW( SDRBatch( vector<UInt>{} ) );
+    // Uninitialized.
+    SDRBatch empty;
+    ASSERT_EQ( empty.size(), 0u );
+    ASSERT_ANY_THROW( empty.push_back( SDR_sparse_t{ 1 } ) );
+}
+
+TEST(SdrBatchTest, TestPushBackAndRows) {
+    SDRBatch batch({ 10, 10 });
+    SDR sdr({ 10, 10 });
+    sdr.setSparse(SDR_sparse_t({ 3, 7, 99 }));
+    batch.push_back( sdr );
+    batch.push_back( SDR_sparse_t{} );
+    batch.push_back( SDR_sparse_t{ 1, 4, 42, 50 } );
+    // Same size, different shape.
+    SDR flat({ 100 });
+    flat.setSparse(SDR_sparse_t({ 0 }));
+    batch.push_back( flat );
+
+    ASSERT_EQ( batch.size(), 4u );
+    ASSERT_EQ( batch.getSum(), 8u );
+    ASSERT_EQ( SDR_sparse_t( batch[0].begin(), batch[0].end() ), SDR_sparse_t({ 3, 7, 99 }) );
+    ASSERT_TRUE( batch[1].empty() );
+    ASSERT_EQ( batch[2].size(), 4u );
+    ASSERT_EQ( batch[2][2], 42u );
+    ASSERT_EQ( batch[3][0], 0u );
+    // Push a view of another row.
+    batch.push_back( batch[0] );
+    ASSERT_EQ( SDR_sparse_t( batch[4].begin(), batch[4].end() ), SDR_sparse_t({ 3, 7, 99 }) );
+
+    // The size must match.
+    SDR wrong({ 10 });
+    ASSERT_ANY_THROW( batch.push_back( wrong ) );
+
+    // Clear keeps the dimensions.
+    batch.clear();
+    ASSERT_EQ( batch.size(), 0u );
+    ASSERT_EQ( batch.getSum(), 0u );
+    ASSERT_EQ( batch.getSDRSize(), 100u );
+}
+
+TEST(SdrBatchTest, TestGetSDR) {
+    SDRBatch batch({ 5, 5 });
+    batch.push_back( SDR_sparse_t{ 0, 24 } );
+    batch.push_back( SDR_sparse_t{ 6, 7, 8 } );
+    SDR out({ 5, 5 });
+    out.setSparse(SDR_sparse_t({ 1, 2, 3, 4, 5 }));
+    batch.getSDR( 1, out );
+    ASSERT_EQ( out.getSparse(), SDR_sparse_t({ 6, 7, 8 }) );
+    ASSERT_EQ( out.dimensions, vector<UInt>({ 5, 5 }) );
+    batch.getSDR( 0, out );
+    ASSERT_EQ( out.getSparse(), SDR_sparse_t({ 0, 24 }) );
+    // A differently shaped SDR keeps its shape.
+    SDR flat({ 25 });
+    batch.getSDR( 1, flat );
+    ASSERT_EQ( flat.dimensions, vector<UInt>({ 25 }) );
+    ASSERT_EQ( flat.getSparse(), SDR_sparse_t({ 6, 7, 8 }) );
+
+    ASSERT_ANY_THROW( batch.getSDR( 2, out ) );
+    SDR wrong({ 24 });
+    ASSERT_ANY_THROW( batch.getSDR( 0, wrong ) );
+}
+
+TEST(SdrBatchTest, TestAppend) {
+    SDRBatch A({ 20 });
+    A.push_back( SDR_sparse_t{ 1, 2 } );
+    SDRBatch B({ 20 });
+    B.push_back( SDR_sparse_t{ 3 } );
+    B.push_back( SDR_sparse_t{} );
+    B.push_back( SDR_sparse_t{ 4, 5, 19 } );
+    A.append( B );
+    ASSERT_EQ( A.size(), 4u );
+    ASSERT_EQ( A.getSum(), 6u );
+    ASSERT_EQ( SDR_sparse_t( A[1].begin(), A[1].end() ), SDR_sparse_t({ 3 }) );
+    ASSERT_TRUE( A[2].empty() );
+    ASSERT_EQ( SDR_sparse_t( A[3].begin(), A[3].end() ), SDR_sparse_t({ 4, 5, 19 }) );
+
+    SDRBatch C({ 4, 5 });
+    ASSERT_ANY_THROW( A.append( C ) );
+
+    // Append a batch to itself, and push back its own rows.
+    A.append( A );
+    ASSERT_EQ( A.size(), 8u );
+    ASSERT_EQ( A.getSum(), 12u );
+    for( size_t i = 0u; i < 4u; i++ ) {
+        ASSERT_EQ( SDR_sparse_t( A[i].begin(),      A[i].end() ),
+                   SDR_sparse_t( A[i + 4u].begin(), A[i + 4u].end() ) );
+    }
+    for( size_t i = 0u; i < 8u; i++ ) {
+        A.push_back( A[i] );
+    }
+    ASSERT_EQ( A.size(), 16u );
+    for( size_t i = 0u; i < 8u; i++ ) {
+        ASSERT_EQ( SDR_sparse_t( A[i].begin(),      A[i].end() ),
+                   SDR_sparse_t( A[i + 8u].begin(), A[i + 8u].end() ) );
+    }
+}
+
+TEST(SdrBatchTest, TestEquality) {
+    SDRBatch A({ 10 });
+    SDRBatch B({ 10 });
+    ASSERT_EQ( A, B );
+    A.push_back( SDR_sparse_t{ 1, 2 } );
+    ASSERT_NE( A, B );
+    B.push_back( SDR_sparse_t{ 1 } );
+    ASSERT_NE( A, B );
+    B.clear();
+    B.push_back( SDR_sparse_t{ 1, 2 } );
+    ASSERT_EQ( A, B );
+    // Same bits, split differently between the SDRs.
+    A.push_back( SDR_sparse_t{} );
+    B.clear();
+    B.push_back( SDR_sparse_t{ 1 } );
+    B.push_back( SDR_sparse_t{ 2 } );
+    ASSERT_NE( A, B );
+    // Different dimensions.
+    SDRBatch C({ 2, 5 });
+    SDRBatch D({ 10 });
+    ASSERT_NE( C, D );
+}
+
+TEST(SdrBatchTest, TestSaveLoad) {
+    SDRBatch batch({ 3, 3 });
+    batch.push_back( SDR_sparse_t{ 1, 4, 8 } );
+    batch.push_back( SDR_sparse_t{} );
+    batch.push_back( SDR_sparse_t{ 0 } );
+    for( const auto format : { SerializableFormat::BINARY, SerializableFormat::JSON } ) {
+        stringstream ss;
+        batch.save( ss, format );
+        SDRBatch loaded;
+        loaded.load( ss, format );
+        ASSERT_EQ( batch, loaded );
+        ASSERT_EQ( loaded.getSDRSize(), 9u );
+        ASSERT_EQ( loaded[2][0], 0u );
+    }
+}
+
+} // End namespace testing
@@ -377,6 +377,25 @@ TEST(SdrTest, TestGetSparseFromDense) {
     ASSERT_EQ( a.getSparse().size(), 0ul );
 }
 
+TEST(SdrTest, TestGetSparseFromDenseSizes) {
+    // Every size around the blocks of the conversion, and non-zero values
+    // other than 1.
+    Random rng( 9 );
+    for( UInt size = 1u; size <= 100u; size++ ) {
+        SDR a({ size });
+        SDR_dense_t dense( size, 0 );
+        SDR_sparse_t expected;
+        for( UInt i = 0u; i < size; i++ ) {
+            if( rng.getReal64() < 0.3 ) {
+                dense[i] = static_cast<Byte>( 1u + rng.getUInt32(255u) );
+                expected.push_back( i );
+            }
+        }
+        a.setDense( dense );
+        ASSERT_EQ( a.getSparse(), expected ) << "size " << size;
+    }
+}
+
 TEST(SdrTest, TestGetSparseFromCoordinates) {
     // Test simple 2-D SDR.
     SDR a({3, 3}); a.zero();
@@ -500,6 +519,71 @@ TEST(SdrTest, TestGetOverlap) {
     ASSERT_EQ( a.getOverlap( b ), 0ul );
 }
 
+TEST(SdrTest, TestGetBitsFromSparse) {
+    SDR a({ 2, 50 });
+    a.setSparse(SDR_sparse_t({ 0, 5, 63, 64, 99 }));
+    const SDR_bits_t expected({ (1ull << 0) | (1ull << 5) | (1ull << 63),
+                                (1ull << 0) | (1ull << 35) });
+    ASSERT_EQ( a.getBits(), expected );
+
+    a.zero();
+    ASSERT_EQ( a.getBits(), SDR_bits_t( 2, 0u ));
+}
+
+TEST(SdrTest, TestSetBits) {
+    Random rng( 42 );
+    for( const UInt size : { 1u, 63u, 64u, 65u, 1000u }) {
+        SDR a({ size });
+        SDR b({ size });
+        a.randomize( 0.3f, rng );
+        auto bits = a.getBits();
+        b.setBits( bits );
+        ASSERT_EQ( a.getSparse(), b.getSparse() );
+        ASSERT_EQ( a.getDense(),  b.getDense() );
+        ASSERT_EQ( a, b );
+
+        // Modify the bits inplace.
+        auto &inplace = b.getBits();
+        inplace[0] ^= 1u;
+        b.setBits( inplace );
+        ASSERT_EQ( b.getDense()[0], !a.getDense()[0] );
+        ASSERT_NE( a, b );
+    }
+}
+
+TEST(SdrTest, TestGetOverlapFormats) {
+    // The overlap is the same for any formats the SDRs have.
+    Random rng( 7 );
+    SDR a({ 10, 30 });
+    SDR b({ 10, 30 });
+    a.randomize( 0.2f, rng );
+    b.randomize( 0.4f, rng );
+    UInt expected = 0u;
+    for( UInt i = 0u; i < a.size; i++ )
+        expected += a.getDense()[i] && b.getDense()[i];
+
+    // Use constant references to copy, instead of swap, the data.
+    const auto copyAs = [](const SDR &sdr, int format, SDR &out) {
+        const SDR_dense_t      &dense  = sdr.getDense();
+        const SDR_sparse_t     &sparse = sdr.getSparse();
+        const SDR_coordinate_t &coords = sdr.getCoordinates();
+        SDR_bits_t bits = sdr.getBits();
+        if( format == 0 ) { out.setDense( dense ); }
+        if( format == 1 ) { out.setSparse( sparse ); }
+        if( format == 2 ) { out.setBits( bits ); }
+        if( format == 3 ) { out.setCoordinates( coords ); }
+    };
+    for( int formatA = 0; formatA < 4; formatA++ ) {
+        for( int formatB = 0; formatB < 4; formatB++ ) {
+            SDR x( a.dimensions );
+            SDR y( b.dimensions );
+            copyAs( a, formatA, x );
+            copyAs( b, formatB, y );
+            ASSERT_EQ( x.getOverlap( y ), expected ) << formatA << " " << formatB;
+        }
+    }
+}
+
 TEST(SdrTest, TestRandomize) {
     // Test sparsity is OK
     SDR a({1000});
@@ -629,6 +713,38 @@ TEST(SdrTest, TestIntersection) {
     ASSERT_EQ( X.getSum(), 0u );
 }
 
+TEST(SdrTest, TestIntersectionUnionFormats) {
+    Random rng( 3 );
+    SDR A({ 130 });
+    SDR B({ 130 });
+    SDR C({ 130 });
+    A.randomize( 0.4f, rng );
+    B.randomize( 0.4f, rng );
+    C.randomize( 0.4f, rng );
+    SDR_sparse_t both, either;
+    for( UInt i = 0u; i < A.size; i++ ) {
+        const auto a = A.getDense()[i], b = B.getDense()[i], c = C.getDense()[i];
+        if( a and b and c ) both.push_back( i );
+        if( a or  b or  c ) either.push_back( i );
+    }
+    auto bits = B.getBits();
+    B.setBits( bits ); // Only valid as bits.
+
+    SDR X({ 130 });
+    X.intersection({ &A, &B, &C });
+    ASSERT_EQ( X.getSparse(), both );
+    X.set_union({ &A, &B, &C });
+    ASSERT_EQ( X.getSparse(), either );
+
+    // Inplace
+    X.setSDR( A );
+    X.intersection({ &X, &B, &C });
+    ASSERT_EQ( X.getSparse(), both );
+    X.setSDR( A );
+    X.set_union({ &B, &X, &C });
+    ASSERT_EQ( X.getSparse(), either );
+}
+
 TEST(SdrTest, TestUnionExampleUsage) {
     // Setup 2 SDRs to hold the inputs.
     SDR A({ 10 });
@@ -694,6 +810,23 @@ TEST(SdrTest, TestConcatenation) {
     ASSERT_EQ(E.getSum(), 13u);
 }
 
+TEST(SdrTest, TestConcatenationAxis) {
+    // Compare with copying the dense rows.
+    Random rng( 5 );
+    SDR A({ 3, 4, 5 });
+    SDR B({ 3, 2, 5 });
+    A.randomize( 0.3f, rng );
+    B.randomize( 0.5f, rng );
+    SDR C({ 3, 6, 5 });
+    C.concatenate( A, B, 1u );
+    SDR_dense_t expected;
+    for( UInt r = 0u; r < 3u; r++ ) {
+        expected.insert( expected.end(), A.getDense().begin() + r * 20u, A.getDense().begin() + (r + 1u) * 20u );
+        expected.insert( expected.end(), B.getDense().begin() + r * 10u, B.getDense().begin() + (r + 1u) * 10u );
+    }
+    ASSERT_EQ( C.getDense(), expected );
+}
+
 TEST(SdrTest, TestEquality) {
     vector<SDR*> test_cases;
     // Test different dimensions
@@ -883,4 +1016,47 @@ TEST(SdrTest, TestAssignmentOperator)
   EXPECT_EQ(a.dimensions, copy.dimensions);
 }
 
+TEST(SdrTest, TestSwap)
+{
+  SDR a({10, 10});
+  SDR b({10, 10});
+  a.setSparse<UInt>({1, 3, 5, 7});
+  b.setDense(SDR_dense_t(100u, 1));
+  int callsA = 0, callsB = 0;
+  a.addCallback( [&](){ callsA++; });
+  b.addCallback( [&](){ callsB++; });
+  a.swap( b );
+  EXPECT_EQ( a.getSum(), 100u );
+  EXPECT_EQ( b.getSparse(), SDR_sparse_t({1, 3, 5, 7}) );
+  EXPECT_EQ( callsA, 1 );
+  EXPECT_EQ( callsB, 1 );
+
+  SDR c({100});
+  EXPECT_ANY_THROW( a.swap( c ) );
+}
+
+TEST(SdrTest, TestMove)
+{
+  SDR a({10, 10});
+  a.setSparse<UInt>({1, 3, 5, 7});
+  SDR b( std::move(a) );
+  EXPECT_EQ( b.getSparse(), SDR_sparse_t({1, 3, 5, 7}) );
+  EXPECT_EQ( b.dimensions, vector<UInt>({10, 10}) );
+
+  // Move assignment reshapes like the copy assignment.
+  SDR c({100});
+  c.setSparse<UInt>({99});
+  c = std::move(b);
+  EXPECT_EQ( c.dimensions, vector<UInt>({10, 10}) );
+  EXPECT_EQ( c.getCoordinates(), SDR_coordinate_t({{0, 0, 0, 0}, {1, 3, 5, 7}}) );
+
+  SDR d; // No dimensions
+  d = SDR({5});
+  EXPECT_EQ( d.dimensions, vector<UInt>({5}) );
+  EXPECT_EQ( d.getSum(), 0u );
+
+  SDR e({7});
+  EXPECT_ANY_THROW( e = SDR({8}) );
+}
+
 } // End namespace testing
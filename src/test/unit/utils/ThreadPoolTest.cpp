@@ -0,0 +1,71 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+#include <stdexcept>
+
+#include "htm/types/Types.hpp"
+#include "htm/utils/ThreadPool.hpp"
+
+namespace testing { 
+    
+using namespace htm;
+
+TEST(ThreadPool, Chunks) {
+  ThreadPool pool( 3u );
+  ASSERT_EQ( pool.size(), 3u );
+  std::vector<UInt> owner( 10u, 99u );
+  for( int repeat = 0; repeat < 5; repeat++ ) { // reuse the same workers
+    pool.parallelFor( owner.size(), [&](size_t begin, size_t end, UInt chunk) {
+      ASSERT_EQ( begin, ThreadPool::chunkBegin( owner.size(), 3u, chunk ));
+      ASSERT_EQ( end,   ThreadPool::chunkBegin( owner.size(), 3u, chunk + 1u ));
+      for( size_t i = begin; i < end; i++ )
+        owner[i] = chunk;
+    });
+    ASSERT_EQ( owner, std::vector<UInt>({ 0, 0, 0, 1, 1, 1, 2, 2, 2, 2 }));
+  }
+}
+
+TEST(ThreadPool, Sum) {
+  std::vector<UInt> data( 1000u );
+  std::iota( data.begin(), data.end(), 0u );
+  for( UInt numThreads : { 1u, 2u, 4u, 0u }) {
+    ThreadPool pool( numThreads );
+    std::vector<UInt> partial( pool.size(), 0u );
+    pool.parallelFor( data.size(), [&](size_t begin, size_t end, UInt chunk) {
+      for( size_t i = begin; i < end; i++ )
+        partial[chunk] += data[i];
+    });
+    ASSERT_EQ( std::accumulate( partial.begin(), partial.end(), 0u ), 499500u );
+  }
+}
+
+TEST(ThreadPool, Exception) {
+  ThreadPool pool( 4u );
+  EXPECT_THROW( pool.parallelFor( 100u, [&](size_t begin, size_t, UInt) {
+      if( begin > 0u ) throw std::runtime_error("test");
+    }), std::runtime_error );
+  // The pool is still usable afterwards.
+  UInt calls = 0u;
+  pool.parallelFor( 1u, [&](size_t, size_t, UInt) { calls++; });
+  ASSERT_EQ( calls, 1u );
+}
+
+} // end namespace
@@ -413,4 +413,84 @@ ASSERT_TRUE(centerFound_) << "Center was not included in hood!";
 
 }
 
+
+/**
+ * NeighborhoodStencil visits the same points in the same order as the
+ * Neighborhood, both for interior points and near the edges.
+ */
+TEST(TopologyTest, NeighborhoodStencil) {
+  const vector<vector<UInt>> topologies = {{1}, {9}, {30}, {6, 11}, {3, 4, 5}};
+  for(const auto &dims : topologies) {
+    UInt numPoints = 1u;
+    for(const auto dim : dims) numPoints *= dim;
+    for(const UInt radius : {0u, 1u, 2u, 4u, 7u}) {
+      for(const bool wrap : {false, true}) {
+        for(const bool skipCenter : {false, true}) {
+          const NeighborhoodStencil stencil(radius, dims, wrap);
+          for(UInt center = 0; center < numPoints; center++) {
+            vector<UInt> expected;
+            for(const auto point : Neighborhood(center, radius, dims, wrap, skipCenter)) {
+              expected.push_back(point);
+            }
+            vector<UInt> actual;
+            stencil.forEach(center, [&actual](UInt point) { actual.push_back(point); }, skipCenter);
+            ASSERT_EQ(expected, actual) << "center " << center << " radius " << radius;
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * NeighborhoodCounter, neighborhoodMax and neighborhoodMean agree with
+ * iterating over the Neighborhood, for small (scanned) and for large (tree)
+ * neighborhoods.
+ */
+TEST(TopologyTest, NeighborhoodCounter) {
+  Random rng(7);
+  const vector<vector<UInt>> topologies = {{1}, {50}, {300}, {6, 9}, {40, 33}, {5, 1, 7}};
+  for(const auto &dims : topologies) {
+    UInt numPoints = 1u;
+    for(const auto dim : dims) numPoints *= dim;
+    for(const UInt radius : {1u, 2u, 4u, 15u, 200u}) {
+      for(const bool wrap : {false, true}) {
+        NeighborhoodCounter counter(dims, radius, wrap);
+        vector<bool> marked(numPoints, false);
+        vector<Real> values(numPoints);
+        for(UInt i = 0; i < numPoints; i++) {
+          values[i] = rng.getReal64() < 0.5 ? 0.0f : static_cast<Real>(rng.getReal64());
+          if( rng.getReal64() < 0.3 ) {
+            marked[i] = true;
+            counter.add(i);
+          }
+        }
+        vector<Real> maxima, means;
+        neighborhoodMax (values, dims, radius, wrap, maxima);
+        neighborhoodMean(values, dims, radius, wrap, means);
+
+        for(UInt center = 0; center < numPoints; center++) {
+          UInt size = 0u, count = 0u;
+          Real maximum = values[center];
+          Real64 sum = 0.0;
+          for(const auto point : Neighborhood(center, radius, dims, wrap)) {
+            size++;
+            count += marked[point];
+            maximum = std::max(maximum, values[point]);
+            sum += values[point];
+          }
+          ASSERT_EQ(size,  counter.size(center));
+          ASSERT_EQ(count, counter.count(center));
+          ASSERT_GE(counter.count(center, 2u), std::min(count, 2u));
+          ASSERT_LE(counter.count(center, 2u), count);
+          ASSERT_EQ(maximum, maxima[center]);
+          ASSERT_NEAR(sum / size, means[center], 1e-6);
+        }
+        counter.clear();
+        ASSERT_EQ(0u, counter.count(numPoints - 1u));
+      }
+    }
+  }
+}
+
 } // namespace